@@ -0,0 +1,326 @@
+#include "ast.hpp"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+Expr* Ast::expr(Expr_ID id) {
+  switch (expr_type(id)) {
+    case ExprType::BINARY:   return get<Binary_Expr>(id);
+    case ExprType::UNARY:    return get<Unary_Expr>(id);
+    case ExprType::GROUPING: return get<Grouping_Expr>(id);
+    case ExprType::VARIABLE: return get<Variable_Expr>(id);
+    case ExprType::LITERAL:  return get<Literal>(id);
+    case ExprType::CALL:     return get<Call_Expr>(id);
+    case ExprType::MEMBER:   return get<Member_Expr>(id);
+    default: panic_and_abort("Invalid expression type");
+  }
+}
+
+Stmt* Ast::stmt(Stmt_ID id) {
+  switch (stmt_kind(id)) {
+    case StmtKind::DECL_VAR:   return get<Decl_Var_Stmt>(id);
+    case StmtKind::DECL_PROC:  return get<Decl_Proc_Stmt>(id);
+    case StmtKind::IF:         return get<If_Stmt>(id);
+    case StmtKind::FOR:        return get<For_Stmt>(id);
+    case StmtKind::ASSIGN:     return get<Assign_Stmt>(id);
+    case StmtKind::BLOCK:      return get<Block_Stmt>(id);
+    case StmtKind::EXPRESSION: return get<Expr_Stmt>(id);
+    case StmtKind::IMPORT:     return get<Import_Stmt>(id);
+    case StmtKind::RETURN:     return get<Return_Stmt>(id);
+    default: panic_and_abort("Invalid statement kind");
+  }
+}
+
+template <typename T>
+static u32 append_list(DArray<T>* shared, const T* items, size_t count) {
+  u32 first = (u32)shared->size;
+  shared->ensure_capacity(shared->size + count);
+  for (size_t i = 0; i < count; i++) {
+    shared->data[shared->size + i] = items[i];
+  }
+  shared->size += count;
+  return first;
+}
+
+Expr_List Ast::add_expr_list(const Expr_ID* exprs, size_t count) {
+  Expr_List range;
+  range.first = append_list(&expr_lists, exprs, count);
+  range.count = (u32)count;
+  return range;
+}
+
+Stmt_List Ast::add_stmt_list(const Stmt_ID* stmts, size_t count) {
+  Stmt_List range;
+  range.first = append_list(&stmt_lists, stmts, count);
+  range.count = (u32)count;
+  return range;
+}
+
+Decl_List Ast::add_decl_list(const Decl_Var* decls, size_t count) {
+  Decl_List range;
+  range.first = append_list(&decl_lists, decls, count);
+  range.count = (u32)count;
+  return range;
+}
+
+// the ids a node holds, translated to the ast it is appended to
+static void rebase(Binary_Expr* node, const Ast_Rebase& to)   { node->left = to.expr(node->left); node->right = to.expr(node->right); }
+static void rebase(Unary_Expr* node, const Ast_Rebase& to)    { node->operand = to.expr(node->operand); }
+static void rebase(Grouping_Expr* node, const Ast_Rebase& to) { node->expr = to.expr(node->expr); }
+static void rebase(Variable_Expr*, const Ast_Rebase&) {}
+static void rebase(Literal*, const Ast_Rebase&) {}
+static void rebase(Call_Expr* node, const Ast_Rebase& to)     { node->expression = to.expr(node->expression); node->arguments = to.list(node->arguments); }
+static void rebase(Member_Expr* node, const Ast_Rebase& to)   { node->expression = to.expr(node->expression); }
+
+static void rebase(Decl_Var_Stmt* node, const Ast_Rebase& to) { node->initializer = to.expr(node->initializer); }
+static void rebase(Decl_Proc_Stmt* node, const Ast_Rebase& to) {
+  node->parameters = to.list(node->parameters);
+  node->returns = to.list(node->returns);
+  node->body = to.list(node->body);
+}
+static void rebase(If_Stmt* node, const Ast_Rebase& to) {
+  node->cond = to.expr(node->cond);
+  node->then_stmt = to.stmt(node->then_stmt);
+  node->else_stmt = to.stmt(node->else_stmt);
+}
+static void rebase(For_Stmt* node, const Ast_Rebase& to)    { node->condition = to.expr(node->condition); node->body = to.stmt(node->body); }
+static void rebase(Assign_Stmt* node, const Ast_Rebase& to) { node->rhs = to.expr(node->rhs); }
+static void rebase(Block_Stmt* node, const Ast_Rebase& to)  { node->body = to.list(node->body); }
+static void rebase(Expr_Stmt* node, const Ast_Rebase& to)   { node->expr = to.expr(node->expr); }
+static void rebase(Import_Stmt*, const Ast_Rebase&) {}
+static void rebase(Return_Stmt* node, const Ast_Rebase& to) { node->returns = to.list(node->returns); }
+
+template <typename T>
+static void append_pool(DArray<T>* to, const DArray<T>& from, const Ast_Rebase& rebase_to) {
+  size_t start = to->size;
+  append_list(to, from.data, from.size);
+  for (size_t i = start; i < to->size; i++) {
+    rebase(&to->data[i], rebase_to);
+  }
+}
+
+static u64 cons_hash(const Binary_Expr& node, u32 /* scope */) {
+  u64 parts[] = { (u64)ExprType::BINARY, (u64)node.opperator, node.left, node.right };
+  return hash_bytes(parts, sizeof(parts));
+}
+
+static u64 cons_hash(const Unary_Expr& node, u32 /* scope */) {
+  u64 parts[] = { (u64)ExprType::UNARY, (u64)node.opperator, node.operand };
+  return hash_bytes(parts, sizeof(parts));
+}
+
+static u64 cons_hash(const Grouping_Expr& node, u32 /* scope */) {
+  u64 parts[] = { (u64)ExprType::GROUPING, node.expr };
+  return hash_bytes(parts, sizeof(parts));
+}
+
+static u64 cons_hash(const Variable_Expr& node, u32 scope) {
+  u64 parts[] = { (u64)ExprType::VARIABLE, node.identifier, scope };
+  return hash_bytes(parts, sizeof(parts));
+}
+
+// the union has padding and unused bytes, only the part for the type goes in
+static u64 cons_hash(const Literal& node, u32 /* scope */) {
+  const Value& value = node.value;
+  u64 parts[] = { (u64)ExprType::LITERAL, (u64)value.type, 0 };
+  switch (value.type) {
+    case Value::INTEGER: parts[2] = (u64)value.value.integer; break;
+    case Value::REAL:    memcpy(&parts[2], &value.value.real, sizeof(double)); break;
+    case Value::STRING:  parts[2] = hash_bytes(value.value.string.data, value.value.string.size); break;
+    case Value::BOOLEAN: parts[2] = value.value.boolean; break;
+    case Value::NIL:     break;
+  }
+
+  return hash_bytes(parts, sizeof(parts));
+}
+
+static bool cons_equal(const Binary_Expr& a, const Binary_Expr& b) {
+  return a.opperator == b.opperator && a.left == b.left && a.right == b.right;
+}
+
+static bool cons_equal(const Unary_Expr& a, const Unary_Expr& b) {
+  return a.opperator == b.opperator && a.operand == b.operand;
+}
+
+static bool cons_equal(const Grouping_Expr& a, const Grouping_Expr& b) {
+  return a.expr == b.expr;
+}
+
+static bool cons_equal(const Variable_Expr& a, const Variable_Expr& b) {
+  return a.identifier == b.identifier;  // the scope is compared in the slot
+}
+
+// not compare_value, 0.0 and -0.0 are equal there but can't be the same node
+static bool cons_equal(const Literal& a, const Literal& b) {
+  if (a.value.type != b.value.type) return false;
+
+  switch (a.value.type) {
+    case Value::INTEGER: return a.value.value.integer == b.value.value.integer;
+    case Value::REAL:    return memcmp(&a.value.value.real, &b.value.value.real, sizeof(double)) == 0;
+    case Value::STRING:  return compare_string(a.value.value.string, b.value.value.string);
+    case Value::BOOLEAN: return a.value.value.boolean == b.value.value.boolean;
+    case Value::NIL:     return true;
+  }
+
+  return false;
+}
+
+static void grow_cons_table(Expr_Table* table) {
+  size_t capacity = table->slots.size ? table->slots.size * 2 : 256;
+  DArray<Expr_Table::Slot> slots(capacity);
+  for (size_t i = 0; i < capacity; i++) slots.add(Expr_Table::Slot());
+
+  for (auto& slot : table->slots) {
+    if (slot.id == EXPR_NONE) continue;
+
+    size_t i = slot.hash & (capacity - 1);
+    while (slots.data[i].id != EXPR_NONE) i = (i + 1) & (capacity - 1);
+    slots.data[i] = slot;
+  }
+
+  table->slots.free();
+  table->slots = slots;
+}
+
+template <typename T>
+static Expr_ID cons_node(Ast* ast, const T& node) {
+  if (!ast->hash_consing) return ast->add(node);
+
+  Expr_Table* table = &ast->cons_table;
+  if ((table->count + 1) * 4 > table->slots.size * 3) grow_cons_table(table);
+
+  u32 scope = (T::KIND == ExprType::VARIABLE) ? table->scope : 0;
+  u64 hash = cons_hash(node, scope);
+  size_t mask = table->slots.size - 1;
+
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    Expr_Table::Slot* slot = &table->slots.data[i];
+    if (slot->id == EXPR_NONE) {
+      slot->hash = hash;
+      slot->id = ast->add(node);
+      slot->scope = scope;
+      table->count++;
+      return slot->id;
+    }
+
+    if (slot->hash == hash && slot->scope == scope && expr_type(slot->id) == T::KIND && cons_equal(*ast->get<T>(slot->id), node)) {
+      table->shared++;
+      return slot->id;
+    }
+  }
+}
+
+Expr_ID Ast::cons(const Binary_Expr& node)   { return cons_node(this, node); }
+Expr_ID Ast::cons(const Unary_Expr& node)    { return cons_node(this, node); }
+Expr_ID Ast::cons(const Grouping_Expr& node) { return cons_node(this, node); }
+Expr_ID Ast::cons(const Variable_Expr& node) { return cons_node(this, node); }
+Expr_ID Ast::cons(const Literal& node)       { return cons_node(this, node); }
+
+Ast_Rebase Ast::append(const Ast& other) {
+  Ast_Rebase rebase_to;
+  rebase_to.exprs[(u32)ExprType::BINARY]   = (u32)binaries.size;
+  rebase_to.exprs[(u32)ExprType::UNARY]    = (u32)unaries.size;
+  rebase_to.exprs[(u32)ExprType::GROUPING] = (u32)groupings.size;
+  rebase_to.exprs[(u32)ExprType::VARIABLE] = (u32)variables.size;
+  rebase_to.exprs[(u32)ExprType::LITERAL]  = (u32)literals.size;
+  rebase_to.exprs[(u32)ExprType::CALL]     = (u32)calls.size;
+  rebase_to.exprs[(u32)ExprType::MEMBER]   = (u32)members.size;
+
+  rebase_to.stmts[(u32)StmtKind::DECL_VAR]   = (u32)decl_vars.size;
+  rebase_to.stmts[(u32)StmtKind::DECL_PROC]  = (u32)decl_procs.size;
+  rebase_to.stmts[(u32)StmtKind::IF]         = (u32)ifs.size;
+  rebase_to.stmts[(u32)StmtKind::FOR]        = (u32)fors.size;
+  rebase_to.stmts[(u32)StmtKind::ASSIGN]     = (u32)assigns.size;
+  rebase_to.stmts[(u32)StmtKind::BLOCK]      = (u32)blocks.size;
+  rebase_to.stmts[(u32)StmtKind::EXPRESSION] = (u32)expr_stmts.size;
+  rebase_to.stmts[(u32)StmtKind::IMPORT]     = (u32)imports.size;
+  rebase_to.stmts[(u32)StmtKind::RETURN]     = (u32)returns.size;
+
+  rebase_to.expr_lists = (u32)expr_lists.size;
+  rebase_to.stmt_lists = (u32)stmt_lists.size;
+  rebase_to.decl_lists = (u32)decl_lists.size;
+
+  append_pool(&binaries, other.binaries, rebase_to);
+  append_pool(&unaries, other.unaries, rebase_to);
+  append_pool(&groupings, other.groupings, rebase_to);
+  append_pool(&variables, other.variables, rebase_to);
+  append_pool(&literals, other.literals, rebase_to);
+  append_pool(&calls, other.calls, rebase_to);
+  append_pool(&members, other.members, rebase_to);
+
+  append_pool(&decl_vars, other.decl_vars, rebase_to);
+  append_pool(&decl_procs, other.decl_procs, rebase_to);
+  append_pool(&ifs, other.ifs, rebase_to);
+  append_pool(&fors, other.fors, rebase_to);
+  append_pool(&assigns, other.assigns, rebase_to);
+  append_pool(&blocks, other.blocks, rebase_to);
+  append_pool(&expr_stmts, other.expr_stmts, rebase_to);
+  append_pool(&imports, other.imports, rebase_to);
+  append_pool(&returns, other.returns, rebase_to);
+
+  expr_lists.ensure_capacity(expr_lists.size + other.expr_lists.size);
+  for (size_t i = 0; i < other.expr_lists.size; i++) {
+    expr_lists.add(rebase_to.expr(other.expr_lists.data[i]));
+  }
+  stmt_lists.ensure_capacity(stmt_lists.size + other.stmt_lists.size);
+  for (size_t i = 0; i < other.stmt_lists.size; i++) {
+    stmt_lists.add(rebase_to.stmt(other.stmt_lists.data[i]));
+  }
+  append_list(&decl_lists, other.decl_lists.data, other.decl_lists.size);
+
+  return rebase_to;
+}
+
+size_t Ast::node_count() const {
+  return binaries.size + unaries.size + groupings.size + variables.size + literals.size + calls.size + members.size +
+         decl_vars.size + decl_procs.size + ifs.size + fors.size + assigns.size + blocks.size + expr_stmts.size + imports.size + returns.size;
+}
+
+template <typename T>
+static size_t array_bytes(const DArray<T>& array) {
+  return array.size * sizeof(T);
+}
+
+size_t Ast::memory_used() const {
+  return array_bytes(binaries) + array_bytes(unaries) + array_bytes(groupings) + array_bytes(variables) +
+         array_bytes(literals) + array_bytes(calls) + array_bytes(members) +
+         array_bytes(decl_vars) + array_bytes(decl_procs) + array_bytes(ifs) + array_bytes(fors) +
+         array_bytes(assigns) + array_bytes(blocks) + array_bytes(expr_stmts) + array_bytes(imports) + array_bytes(returns) +
+         array_bytes(expr_lists) + array_bytes(stmt_lists) + array_bytes(decl_lists);
+}
+
+void Ast::free() {
+  binaries.free();
+  unaries.free();
+  groupings.free();
+  variables.free();
+  literals.free();
+  calls.free();
+  members.free();
+
+  decl_vars.free();
+  decl_procs.free();
+  ifs.free();
+  fors.free();
+  assigns.free();
+  blocks.free();
+  expr_stmts.free();
+  imports.free();
+  returns.free();
+
+  expr_lists.free();
+  stmt_lists.free();
+  decl_lists.free();
+
+  if (tokens) tokens->free();
+  tokens = NULL;
+
+  cons_table.free();
+
+#ifndef _WIN32
+  if (mapping) munmap(mapping, mapping_size);
+#endif
+  mapping = NULL;
+  mapping_size = 0;
+}
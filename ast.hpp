@@ -0,0 +1,220 @@
+#pragma once
+
+#include "common.hpp"
+#include "template.hpp"
+#include "node.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "token.hpp"
+
+// where the nodes and lists of an appended ast ended up, translates its ids to ids of the ast it was appended to
+struct Ast_Rebase {
+  u32 exprs[NODE_KIND_COUNT] = {0};  // start of each expression pool, by kind
+  u32 stmts[NODE_KIND_COUNT] = {0};  // start of each statement pool, by kind
+  u32 expr_lists = 0;
+  u32 stmt_lists = 0;
+  u32 decl_lists = 0;
+
+  Expr_ID expr(Expr_ID id) const {
+    if (id == EXPR_NONE) return EXPR_NONE;
+    return make_node_id(node_kind(id), node_index(id) + exprs[node_kind(id)]);
+  }
+
+  Stmt_ID stmt(Stmt_ID id) const {
+    if (id == STMT_NONE) return STMT_NONE;
+    return make_node_id(node_kind(id), node_index(id) + stmts[node_kind(id)]);
+  }
+
+  Expr_List list(Expr_List range) const { range.first += expr_lists; return range; }
+  Stmt_List list(Stmt_List range) const { range.first += stmt_lists; return range; }
+  Decl_List list(Decl_List range) const { range.first += decl_lists; return range; }
+};
+
+// the expressions built while hash consing is on, see Ast::cons
+struct Expr_Table {
+  struct Slot {
+    u64 hash = 0;
+    Expr_ID id = EXPR_NONE;
+    u32 scope = 0;  // for variables, 0 for the rest
+  };
+
+  DArray<Slot> slots;  // open addressing, the size is a power of two
+  size_t count = 0;
+  size_t shared = 0;  // how many times an existing node was handed out instead of a new one
+
+  // which variable a name refers to can change at every brace, so a variable node is only shared inside one run of
+  // tokens between braces. the parser bumps this
+  u32 scope = 1;
+
+  void free() {
+    slots.free();
+    count = 0;
+  }
+};
+
+// the syntax tree of a compilation unit.
+// nodes of each kind are packed in their own array and refer to each other with ids, lists of children are ranges
+// in the shared lists below. nothing points into the arrays so they are free to grow while the tree is built,
+// pointers from get() are only good until the next node of that kind is added.
+struct Ast {
+  // expressions
+  DArray<Binary_Expr> binaries;
+  DArray<Unary_Expr> unaries;
+  DArray<Grouping_Expr> groupings;
+  DArray<Variable_Expr> variables;
+  DArray<Literal> literals;
+  DArray<Call_Expr> calls;
+  DArray<Member_Expr> members;
+
+  // statements
+  DArray<Decl_Var_Stmt> decl_vars;
+  DArray<Decl_Proc_Stmt> decl_procs;
+  DArray<If_Stmt> ifs;
+  DArray<For_Stmt> fors;
+  DArray<Assign_Stmt> assigns;
+  DArray<Block_Stmt> blocks;
+  DArray<Expr_Stmt> expr_stmts;
+  DArray<Import_Stmt> imports;
+  DArray<Return_Stmt> returns;
+
+  // child lists
+  DArray<Expr_ID> expr_lists;
+  DArray<Stmt_ID> stmt_lists;
+  DArray<Decl_Var> decl_lists;
+
+  Stmt_List program;  // top level statements
+
+  // procedure bodies skipped by a lazy parse are parsed from these, the tokens go away with the ast
+  Token_Buffer* tokens = NULL;
+  Linear_Allocator* arena = NULL;
+
+  // structurally identical pure expressions share one node. the shared node keeps the location of the first one
+  bool hash_consing = false;
+  Expr_Table cons_table;
+
+  // a tree loaded from the ast cache has its pools in this mapping of the cache entry, unmapped with the ast
+  void* mapping = NULL;
+  size_t mapping_size = 0;
+
+  template <typename T> DArray<T>& pool();
+  template <typename T> const DArray<T>& pool() const { return const_cast<Ast*>(this)->pool<T>(); }
+
+  template <typename T>
+  u32 add(const T& node) {
+    DArray<T>& nodes = pool<T>();
+    nodes.add(node);
+    return make_node_id((u32)T::KIND, (u32)(nodes.size - 1));
+  }
+
+  template <typename T>
+  T* get(u32 id) {
+    if (node_kind(id) != (u32)T::KIND) {
+      panic_and_abort("INTERNAL: Syntax tree node accessed as the wrong kind");
+    }
+
+    return pool<T>().get_ref(node_index(id));
+  }
+
+  template <typename T>
+  const T* get(u32 id) const {
+    return const_cast<Ast*>(this)->get<T>(id);
+  }
+
+  // the leaves and the operators are looked up in cons_table with hash_consing, calls and member accesses are always new.
+  // since children are compared by id an expression with a call somewhere below is never shared. nodes handed out by
+  // these must not be changed afterwards, other than filling in what resolves the same for every use
+  Expr_ID cons(const Binary_Expr& node);
+  Expr_ID cons(const Unary_Expr& node);
+  Expr_ID cons(const Grouping_Expr& node);
+  Expr_ID cons(const Variable_Expr& node);
+  Expr_ID cons(const Literal& node);
+
+  // the parts every kind has
+  Expr* expr(Expr_ID id);
+  Stmt* stmt(Stmt_ID id);
+  const Expr* expr(Expr_ID id) const { return const_cast<Ast*>(this)->expr(id); }
+  const Stmt* stmt(Stmt_ID id) const { return const_cast<Ast*>(this)->stmt(id); }
+
+  // copy a list of children to the end of the shared list
+  Expr_List add_expr_list(const Expr_ID* exprs, size_t count);
+  Stmt_List add_stmt_list(const Stmt_ID* stmts, size_t count);
+  Decl_List add_decl_list(const Decl_Var* decls, size_t count);
+
+  ArrayView<Expr_ID> list(Expr_List range) const {
+    return ArrayView<Expr_ID>(expr_lists.data + range.first, range.count);
+  }
+
+  ArrayView<Stmt_ID> list(Stmt_List range) const {
+    return ArrayView<Stmt_ID>(stmt_lists.data + range.first, range.count);
+  }
+
+  ArrayView<Decl_Var> list(Decl_List range) const {
+    return ArrayView<Decl_Var>(decl_lists.data + range.first, range.count);
+  }
+
+  // calls visit(child) for every direct child of the expression, in source order
+  template <typename F>
+  void for_each_child(Expr_ID id, F visit) const {
+    switch (expr_type(id)) {
+      case ExprType::BINARY: {
+        auto binary = get<Binary_Expr>(id);
+        if (binary->left != EXPR_NONE)  visit(binary->left);
+        if (binary->right != EXPR_NONE) visit(binary->right);
+        break;
+      }
+      case ExprType::UNARY: {
+        auto unary = get<Unary_Expr>(id);
+        if (unary->operand != EXPR_NONE) visit(unary->operand);
+        break;
+      }
+      case ExprType::GROUPING: {
+        auto grouping = get<Grouping_Expr>(id);
+        if (grouping->expr != EXPR_NONE) visit(grouping->expr);
+        break;
+      }
+      case ExprType::CALL: {
+        auto call = get<Call_Expr>(id);
+        if (call->expression != EXPR_NONE) visit(call->expression);
+        for (auto argument : list(call->arguments)) {
+          visit(argument);
+        }
+        break;
+      }
+      case ExprType::MEMBER: {
+        auto member = get<Member_Expr>(id);
+        if (member->expression != EXPR_NONE) visit(member->expression);
+        break;
+      }
+      case ExprType::VARIABLE:
+      case ExprType::LITERAL:
+        break;
+      default: panic_and_abort("Invalid expression type");
+    }
+  }
+
+  // moves the nodes and lists of other to the end of this one, other.program is left for the caller to translate
+  Ast_Rebase append(const Ast& other);
+
+  size_t node_count() const;
+  size_t memory_used() const;  // in bytes, the arrays themselves without what they reserved
+
+  void free();
+};
+
+template <> inline DArray<Binary_Expr>&    Ast::pool<Binary_Expr>()    { return binaries; }
+template <> inline DArray<Unary_Expr>&     Ast::pool<Unary_Expr>()     { return unaries; }
+template <> inline DArray<Grouping_Expr>&  Ast::pool<Grouping_Expr>()  { return groupings; }
+template <> inline DArray<Variable_Expr>&  Ast::pool<Variable_Expr>()  { return variables; }
+template <> inline DArray<Literal>&        Ast::pool<Literal>()        { return literals; }
+template <> inline DArray<Call_Expr>&      Ast::pool<Call_Expr>()      { return calls; }
+template <> inline DArray<Member_Expr>&    Ast::pool<Member_Expr>()    { return members; }
+
+template <> inline DArray<Decl_Var_Stmt>&  Ast::pool<Decl_Var_Stmt>()  { return decl_vars; }
+template <> inline DArray<Decl_Proc_Stmt>& Ast::pool<Decl_Proc_Stmt>() { return decl_procs; }
+template <> inline DArray<If_Stmt>&        Ast::pool<If_Stmt>()        { return ifs; }
+template <> inline DArray<For_Stmt>&       Ast::pool<For_Stmt>()       { return fors; }
+template <> inline DArray<Assign_Stmt>&    Ast::pool<Assign_Stmt>()    { return assigns; }
+template <> inline DArray<Block_Stmt>&     Ast::pool<Block_Stmt>()     { return blocks; }
+template <> inline DArray<Expr_Stmt>&      Ast::pool<Expr_Stmt>()      { return expr_stmts; }
+template <> inline DArray<Import_Stmt>&    Ast::pool<Import_Stmt>()    { return imports; }
+template <> inline DArray<Return_Stmt>&    Ast::pool<Return_Stmt>()    { return returns; }
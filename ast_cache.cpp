@@ -0,0 +1,574 @@
+#include "ast_cache.hpp"
+#include "intern.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const char AST_CACHE_MAGIC[8] = { 'T', 'P', 'Z', 'A', 'S', 'T', '\0', '\0' };
+static const u32 AST_CACHE_VERSION = 3;
+static const u64 AST_CACHE_ALIGNMENT = 16;  // of every section in the file
+
+enum Cache_Section {
+  SECTION_BINARIES, SECTION_UNARIES, SECTION_GROUPINGS, SECTION_VARIABLES, SECTION_LITERALS, SECTION_CALLS, SECTION_MEMBERS,
+  SECTION_DECL_VARS, SECTION_DECL_PROCS, SECTION_IFS, SECTION_FORS, SECTION_ASSIGNS, SECTION_BLOCKS, SECTION_EXPR_STMTS,
+  SECTION_IMPORTS, SECTION_RETURNS,
+
+  SECTION_EXPR_LISTS, SECTION_STMT_LISTS, SECTION_DECL_LISTS,
+
+  // only with lazy bodies
+  SECTION_TOKEN_TYPES, SECTION_TOKEN_OFFSETS, SECTION_TOKEN_LENGTHS, SECTION_TOKEN_SYMBOLS,
+  SECTION_LITERAL_TOKENS, SECTION_LITERAL_VALUES,
+
+  // names of the symbols 1..n at the time the entry was written
+  SECTION_SYMBOL_LENGTHS, SECTION_SYMBOL_BYTES,
+
+  SECTION_COUNT
+};
+
+struct Cache_Range {
+  u64 offset = 0;  // from the start of the file
+  u64 count = 0;   // elements
+};
+
+struct Ast_Cache_Header {
+  char magic[8];
+  u32 version;
+  u32 lazy_bodies;
+  u64 layout;  // of the nodes, a build with different structs doesn't use the entry
+  u64 source_hash;
+  u64 source_size;
+  Stmt_List program;
+  Cache_Range sections[SECTION_COUNT];
+};
+
+static size_t section_element_size(int section) {
+  switch (section) {
+    case SECTION_BINARIES:       return sizeof(Binary_Expr);
+    case SECTION_UNARIES:        return sizeof(Unary_Expr);
+    case SECTION_GROUPINGS:      return sizeof(Grouping_Expr);
+    case SECTION_VARIABLES:      return sizeof(Variable_Expr);
+    case SECTION_LITERALS:       return sizeof(Literal);
+    case SECTION_CALLS:          return sizeof(Call_Expr);
+    case SECTION_MEMBERS:        return sizeof(Member_Expr);
+    case SECTION_DECL_VARS:      return sizeof(Decl_Var_Stmt);
+    case SECTION_DECL_PROCS:     return sizeof(Decl_Proc_Stmt);
+    case SECTION_IFS:            return sizeof(If_Stmt);
+    case SECTION_FORS:           return sizeof(For_Stmt);
+    case SECTION_ASSIGNS:        return sizeof(Assign_Stmt);
+    case SECTION_BLOCKS:         return sizeof(Block_Stmt);
+    case SECTION_EXPR_STMTS:     return sizeof(Expr_Stmt);
+    case SECTION_IMPORTS:        return sizeof(Import_Stmt);
+    case SECTION_RETURNS:        return sizeof(Return_Stmt);
+    case SECTION_EXPR_LISTS:     return sizeof(Expr_ID);
+    case SECTION_STMT_LISTS:     return sizeof(Stmt_ID);
+    case SECTION_DECL_LISTS:     return sizeof(Decl_Var);
+    case SECTION_TOKEN_TYPES:    return sizeof(u8);
+    case SECTION_TOKEN_OFFSETS:  return sizeof(u32);
+    case SECTION_TOKEN_LENGTHS:  return sizeof(u32);
+    case SECTION_TOKEN_SYMBOLS:  return sizeof(Symbol);
+    case SECTION_LITERAL_TOKENS: return sizeof(u32);
+    case SECTION_LITERAL_VALUES: return sizeof(Value);
+    case SECTION_SYMBOL_LENGTHS: return sizeof(u32);
+    case SECTION_SYMBOL_BYTES:   return sizeof(char);
+    default: panic_and_abort("Invalid ast cache section");
+  }
+}
+
+static u64 node_layout() {
+  u64 sizes[SECTION_COUNT];
+  for (int i = 0; i < SECTION_COUNT; i++) {
+    sizes[i] = section_element_size(i);
+  }
+
+  return hash_bytes(sizes, sizeof(sizes));
+}
+
+static void entry_path(char* path, size_t size, const char* cache_dir, u64 source_hash, bool lazy_bodies) {
+  snprintf(path, size, "%s/%016llx%s.ast", cache_dir, (unsigned long long)source_hash, lazy_bodies ? "-lazy" : "");
+}
+
+#ifndef _WIN32
+
+// string literals point into the source, in the file they are offsets from its start
+static bool strings_to_offsets(Value* values, size_t count, String source) {
+  for (size_t i = 0; i < count; i++) {
+    if (values[i].type != Value::STRING) continue;
+
+    String string = values[i].value.string;
+    if (string.data < source.data || string.data + string.size > source.data + source.size) return false;
+    values[i].value.string.data = (char*)(uintptr_t)(string.data - source.data);
+  }
+
+  return true;
+}
+
+static void offsets_to_strings(Value* values, size_t count, String source) {
+  for (size_t i = 0; i < count; i++) {
+    if (values[i].type != Value::STRING) continue;
+    values[i].value.string.data = (char*)source.data + (uintptr_t)values[i].value.string.data;
+  }
+}
+
+struct Cache_Writer {
+  FILE* file;
+  u64 offset = 0;
+  bool failed = false;
+
+  void write(const void* data, size_t size) {
+    if (size && fwrite(data, 1, size, file) != size) failed = true;
+    offset += size;
+  }
+
+  template <typename T>
+  Cache_Range section(const T* data, size_t count) {
+    static const char padding[AST_CACHE_ALIGNMENT] = {0};
+    write(padding, (AST_CACHE_ALIGNMENT - offset % AST_CACHE_ALIGNMENT) % AST_CACHE_ALIGNMENT);
+
+    Cache_Range range;
+    range.offset = offset;
+    range.count = count;
+    write(data, count * sizeof(T));
+    return range;
+  }
+
+  template <typename T>
+  Cache_Range section(const DArray<T>& array) {
+    return section(array.data, array.size);
+  }
+};
+
+void store_cached_ast(const Ast* ast, String source, u64 source_hash, const char* cache_dir, bool lazy_bodies) {
+  if (lazy_bodies && !ast->tokens) return;
+
+  // the strings are rewritten on copies
+  DArray<Literal> literals(ast->literals.size + 1);
+  for (size_t i = 0; i < ast->literals.size; i++) literals.add(ast->literals.data[i]);
+
+  DArray<Value> literal_values(lazy_bodies ? ast->tokens->literal_values.size + 1 : 1);
+  if (lazy_bodies) {
+    for (size_t i = 0; i < ast->tokens->literal_values.size; i++) literal_values.add(ast->tokens->literal_values.data[i]);
+  }
+
+  bool relocatable = strings_to_offsets(literal_values.data, literal_values.size, source);
+  for (size_t i = 0; i < literals.size && relocatable; i++) {
+    relocatable = strings_to_offsets(&literals.data[i].value, 1, source);
+  }
+
+  DArray<u32> symbol_lengths(symbol_count() + 1);
+  String_Builder symbol_bytes(1024);
+  for (Symbol symbol = 1; symbol <= symbol_count(); symbol++) {
+    String name = symbol_name(symbol);
+    symbol_lengths.add((u32)name.size);
+    symbol_bytes.append(name);
+  }
+
+  char path[1024];
+  char temporary[1100];
+  entry_path(path, sizeof(path), cache_dir, source_hash, lazy_bodies);
+  snprintf(temporary, sizeof(temporary), "%s.%d.tmp", path, (int)getpid());  // renamed into place when complete
+
+  mkdir(cache_dir, 0755);  // if it exists this fails, which is fine
+  FILE* file = relocatable ? fopen(temporary, "wb") : NULL;
+  if (file) {
+    Ast_Cache_Header header = {};
+    memcpy(header.magic, AST_CACHE_MAGIC, sizeof(header.magic));
+    header.version = AST_CACHE_VERSION;
+    header.lazy_bodies = lazy_bodies;
+    header.layout = node_layout();
+    header.source_hash = source_hash;
+    header.source_size = source.size;
+    header.program = ast->program;
+
+    Cache_Writer writer;
+    writer.file = file;
+    writer.write(&header, sizeof(header));  // again with the sections at the end
+
+    header.sections[SECTION_BINARIES]   = writer.section(ast->binaries);
+    header.sections[SECTION_UNARIES]    = writer.section(ast->unaries);
+    header.sections[SECTION_GROUPINGS]  = writer.section(ast->groupings);
+    header.sections[SECTION_VARIABLES]  = writer.section(ast->variables);
+    header.sections[SECTION_LITERALS]   = writer.section(literals);
+    header.sections[SECTION_CALLS]      = writer.section(ast->calls);
+    header.sections[SECTION_MEMBERS]    = writer.section(ast->members);
+    header.sections[SECTION_DECL_VARS]  = writer.section(ast->decl_vars);
+    header.sections[SECTION_DECL_PROCS] = writer.section(ast->decl_procs);
+    header.sections[SECTION_IFS]        = writer.section(ast->ifs);
+    header.sections[SECTION_FORS]       = writer.section(ast->fors);
+    header.sections[SECTION_ASSIGNS]    = writer.section(ast->assigns);
+    header.sections[SECTION_BLOCKS]     = writer.section(ast->blocks);
+    header.sections[SECTION_EXPR_STMTS] = writer.section(ast->expr_stmts);
+    header.sections[SECTION_IMPORTS]    = writer.section(ast->imports);
+    header.sections[SECTION_RETURNS]    = writer.section(ast->returns);
+
+    header.sections[SECTION_EXPR_LISTS] = writer.section(ast->expr_lists);
+    header.sections[SECTION_STMT_LISTS] = writer.section(ast->stmt_lists);
+    header.sections[SECTION_DECL_LISTS] = writer.section(ast->decl_lists);
+
+    if (lazy_bodies) {
+      header.sections[SECTION_TOKEN_TYPES]    = writer.section(ast->tokens->types);
+      header.sections[SECTION_TOKEN_OFFSETS]  = writer.section(ast->tokens->offsets);
+      header.sections[SECTION_TOKEN_LENGTHS]  = writer.section(ast->tokens->lengths);
+      header.sections[SECTION_TOKEN_SYMBOLS]  = writer.section(ast->tokens->symbols);
+      header.sections[SECTION_LITERAL_TOKENS] = writer.section(ast->tokens->literal_tokens);
+      header.sections[SECTION_LITERAL_VALUES] = writer.section(literal_values);
+    }
+
+    header.sections[SECTION_SYMBOL_LENGTHS] = writer.section(symbol_lengths);
+    header.sections[SECTION_SYMBOL_BYTES]   = writer.section(symbol_bytes.buffer, symbol_bytes.cursor);
+
+    if (fseek(file, 0, SEEK_SET) != 0) writer.failed = true;
+    writer.write(&header, sizeof(header));
+
+    if (fclose(file) != 0) writer.failed = true;
+    if (writer.failed || rename(temporary, path) != 0) {
+      remove(temporary);
+    }
+  }
+
+  literals.free();
+  literal_values.free();
+  symbol_lengths.free();
+  symbol_bytes.free();
+}
+
+// the pool is left pointing into the mapping. it is marked as arena storage so nothing tries to delete it,
+// if it grows the new storage comes from the arena
+template <typename T>
+static void attach(DArray<T>* array, char* base, Cache_Range range, Linear_Allocator* arena) {
+  array->free();
+  array->data = (T*)(base + range.offset);
+  array->size = range.count;
+  array->capacity = range.count;
+  array->arena = arena;
+}
+
+static void remap(Symbol* symbol, const DArray<Symbol>& symbols) {
+  if (*symbol < symbols.size) *symbol = symbols.data[*symbol];
+}
+
+// the interner handed out different ids this time, every symbol of the tree goes through the table
+static void remap_symbols(Ast* ast, const DArray<Symbol>& symbols) {
+  for (auto& variable : ast->variables)  remap(&variable.identifier, symbols);
+  for (auto& member : ast->members)      remap(&member.member, symbols);
+  for (auto& decl_var : ast->decl_vars)  remap(&decl_var.decl.name, symbols);
+  for (auto& proc : ast->decl_procs)     remap(&proc.name, symbols);
+  for (auto& assign : ast->assigns)      remap(&assign.target, symbols);
+  for (auto& import : ast->imports)      remap(&import.module_name, symbols);
+  for (auto& decl : ast->decl_lists)     remap(&decl.name, symbols);
+
+  if (ast->tokens) {
+    for (auto& symbol : ast->tokens->symbols) remap(&symbol, symbols);
+  }
+}
+
+// the header only says the sections fit in the file, what is in them is looked at here before anything follows an id.
+// a corrupted entry has to be a miss, not a read out of the pools
+struct Entry_Check {
+  const Ast* ast;
+  String source;
+  u64 symbols;  // the entry names the symbols [1, symbols]
+  u64 tokens;   // 0 without lazy bodies
+
+  bool offset(int at) const {
+    return at >= 0 && (u64)at <= source.size;
+  }
+
+  bool symbol(Symbol name) const {
+    return name <= symbols;
+  }
+
+  bool type(Type_ID type) const {
+    return type <= Type::NIL;  // the parser only gives the basic types
+  }
+
+  bool operation(Operator op) const {
+    return (u32)op < (u32)TokenType::COUNT;
+  }
+
+  // string literals are still offsets into the source here
+  bool value(const Value& value) const {
+    if ((u32)value.type > (u32)Value::NIL) return false;
+    if (value.type != Value::STRING) return true;
+
+    u64 at = (u64)(uintptr_t)value.value.string.data;
+    return at <= source.size && value.value.string.size <= source.size - at;
+  }
+
+  bool expr(Expr_ID id) const {
+    u32 index = node_index(id);
+    switch (expr_type(id)) {
+      case ExprType::BINARY:   return index < ast->binaries.size;
+      case ExprType::UNARY:    return index < ast->unaries.size;
+      case ExprType::GROUPING: return index < ast->groupings.size;
+      case ExprType::VARIABLE: return index < ast->variables.size;
+      case ExprType::LITERAL:  return index < ast->literals.size;
+      case ExprType::CALL:     return index < ast->calls.size;
+      case ExprType::MEMBER:   return index < ast->members.size;
+      default: return false;
+    }
+  }
+
+  bool stmt(Stmt_ID id) const {
+    u32 index = node_index(id);
+    switch (stmt_kind(id)) {
+      case StmtKind::DECL_VAR:   return index < ast->decl_vars.size;
+      case StmtKind::DECL_PROC:  return index < ast->decl_procs.size;
+      case StmtKind::IF:         return index < ast->ifs.size;
+      case StmtKind::FOR:        return index < ast->fors.size;
+      case StmtKind::ASSIGN:     return index < ast->assigns.size;
+      case StmtKind::BLOCK:      return index < ast->blocks.size;
+      case StmtKind::EXPRESSION: return index < ast->expr_stmts.size;
+      case StmtKind::IMPORT:     return index < ast->imports.size;
+      case StmtKind::RETURN:     return index < ast->returns.size;
+      default: return false;
+    }
+  }
+
+  bool child(Expr_ID id) const { return id == EXPR_NONE || expr(id); }
+  bool child_stmt(Stmt_ID id) const { return id == STMT_NONE || stmt(id); }
+
+  bool list(Expr_List range) const { return (u64)range.first + range.count <= ast->expr_lists.size; }
+  bool list(Stmt_List range) const { return (u64)range.first + range.count <= ast->stmt_lists.size; }
+  bool list(Decl_List range) const { return (u64)range.first + range.count <= ast->decl_lists.size; }
+
+  bool decl(const Decl_Var& decl) const {
+    return symbol(decl.name) && offset(decl.offset) && type(decl.type);
+  }
+
+  bool proc(const Decl_Proc_Stmt& proc) const {
+    if (!symbol(proc.name) || !offset(proc.offset) || !offset(proc.end_offset) ||
+        !list(proc.parameters) || !list(proc.returns) || !list(proc.body)) return false;
+
+    switch (proc.body_state) {
+      case BodyState::PARSED: return true;
+      case BodyState::SKIPPED:
+      case BodyState::REQUESTED: return proc.body_begin <= proc.body_end && proc.body_end < tokens;
+      default: return false;
+    }
+  }
+
+  bool nodes() const {
+    for (auto& node : ast->binaries) {
+      if (!offset(node.location.offset) || !child(node.left) || !child(node.right) || !operation(node.opperator)) return false;
+    }
+    for (auto& node : ast->unaries) {
+      if (!offset(node.location.offset) || !child(node.operand) || !operation(node.opperator)) return false;
+    }
+    for (auto& node : ast->groupings) {
+      if (!offset(node.location.offset) || !child(node.expr)) return false;
+    }
+    for (auto& node : ast->variables) {
+      if (!offset(node.location.offset) || !symbol(node.identifier)) return false;
+    }
+    for (auto& node : ast->literals) {
+      if (!offset(node.location.offset) || !value(node.value)) return false;
+    }
+    for (auto& node : ast->calls) {
+      if (!offset(node.location.offset) || !child(node.expression) || !list(node.arguments)) return false;
+    }
+    for (auto& node : ast->members) {
+      if (!offset(node.location.offset) || !child(node.expression) || !symbol(node.member)) return false;
+    }
+
+    for (auto& node : ast->decl_vars) {
+      if (!decl(node.decl) || !child(node.initializer)) return false;
+    }
+    for (auto& node : ast->decl_procs) {
+      if (!proc(node)) return false;
+    }
+    for (auto& node : ast->ifs) {
+      if (!child(node.cond) || !stmt(node.then_stmt) || !child_stmt(node.else_stmt)) return false;
+    }
+    for (auto& node : ast->fors) {
+      if (!child(node.condition) || !child_stmt(node.body)) return false;
+    }
+    for (auto& node : ast->assigns) {
+      if (!symbol(node.target) || !offset(node.offset) || !child(node.rhs)) return false;
+    }
+    for (auto& node : ast->blocks) {
+      if (!list(node.body)) return false;
+    }
+    for (auto& node : ast->expr_stmts) {
+      if (!child(node.expr)) return false;
+    }
+    for (auto& node : ast->imports) {
+      if (!symbol(node.module_name) || !offset(node.offset)) return false;
+    }
+    for (auto& node : ast->returns) {
+      if (!list(node.returns)) return false;
+    }
+
+    for (auto id : ast->expr_lists) {
+      if (!expr(id)) return false;
+    }
+    for (auto id : ast->stmt_lists) {
+      if (!stmt(id)) return false;
+    }
+    for (auto& decl_var : ast->decl_lists) {
+      if (!decl(decl_var)) return false;
+    }
+
+    return list(ast->program);
+  }
+
+  bool token_buffer(const Token_Buffer* buffer) const {
+    if (buffer->offsets.size != tokens || buffer->lengths.size != tokens || buffer->symbols.size != tokens ||
+        buffer->literal_values.size != buffer->literal_tokens.size) return false;
+
+    for (u64 i = 0; i < tokens; i++) {
+      u64 at = buffer->offsets.data[i];
+      if (buffer->types.data[i] >= (u8)TokenType::COUNT || at > source.size || buffer->lengths.data[i] > source.size - at ||
+          !symbol(buffer->symbols.data[i])) return false;
+    }
+
+    // looked up with a binary search, so in increasing order
+    for (size_t i = 0; i < buffer->literal_tokens.size; i++) {
+      if (buffer->literal_tokens.data[i] >= tokens || (i && buffer->literal_tokens.data[i] <= buffer->literal_tokens.data[i - 1]) ||
+          !value(buffer->literal_values.data[i])) return false;
+    }
+
+    return true;
+  }
+};
+
+bool load_cached_ast(Ast* ast, String source, u64 source_hash, const char* cache_dir, bool lazy_bodies, Linear_Allocator* arena) {
+  char path[1024];
+  entry_path(path, sizeof(path), cache_dir, source_hash, lazy_bodies);
+
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) return false;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(Ast_Cache_Header)) {
+    close(fd);
+    return false;
+  }
+
+  // private and writable, the later passes fill in the nodes and the file itself is never touched
+  size_t size = (size_t)info.st_size;
+  void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) return false;
+
+  char* base = (char*)mapping;
+  const Ast_Cache_Header* header = (const Ast_Cache_Header*)base;
+
+  bool valid = memcmp(header->magic, AST_CACHE_MAGIC, sizeof(AST_CACHE_MAGIC)) == 0 &&
+               header->version == AST_CACHE_VERSION &&
+               header->lazy_bodies == (u32)lazy_bodies &&
+               header->layout == node_layout() &&
+               header->source_hash == source_hash &&
+               header->source_size == source.size;
+
+  for (int i = 0; i < SECTION_COUNT && valid; i++) {
+    Cache_Range range = header->sections[i];
+    valid = range.offset % AST_CACHE_ALIGNMENT == 0 && range.offset <= size &&
+            range.count <= (size - range.offset) / section_element_size(i);
+  }
+
+  if (!valid) {
+    munmap(mapping, size);
+    return false;
+  }
+
+  const Cache_Range* sections = header->sections;
+  ast->program = header->program;
+
+  attach(&ast->binaries,   base, sections[SECTION_BINARIES], arena);
+  attach(&ast->unaries,    base, sections[SECTION_UNARIES], arena);
+  attach(&ast->groupings,  base, sections[SECTION_GROUPINGS], arena);
+  attach(&ast->variables,  base, sections[SECTION_VARIABLES], arena);
+  attach(&ast->literals,   base, sections[SECTION_LITERALS], arena);
+  attach(&ast->calls,      base, sections[SECTION_CALLS], arena);
+  attach(&ast->members,    base, sections[SECTION_MEMBERS], arena);
+  attach(&ast->decl_vars,  base, sections[SECTION_DECL_VARS], arena);
+  attach(&ast->decl_procs, base, sections[SECTION_DECL_PROCS], arena);
+  attach(&ast->ifs,        base, sections[SECTION_IFS], arena);
+  attach(&ast->fors,       base, sections[SECTION_FORS], arena);
+  attach(&ast->assigns,    base, sections[SECTION_ASSIGNS], arena);
+  attach(&ast->blocks,     base, sections[SECTION_BLOCKS], arena);
+  attach(&ast->expr_stmts, base, sections[SECTION_EXPR_STMTS], arena);
+  attach(&ast->imports,    base, sections[SECTION_IMPORTS], arena);
+  attach(&ast->returns,    base, sections[SECTION_RETURNS], arena);
+
+  attach(&ast->expr_lists, base, sections[SECTION_EXPR_LISTS], arena);
+  attach(&ast->stmt_lists, base, sections[SECTION_STMT_LISTS], arena);
+  attach(&ast->decl_lists, base, sections[SECTION_DECL_LISTS], arena);
+
+  Token_Buffer* tokens = NULL;
+  if (lazy_bodies) {
+    tokens = arena_new<Token_Buffer>(arena, source);
+    attach(&tokens->types,          base, sections[SECTION_TOKEN_TYPES], arena);
+    attach(&tokens->offsets,        base, sections[SECTION_TOKEN_OFFSETS], arena);
+    attach(&tokens->lengths,        base, sections[SECTION_TOKEN_LENGTHS], arena);
+    attach(&tokens->symbols,        base, sections[SECTION_TOKEN_SYMBOLS], arena);
+    attach(&tokens->literal_tokens, base, sections[SECTION_LITERAL_TOKENS], arena);
+    attach(&tokens->literal_values, base, sections[SECTION_LITERAL_VALUES], arena);
+  }
+
+  const u32* lengths = (const u32*)(base + sections[SECTION_SYMBOL_LENGTHS].offset);
+  u64 symbol_bytes = 0;
+  for (u64 i = 0; i < sections[SECTION_SYMBOL_LENGTHS].count; i++) symbol_bytes += lengths[i];
+
+  Entry_Check check;
+  check.ast = ast;
+  check.source = source;
+  check.symbols = sections[SECTION_SYMBOL_LENGTHS].count;
+  check.tokens = lazy_bodies ? tokens->types.size : 0;
+
+  if (symbol_bytes != sections[SECTION_SYMBOL_BYTES].count || !check.nodes() || (tokens && !check.token_buffer(tokens))) {
+    // the pools go back to empty ones, they pointed into the mapping
+    bool hash_consing = ast->hash_consing;
+    *ast = Ast();
+    ast->hash_consing = hash_consing;
+
+    munmap(mapping, size);
+    return false;
+  }
+
+  for (auto& literal : ast->literals) {
+    offsets_to_strings(&literal.value, 1, source);
+  }
+
+  if (tokens) {
+    offsets_to_strings(tokens->literal_values.data, tokens->literal_values.size, source);
+    ast->tokens = tokens;
+    ast->arena = arena;
+  }
+
+  // symbols are handed out in order, so a fresh interner gives back the same ids and nothing has to change
+  const char* bytes = base + sections[SECTION_SYMBOL_BYTES].offset;
+
+  DArray<Symbol> symbols(arena, sections[SECTION_SYMBOL_LENGTHS].count + 1);
+  symbols.add(SYMBOL_NONE);
+  bool same_ids = true;
+  for (u64 i = 0; i < sections[SECTION_SYMBOL_LENGTHS].count; i++) {
+    Symbol symbol = intern(String(bytes, lengths[i]));
+    if (symbol != symbols.size) same_ids = false;
+    symbols.add(symbol);
+
+    bytes += lengths[i];
+  }
+
+  if (!same_ids) {
+    remap_symbols(ast, symbols);
+  }
+
+  ast->mapping = mapping;
+  ast->mapping_size = size;
+  return true;
+}
+
+#else
+
+bool load_cached_ast(Ast* ast, String source, u64 source_hash, const char* cache_dir, bool lazy_bodies, Linear_Allocator* arena) {
+  return false;
+}
+
+void store_cached_ast(const Ast* ast, String source, u64 source_hash, const char* cache_dir, bool lazy_bodies) {}
+
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "common.hpp"
+#include "ast.hpp"
+#include "linear_allocator.h"
+
+// on disk cache of parsed syntax trees, an entry is found by the hash of the source it was parsed from.
+// the file is the pools and lists of the ast one after another and a header with where each of them starts.
+// nodes only refer to each other with ids and ranges, so the file is mapped and the pools point into the mapping,
+// nothing is read node by node. the only fix ups are string literals (stored as offsets into the source) and
+// symbols when the interner doesn't hand out the same ids as it did when the entry was written.
+// a tree parsed with lazy bodies is stored with its tokens, the skipped bodies are parsed from those.
+
+// fills the ast from the entry for the source, false if there is none or it doesn't match this build
+bool load_cached_ast(Ast* ast, String source, u64 source_hash, const char* cache_dir, bool lazy_bodies, Linear_Allocator* arena);
+
+// writes an entry for the ast of the source, lazy_bodies needs ast->tokens. this is only a cache, so failing is quiet
+void store_cached_ast(const Ast* ast, String source, u64 source_hash, const char* cache_dir, bool lazy_bodies);
@@ -3,13 +3,6 @@
 #include <cstddef>
 #include <cstdint>
 
-typedef uint8_t  u8;
-typedef uint16_t u16;
-typedef uint32_t u32;
-typedef uint64_t u64;
-
-typedef int32_t s32;
-
 // - statically check opcode-operand count
 // - statically check constant indexing
 // - statically check memory accesses
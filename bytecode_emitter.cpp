@@ -5,12 +5,12 @@
 static void zero_terminate(Code_Block* block);
 static void code_block_maybe_grow(Code_Block* code, int desired_storage);
 
-DArray<Code_Block> output_bytecode(ArrayView<IR_Instr> program, ArrayView<Environment> declarations) {
+DArray<Code_Block> output_bytecode(ArrayView<IR_Instr> program, const Scope_Table* declarations) {
   return DArray<Code_Block>();
 }
 
 // @todo register allocator
-Code_Block emit_bytecode(ArrayView<IR_Instr> ir_code, ArrayView<Environment> declarations) {
+Code_Block emit_bytecode(ArrayView<IR_Instr> ir_code, const Scope_Table* declarations) {
   Code_Block output;
 
   Processor processor;
@@ -5,9 +5,9 @@
 #include "ir.hpp"
 #include "bytecode.hpp"
 
-struct Environment;
+struct Scope_Table;
 
-DArray<Code_Block> output_bytecode(ArrayView<IR_Instr> program, ArrayView<Environment> declarations);
+DArray<Code_Block> output_bytecode(ArrayView<IR_Instr> program, const Scope_Table* declarations);
 
 // @todo this will need a register allocator if we will only have 10 registers in the bytecode
 
@@ -21,4 +21,4 @@ void emit_bytecode_binary_op(Code_Block* code, Register operand1, Register opera
 // void emit_bytecode_unary_op(Code_Block* code, Register reg, Unary_Operation unop);
 void emit_bytecode_return(Code_Block* code);
 
-Code_Block emit_bytecode(ArrayView<IR_Instr> block, ArrayView<Environment> declarations);
+Code_Block emit_bytecode(ArrayView<IR_Instr> block, const Scope_Table* declarations);
@@ -1,14 +1,16 @@
 #include "c_emitter.hpp"
 #include "common.hpp"
 #include "stmt.hpp"
+#include "ast.hpp"
 #include "environment.hpp"
+#include "dependency.hpp"
 
 // @todo complete
 
-static void translate_statement(Stmt* statement, FILE* output, String_Builder* sb);
-static void dump_declarations(ArrayView<Environment> decls, FILE* output_file);
+static void translate_statement(const Ast* ast, const Dependency_Graph* dependencies, Stmt_ID statement, FILE* output, String_Builder* sb);
+static void dump_declarations(const Scope_Table* decls, FILE* output_file);
 
-void output_c_code(ArrayView<Stmt*> program, ArrayView<Environment> decls, FILE* output_file) {
+void output_c_code(const Ast* ast, const Scope_Table* decls, const Dependency_Graph* dependencies, FILE* output_file) {
     auto output = output_file;
 
     String includes = String("#include <stdlib.h>\n#include <stdio.h>\n#include <string.h>\n");
@@ -16,53 +18,51 @@ void output_c_code(ArrayView<Stmt*> program, ArrayView<Environment> decls, FILE*
 
     String_Builder sb = String_Builder(512);
 
-    for (auto top_level : program) {
-      translate_statement(top_level, output, &sb);
+    for (auto top_level : ast->list(ast->program)) {
+      translate_statement(ast, dependencies, top_level, output, &sb);
     }
 
     fclose(output);
 }
 
 // @todo
-static void dump_declarations(ArrayView<Environment> decls, FILE* output) {
+static void dump_declarations(const Scope_Table* decls, FILE* output) {
   // @todo type declarations first when they are a thing
   // they also need to have some sort of dependency info so they will be outputed in the correct order
 
   // global declarations on the top of the file
-  auto global = decls.get_ref(0);
-
-  for (int i = 0; i < global->variables.size; i++) {
-    auto symbol = global->variable_names.get(i);
-    auto var = global->variables.get(i);
-  }
+  decls->for_each_variable(0, [&](Symbol symbol, const Variable& var) {
+  });
 
 
-  for (int i = 0; i < decls.count; i++) {
+  for (int i = 0; i < decls->scopes.size; i++) {
   }
 }
 
 // simple recursive implementation
 // this is not a proper implementation for quick prototyping.
-static void translate_statement(Stmt* statement, FILE* output, String_Builder* sb) {
-  switch (statement->kind) {
+static void translate_statement(const Ast* ast, const Dependency_Graph* dependencies, Stmt_ID statement, FILE* output, String_Builder* sb) {
+  switch (stmt_kind(statement)) {
   case StmtKind::DECL_VAR: {
-    auto decl_var = static_cast<Decl_Var_Stmt*>(statement);
+    auto decl_var = ast->get<Decl_Var_Stmt>(statement);
 
-    sb->clear_and_append(decl_var->decl.name.lexeme);
+    sb->clear_and_append(symbol_name(decl_var->decl.name));
     fprintf(output, "%s %s ", type_string(decl_var->decl.type), sb->c_string());  // @fixme non-basic type names + c type names
-    if (decl_var->initializer) {
-      expression_string(decl_var->initializer, sb);
+    if (decl_var->initializer != EXPR_NONE) {
+      expression_string(ast, decl_var->initializer, sb);
       fprintf(output, "= %s", sb->c_string());
     }
     fprintf(output, ";\n");
     break;
   }
   case StmtKind::DECL_PROC: {
-    auto proc = static_cast<Decl_Proc_Stmt*>(statement);
+    auto proc = ast->get<Decl_Proc_Stmt>(statement);
+    if (proc->body_state != BodyState::PARSED) break;  // nothing uses it
+    if (!dependencies->procedure_reachable(proc->proc_id)) break;
 
-    sb->clear_and_append(proc->name.lexeme);
+    sb->clear_and_append(symbol_name(proc->name));
 
-    auto returns = proc->returns;
+    auto returns = ast->list(proc->returns);
     if (returns.count) {
       // @todo if this is a multi return value procedure, make a new typedef to hold return values for this
       fprintf(output, "%s ", type_string(returns.get(0).type));
@@ -72,80 +72,79 @@ static void translate_statement(Stmt* statement, FILE* output, String_Builder* s
     }
     fprintf(output, "%s(", sb->c_string());
 
-    for (int i = 0; i < proc->parameters.count; i++) {
-      auto param = proc->parameters.get(i);
+    auto parameters = ast->list(proc->parameters);
+    for (int i = 0; i < parameters.count; i++) {
+      auto param = parameters.get(i);
 
-      sb->clear_and_append(param.name.lexeme);
+      sb->clear_and_append(symbol_name(param.name));
       fprintf(output, "%s %s", type_string(param.type), sb->c_string());
-      if (i != proc->parameters.count-1)
+      if (i != parameters.count-1)
         fprintf(output, ",");
     }
 
     fprintf(output, ") {\n");
 
-    for (auto bstmt : proc->body) {
-      translate_statement(bstmt, output, sb);
+    for (auto bstmt : ast->list(proc->body)) {
+      translate_statement(ast, dependencies, bstmt, output, sb);
     }
 
     fprintf(output, "}\n");
     break;
   }
   case StmtKind::ASSIGN: {
-    auto assign = static_cast<Assign_Stmt*>(statement);
+    auto assign = ast->get<Assign_Stmt>(statement);
 
-    sb->clear_and_append(assign->target.lexeme);
+    sb->clear_and_append(symbol_name(assign->target));
     fprintf(output, "%s", sb->c_string());
-    expression_string(assign->rhs, sb);
+    expression_string(ast, assign->rhs, sb);
     fprintf(output, " = %s\n", sb->c_string());
     break;
   }
   case StmtKind::BLOCK: {
-    auto block = static_cast<Block_Stmt*>(statement);
+    auto block = ast->get<Block_Stmt>(statement);
 
     fprintf(output, "{\n");
-    for (auto block_s : block->body) {
-      translate_statement(block_s, output, sb);
+    for (auto block_s : ast->list(block->body)) {
+      translate_statement(ast, dependencies, block_s, output, sb);
     }
     printf("}\n");
     break;
   }
   case StmtKind::IF: {
-    auto if_s = static_cast<If_Stmt*>(statement);
+    auto if_s = ast->get<If_Stmt>(statement);
 
-    expression_string(if_s->cond, sb);
+    expression_string(ast, if_s->cond, sb);
     fprintf(output, "if (%s) {\n", sb->c_string());
-    translate_statement(if_s->then_stmt, output, sb);
+    translate_statement(ast, dependencies, if_s->then_stmt, output, sb);
 
-    if (if_s->else_stmt) {
+    if (if_s->else_stmt != STMT_NONE) {
       fprintf(output, "else {\n");
-      translate_statement(if_s->else_stmt, output, sb);
+      translate_statement(ast, dependencies, if_s->else_stmt, output, sb);
     }
 
     break;
   }
   case StmtKind::FOR: {
-    auto for_s = static_cast<For_Stmt*>(statement);
-    expression_string(for_s->condition, sb);
+    auto for_s = ast->get<For_Stmt>(statement);
+    expression_string(ast, for_s->condition, sb);
     fprintf(output, "while (%s) {\n", sb->c_string());
-    translate_statement(for_s->body, output, sb);
+    translate_statement(ast, dependencies, for_s->body, output, sb);
     fprintf(output, "}\n");
     break;
   }
   case StmtKind::IMPORT: {
-    auto import_s = static_cast<Import_Stmt*>(statement);
     // @todo how will the import system translate to C?
     break;
   }
   case StmtKind::EXPRESSION: {
-    auto expr_stmt = static_cast<Expr_Stmt*>(statement);
-    expression_string(expr_stmt->expr, sb);
+    auto expr_stmt = ast->get<Expr_Stmt>(statement);
+    expression_string(ast, expr_stmt->expr, sb);
     fprintf(output, "%s;\n", sb->c_string());
     break;
   }
   case StmtKind::RETURN: {
     panic_and_abort("C returns not implemented");
-    auto ret_stmt = static_cast<Return_Stmt*>(statement);
-    // expression_string(ret_stmt->return_expr, sb);
+    // expression_string(ast, ret_stmt->return_expr, sb);
     fprintf(output, "return %s;\n", sb->c_string());
     break;
   }
@@ -1,7 +1,8 @@
 #pragma once
 
 #include "template.hpp"
-struct Stmt;
-struct Environment;
+struct Ast;
+struct Scope_Table;
+struct Dependency_Graph;
 
-void output_c_code(ArrayView<Stmt*> program, ArrayView<Environment> decls, FILE* output_file);
+void output_c_code(const Ast* ast, const Scope_Table* decls, const Dependency_Graph* dependencies, FILE* output_file);
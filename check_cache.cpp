@@ -0,0 +1,287 @@
+#include "check_cache.hpp"
+#include "ast.hpp"
+#include "environment.hpp"
+#include "dependency.hpp"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+static const char CHECK_CACHE_MAGIC[8] = { 'T', 'P', 'Z', 'C', 'H', 'E', 'C', 'K' };
+static const u32 CHECK_CACHE_VERSION = 1;
+
+void Check_Cache::begin() {
+  generation++;
+  reused = 0;
+  checked = 0;
+}
+
+u32 Check_Cache::find(u64 key, int line) const {
+  const u32* result = index.get(key);
+  if (!result) return CHECK_NONE;
+
+  const Check_Result& found = results.data[*result];
+  if (found.line_sensitive && found.line != line) return CHECK_NONE;
+  return *result;
+}
+
+void Check_Cache::use(u32 result) {
+  Check_Result* used = results.get_ref(result);
+  used->generation = generation;
+  write_diagnostics(&output, used->first_entry, used->end_entry);
+  reused++;
+}
+
+void Check_Cache::add(u64 key, int line, bool success, Task_Diagnostics diagnostics) {
+  Check_Result result;
+  result.success = success;
+  result.line = line;
+  result.generation = generation;
+  result.first_entry = (u32)output.entries.size;
+
+  for (size_t i = diagnostics.first; i < diagnostics.end; i++) {
+    Diagnostic_Buffer::Entry entry = diagnostics.buffer->entries.data[i];
+    if (entry.to_stderr) result.line_sensitive = true;  // the errors are the ones with lines
+
+    u32 begin = (u32)output.text.size;
+    for (u32 c = entry.begin; c < entry.end; c++) {
+      output.text.add(diagnostics.buffer->text.data[c]);
+    }
+
+    entry.begin = begin;
+    entry.end = (u32)output.text.size;
+    output.entries.add(entry);
+  }
+  result.end_entry = (u32)output.entries.size;
+
+  bool added;
+  *index.find_or_add(key, &added) = (u32)results.size;  // a result for the same key from before goes away at end
+  results.add(result);
+  checked++;
+}
+
+void Check_Cache::end() {
+  Hash_Map<u64, u32> kept_index;
+  DArray<Check_Result> kept;
+  Diagnostic_Buffer kept_output;
+  kept_index.reserve(index.count);
+
+  index.for_each([&](u64 key, u32 result) {
+    Check_Result moved = results.data[result];
+    if (moved.generation + CHECK_CACHE_GENERATIONS < generation) return;  // the other files sharing the cache keep theirs
+
+    u32 first = (u32)kept_output.entries.size;
+    for (u32 i = moved.first_entry; i < moved.end_entry; i++) {
+      Diagnostic_Buffer::Entry entry = output.entries.data[i];
+      u32 begin = (u32)kept_output.text.size;
+      for (u32 c = entry.begin; c < entry.end; c++) {
+        kept_output.text.add(output.text.data[c]);
+      }
+
+      entry.begin = begin;
+      entry.end = (u32)kept_output.text.size;
+      kept_output.entries.add(entry);
+    }
+
+    moved.first_entry = first;
+    moved.end_entry = (u32)kept_output.entries.size;
+    kept_index.put(key, (u32)kept.size);
+    kept.add(moved);
+  });
+
+  free();
+  index = kept_index;
+  results = kept;
+  output = kept_output;
+}
+
+void Check_Cache::free() {
+  index.free();
+  results.free();
+  output.free();
+}
+
+static u64 hash_name(Symbol name, u64 hash) {
+  String text = symbol_name(name);
+  hash = hash_bytes(&text.size, sizeof(text.size), hash);
+  return hash_bytes(text.data, text.size, hash);
+}
+
+// what a procedure or global looks like from the outside
+static u64 hash_signature(const Scope_Table* scopes, const Dependency_Graph* dependencies, u32 node, u64 hash) {
+  if (!dependencies->is_procedure(node)) {
+    u32 slot = node - dependencies->procedure_count;
+    hash = hash_bytes("g", 1, hash);
+    hash = hash_name(scopes->global_names.get(slot), hash);
+    return hash_type(scopes->globals.slots.get(slot), hash);
+  }
+
+  hash = hash_bytes("p", 1, hash);
+  hash = hash_name(scopes->procedure_names.get(node), hash);
+  return hash_type(scopes->procedures.get_ref(node)->type, hash);
+}
+
+// the signatures of what the procedure and the ones declared in it use
+static u64 hash_uses(const Ast* ast, const Scope_Table* scopes, const Dependency_Graph* dependencies, Stmt_ID stmt, u64 hash) {
+  switch (stmt_kind(stmt)) {
+    case StmtKind::DECL_PROC: {
+      auto decl_proc = ast->get<Decl_Proc_Stmt>(stmt);
+      u32 node = dependencies->procedure_node(decl_proc->proc_id);
+      if (node >= dependencies->procedure_count) return hash;
+
+      bool reachable = dependencies->reachable[node];
+      hash = hash_bytes(&reachable, sizeof(reachable), hash);
+      for (auto dependency : dependencies->dependencies(node)) {
+        hash = hash_signature(scopes, dependencies, dependency, hash);
+      }
+
+      for (auto s : ast->list(decl_proc->body)) {
+        hash = hash_uses(ast, scopes, dependencies, s, hash);
+      }
+      return hash;
+    }
+    case StmtKind::BLOCK: {
+      for (auto s : ast->list(ast->get<Block_Stmt>(stmt)->body)) {
+        hash = hash_uses(ast, scopes, dependencies, s, hash);
+      }
+      return hash;
+    }
+    case StmtKind::IF: {
+      auto if_s = ast->get<If_Stmt>(stmt);
+      hash = hash_uses(ast, scopes, dependencies, if_s->then_stmt, hash);
+      if (if_s->else_stmt != STMT_NONE) hash = hash_uses(ast, scopes, dependencies, if_s->else_stmt, hash);
+      return hash;
+    }
+    case StmtKind::FOR:
+      return hash_uses(ast, scopes, dependencies, ast->get<For_Stmt>(stmt)->body, hash);
+    default:
+      return hash;
+  }
+}
+
+u64 procedure_check_key(const Ast* ast, String source, const Scope_Table* scopes, const Dependency_Graph* dependencies,
+                        Stmt_ID proc, bool check_unreachable) {
+  auto decl_proc = ast->get<Decl_Proc_Stmt>(proc);
+
+  u64 hash = hash_bytes(&check_unreachable, sizeof(check_unreachable));
+  size_t begin = (size_t)decl_proc->offset;
+  size_t end = (size_t)decl_proc->end_offset + 1;
+  if (begin < end && end <= source.size) {
+    hash = hash_bytes(source.data + begin, end - begin, hash);
+  }
+
+  return hash_uses(ast, scopes, dependencies, proc, hash);
+}
+
+struct Check_Cache_Header {
+  char magic[8];
+  u32 version;
+  u32 result_size;  // sizeof(Check_Result), a build with a different one doesn't use the file
+  u64 result_count;
+  u64 entry_count;
+  u64 text_size;
+};
+
+static void check_cache_path(char* path, size_t size, const char* cache_dir) {
+  snprintf(path, size, "%s/checks", cache_dir);
+}
+
+bool load_check_cache(Check_Cache* cache, const char* cache_dir) {
+  char path[4096];
+  check_cache_path(path, sizeof(path), cache_dir);
+
+  FILE* file = fopen(path, "rb");
+  if (!file) return false;
+
+  Check_Cache_Header header;
+  bool good = fread(&header, sizeof(header), 1, file) == 1 &&
+              memcmp(header.magic, CHECK_CACHE_MAGIC, sizeof(CHECK_CACHE_MAGIC)) == 0 &&
+              header.version == CHECK_CACHE_VERSION &&
+              header.result_size == sizeof(Check_Result) &&
+              header.result_count < 0xFFFFFFFF && header.entry_count < 0xFFFFFFFF && header.text_size < 0xFFFFFFFF;
+
+  Check_Cache loaded;
+  loaded.loaded = true;
+  if (good) loaded.index.reserve(header.result_count);
+
+  for (u64 i = 0; good && i < header.result_count; i++) {
+    u64 key;
+    Check_Result result;
+    good = fread(&key, sizeof(key), 1, file) == 1 && fread(&result, sizeof(result), 1, file) == 1 &&
+           result.first_entry <= result.end_entry && result.end_entry <= header.entry_count;
+
+    if (result.generation > loaded.generation) loaded.generation = result.generation;  // the count goes on from the last run
+    loaded.index.put(key, (u32)loaded.results.size);
+    loaded.results.add(result);
+  }
+
+  for (u64 i = 0; good && i < header.entry_count; i++) {
+    Diagnostic_Buffer::Entry entry;
+    good = fread(&entry, sizeof(entry), 1, file) == 1 && entry.begin <= entry.end && entry.end <= header.text_size;
+    loaded.output.entries.add(entry);
+  }
+
+  if (good && header.text_size) {
+    loaded.output.text.ensure_capacity(header.text_size);
+    good = fread(loaded.output.text.data, 1, header.text_size, file) == header.text_size;
+    loaded.output.text.size = header.text_size;
+  }
+
+  fclose(file);
+
+  if (!good) {
+    loaded.free();
+    return false;
+  }
+
+  cache->free();
+  *cache = loaded;
+  return true;
+}
+
+void store_check_cache(const Check_Cache* cache, const char* cache_dir) {
+  char path[4096];
+  char temporary[4200];
+  check_cache_path(path, sizeof(path), cache_dir);
+
+#ifndef _WIN32
+  snprintf(temporary, sizeof(temporary), "%s.%d.tmp", path, (int)getpid());  // renamed into place when complete
+  mkdir(cache_dir, 0755);  // if it exists this fails, which is fine
+#else
+  snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+#endif
+
+  FILE* file = fopen(temporary, "wb");
+  if (!file) return;
+
+  Check_Cache_Header header;
+  memcpy(header.magic, CHECK_CACHE_MAGIC, sizeof(CHECK_CACHE_MAGIC));
+  header.version = CHECK_CACHE_VERSION;
+  header.result_size = sizeof(Check_Result);
+  header.result_count = cache->results.size;
+  header.entry_count = cache->output.entries.size;
+  header.text_size = cache->output.text.size;
+
+  // the results in the order of the index, every result is in it once after end
+  bool good = fwrite(&header, sizeof(header), 1, file) == 1;
+  u64 written = 0;
+  cache->index.for_each([&](u64 key, u32 result) {
+    good = good && fwrite(&key, sizeof(key), 1, file) == 1 && fwrite(cache->results.get_ref(result), sizeof(Check_Result), 1, file) == 1;
+    written++;
+  });
+
+  good = good && written == header.result_count;
+  if (header.entry_count) {
+    good = good && fwrite(cache->output.entries.data, sizeof(Diagnostic_Buffer::Entry), header.entry_count, file) == header.entry_count;
+  }
+  if (header.text_size) {
+    good = good && fwrite(cache->output.text.data, 1, header.text_size, file) == header.text_size;
+  }
+
+  if (fclose(file) != 0) good = false;
+
+  if (!good || rename(temporary, path) != 0) {
+    remove(temporary);
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "common.hpp"
+#include "template.hpp"
+#include "log.hpp"
+#include "node.hpp"
+
+struct Ast;
+struct Scope_Table;
+struct Dependency_Graph;
+
+// typechecking results of top level procedures kept from one compilation to the next (the lines of the repl, or the
+// runs that share a cache directory), so only what changed is checked again.
+// a result is found by the hash of the text of the procedure and of the names and signatures of what it uses, a
+// change inside a procedure that keeps its signature doesn't make the procedures that call it checked again.
+// what a check reported is kept with the result and written out again when the result is used.
+
+static const u32 CHECK_NONE = 0xFFFFFFFF;
+static const u32 CHECK_CACHE_GENERATIONS = 64;  // a result nothing used in this many compilations is dropped
+
+struct Check_Result {
+  bool success = true;
+  bool line_sensitive = false;  // it reported something with line numbers, only good for a procedure at the same line
+  int line = 0;  // of the procedure
+  u32 first_entry = 0;  // in Check_Cache::output
+  u32 end_entry = 0;
+  u32 generation = 0;  // last compilation that used it
+};
+
+struct Check_Cache {
+  Hash_Map<u64, u32> index;  // key to result
+  DArray<Check_Result> results;
+  Diagnostic_Buffer output;
+  u32 generation = 0;
+  bool loaded = false;  // from the cache directory
+
+  size_t reused = 0;  // in the last compilation
+  size_t checked = 0;
+
+  void begin();  // of a compilation
+  void end();    // drops the results that weren't used for CHECK_CACHE_GENERATIONS compilations
+
+  // the result for the key of a procedure starting at line or CHECK_NONE. only reads, threads can look up at once
+  u32 find(u64 key, int line) const;
+
+  void use(u32 result);  // writes out what it reported
+  void add(u64 key, int line, bool success, Task_Diagnostics diagnostics);
+
+  void free();
+};
+
+// key of a top level procedure, check_unreachable is the option of the typechecker
+u64 procedure_check_key(const Ast* ast, String source, const Scope_Table* scopes, const Dependency_Graph* dependencies,
+                        Stmt_ID proc, bool check_unreachable);
+
+// the results in the cache directory replace the ones in the cache, false if there are none or they don't match
+bool load_check_cache(Check_Cache* cache, const char* cache_dir);
+void store_check_cache(const Check_Cache* cache, const char* cache_dir);  // quiet if it fails like the ast cache
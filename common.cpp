@@ -4,6 +4,8 @@
 #warning "INFO: panic stack traces are not implemented for windows yet"
 #else
 #include <execinfo.h>  // this is probably fine for the most part
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 
 void stack_trace() {
@@ -63,7 +65,7 @@ void print_string(String string) {
 }
 
 void null_terminate(String string, char* buff) {
-    snprintf(buff, (int)string.size + 1, "%s", string.data); // snprintf does it for us (+1 is for the terminator)
+    snprintf(buff, (int)string.size + 1, "%.*s", (int)string.size, string.data); // snprintf does it for us (+1 is for the terminator)
 }
 
 String take_input() {
@@ -74,6 +76,70 @@ String take_input() {
   return content;
 }
 
+static bool read_source_file(FILE* file, Source_File* source_file) {
+  size_t capacity = 64 * 1024;
+  size_t size = 0;
+  char* data = (char*)malloc_or_die(capacity);
+
+  while (true) {
+    if (size == capacity) {
+      capacity *= 2;
+      char* grown = (char*)realloc(data, capacity);
+      if (!grown) {
+        free(data);
+        panic_and_abort("Failed realloc while reading source file");
+      }
+      data = grown;
+    }
+
+    size_t read = fread(data + size, 1, capacity - size, file);
+    size += read;
+    if (read == 0) break;
+  }
+
+  if (ferror(file)) {
+    free(data);
+    return false;
+  }
+
+  source_file->content = String(data, size);
+  source_file->mapped = false;
+  return true;
+}
+
+bool load_source_file(FILE* file, Source_File* source_file) {
+#ifndef _WIN32
+  struct stat info;
+  int fd = fileno(file);
+  if (fd != -1 && fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+    size_t size = (size_t)info.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping != MAP_FAILED) {
+      madvise(mapping, size, MADV_SEQUENTIAL);  // the lexer walks it front to back once
+      source_file->content = String((const char*)mapping, size);
+      source_file->mapped = true;
+      return true;
+    }
+  }
+#endif
+
+  // not mappable, read it
+  return read_source_file(file, source_file);
+}
+
+void unload_source_file(Source_File* source_file) {
+#ifndef _WIN32
+  if (source_file->mapped) {
+    munmap((void*)source_file->content.data, source_file->content.size);
+    source_file->content = String();
+    return;
+  }
+#endif
+
+  free((void*)source_file->content.data);
+  source_file->content = String();
+}
+
 char* number_to_string(double number, int precision /* after decimal point */) {
   // decimal
 
@@ -164,17 +230,53 @@ void* malloc_or_die(size_t size) {
   return mem;
 }
 
-int hash_string(const String& string) {
-    int result = 0;
-    int pow = 1;
+void* realloc_or_die(void* memory, size_t size) {
+  void* mem = realloc(memory, size);
+  if (!mem) panic_and_abort("Failed realloc");
+
+  return mem;
+}
+
+// a word at a time with a multiply and a rotate, then the murmur3 finalizer so every bit of the input reaches the low
+// bits a table uses. for hash tables only, the values aren't stable between versions like hash_bytes
+u64 hash_string(String string) {
+    const u64 multiplier = 0x9e3779b97f4a7c15;
+    u64 hash = string.size * multiplier;
+
+    const char* data = string.data;
+    size_t size = string.size;
+    while (size >= 8) {
+        u64 word;
+        memcpy(&word, data, 8);
+        hash = (hash ^ (word * 0xbf58476d1ce4e5b9));
+        hash = ((hash << 29) | (hash >> 35)) * multiplier;
+        data += 8;
+        size -= 8;
+    }
 
-    for (auto i = string.size - 1; i > 0; i--, pow *= 31) {
-        result += string.data[i] * pow;
+    if (size) {
+        u64 word = 0;
+        memcpy(&word, data, size);
+        hash = (hash ^ (word * 0xbf58476d1ce4e5b9));
+        hash = ((hash << 29) | (hash >> 35)) * multiplier;
     }
 
-    result += string.data[0] * pow;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccd;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+u64 hash_bytes(const void* data, size_t size, u64 hash) {
+    const u8* bytes = (const u8*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3;
+    }
 
-    return result;
+    return hash;
 }
 
 const char* ordinal_string(int n) {
@@ -8,8 +8,15 @@
 #include <cstring>
 #include <cstdarg>
 
-#define MAX(x,y) (((x) < (y)) ? (x) : (y))
-#define MIN(x,y) (((x) < (y)) ? (y) : (x))
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+typedef int32_t s32;
+
+#define MAX(x,y) (((x) < (y)) ? (y) : (x))
+#define MIN(x,y) (((x) < (y)) ? (x) : (y))
 
 [[noreturn]] void panic_and_abort(char const * const message);
 [[noreturn]] void panic_and_abortf(char const * const message, ...);
@@ -19,11 +26,11 @@ size_t string_length(char const * s);
 #define ARRAY_SIZE(array) (sizeof(array) / sizeof(array[0]))
 
 void* malloc_or_die(size_t size);
+void* realloc_or_die(void* memory, size_t size);
 uint64_t next_multiple_of_wordsize(uint64_t n);
 
 typedef struct {
-  int offset;
-  int line;
+  int offset;  // the line is looked up from this only when it is reported
 } location_t;
 
 // owns its own memory
@@ -217,6 +224,16 @@ bool compare_string(String, String);
 
 String take_input();
 
+// contents of an input file, mapped when it is a regular file and read into memory otherwise (pipes, stdin ...)
+// the content is not null terminated, tokens and the ast point into it so it has to outlive them.
+struct Source_File {
+  String content;
+  bool mapped = false;
+};
+
+bool load_source_file(FILE* file, Source_File* source_file);
+void unload_source_file(Source_File* source_file);
+
 char* number_to_string(double number, int precision /* after decimal point */);
 
 typedef uint8_t nil_t;
@@ -232,7 +249,7 @@ struct Value {
     nil_t nil;
   } value;
 
-  Value(const Value& val) : type(val.type), value(val.value) {}
+  Value(const Value& val) = default;
 
   Value() : type(NIL), value({}) {
     value.nil = 0;
@@ -301,5 +318,6 @@ struct Value {
 
 bool compare_value(const Value&, const Value&);
 
-int hash_string(const String& string);
+u64 hash_string(String string);  // fast, for hash tables
+u64 hash_bytes(const void* data, size_t size, u64 hash = 0xcbf29ce484222325);  // 64 bit fnv-1a, for content hashes. hash goes on from an earlier one
 const char* ordinal_string(int n);
@@ -0,0 +1,296 @@
+#include "dependency.hpp"
+#include "environment.hpp"
+
+static const u32 UNVISITED = 0xFFFFFFFF;
+
+// the rows of the edge list, sorted by where they come from and without duplicates (a procedure calling another
+// twice is one edge). the edges from top level code don't go in, they only make roots
+static void build_rows(Dependency_Graph* graph, ArrayView<Dependency_Edge> edge_list, Linear_Allocator* arena) {
+  u32 n = graph->node_count;
+
+  graph->edge_offsets = arena_array<u32>(arena, n + 1);
+  memset(graph->edge_offsets, 0, (n + 1) * sizeof(u32));
+
+  for (auto edge : edge_list) {
+    if (edge.from == DEPENDENCY_ROOT) continue;
+    graph->edge_offsets[edge.from + 1]++;
+  }
+
+  for (u32 i = 0; i < n; i++) {
+    graph->edge_offsets[i + 1] += graph->edge_offsets[i];
+  }
+
+  u32 total = graph->edge_offsets[n];
+  u32* placed = (u32*)malloc_or_die((total + 1) * sizeof(u32));
+  u32* cursor = (u32*)malloc_or_die((n + 1) * sizeof(u32));
+  memcpy(cursor, graph->edge_offsets, n * sizeof(u32));
+
+  for (auto edge : edge_list) {
+    if (edge.from == DEPENDENCY_ROOT) continue;
+    placed[cursor[edge.from]++] = edge.to;
+  }
+
+  // seen[target] is the last node that had an edge to it
+  u32* seen = cursor;
+  memset(seen, 0xFF, (n + 1) * sizeof(u32));
+
+  graph->edges = arena_array<u32>(arena, total + 1);
+  u32 count = 0;
+  for (u32 node = 0; node < n; node++) {
+    u32 begin = graph->edge_offsets[node];
+    u32 end = graph->edge_offsets[node + 1];
+    graph->edge_offsets[node] = count;
+
+    for (u32 i = begin; i < end; i++) {
+      u32 target = placed[i];
+      if (seen[target] == node) continue;
+      seen[target] = node;
+      graph->edges[count++] = target;
+    }
+  }
+  graph->edge_offsets[n] = count;
+
+  ::free(placed);
+  ::free(cursor);
+}
+
+static void mark_reachable(Dependency_Graph* graph, ArrayView<Dependency_Edge> edge_list, int main_proc_id, Linear_Allocator* arena) {
+  u32 n = graph->node_count;
+
+  graph->reachable = arena_array<bool>(arena, n + 1);
+  memset(graph->reachable, 0, (n + 1) * sizeof(bool));
+
+  // a node is pushed once, when it is first marked
+  u32* stack = (u32*)malloc_or_die((n + 1) * sizeof(u32));
+  u32 stack_size = 0;
+
+  auto push = [&](u32 node) {
+    if (graph->reachable[node]) return;
+    graph->reachable[node] = true;
+    stack[stack_size++] = node;
+  };
+
+  if (main_proc_id) {
+    push(graph->procedure_node(main_proc_id));
+  }
+  else {
+    for (u32 i = 0; i < graph->procedure_count; i++) push(i);
+  }
+
+  for (auto edge : edge_list) {
+    if (edge.from == DEPENDENCY_ROOT) push(edge.to);
+  }
+
+  while (stack_size) {
+    u32 node = stack[--stack_size];
+    for (auto dependency : graph->dependencies(node)) {
+      push(dependency);
+    }
+  }
+
+  ::free(stack);
+}
+
+// tarjan's algorithm without recursion, a component is done after every component it depends on so they come out
+// in dependency order
+static void find_components(Dependency_Graph* graph, Linear_Allocator* arena) {
+  u32 n = graph->node_count;
+
+  graph->component = arena_array<u32>(arena, n + 1);
+  graph->component_nodes = arena_array<u32>(arena, n + 1);
+  graph->component_offsets = arena_array<u32>(arena, n + 1);
+  graph->component_count = 0;
+
+  struct Visit {
+    u32 node;
+    u32 edge;  // next one to look at
+  };
+
+  u32* index = (u32*)malloc_or_die((n + 1) * sizeof(u32));
+  u32* low = (u32*)malloc_or_die((n + 1) * sizeof(u32));
+  bool* on_stack = (bool*)malloc_or_die((n + 1) * sizeof(bool));
+  u32* stack = (u32*)malloc_or_die((n + 1) * sizeof(u32));
+  Visit* visits = (Visit*)malloc_or_die((n + 1) * sizeof(Visit));
+
+  memset(index, 0xFF, (n + 1) * sizeof(u32));
+  memset(on_stack, 0, (n + 1) * sizeof(bool));
+
+  u32 counter = 0;
+  u32 stack_size = 0;
+  u32 placed = 0;
+
+  auto discover = [&](u32 node, u32 depth) {
+    index[node] = low[node] = counter++;
+    stack[stack_size++] = node;
+    on_stack[node] = true;
+    visits[depth] = Visit{node, graph->edge_offsets[node]};
+  };
+
+  for (u32 root = 0; root < n; root++) {
+    if (index[root] != UNVISITED) continue;
+
+    u32 depth = 0;
+    discover(root, depth++);
+
+    while (depth) {
+      Visit* visit = &visits[depth - 1];
+
+      if (visit->edge < graph->edge_offsets[visit->node + 1]) {
+        u32 next = graph->edges[visit->edge++];
+        if (index[next] == UNVISITED) {
+          discover(next, depth++);
+        }
+        else if (on_stack[next] && index[next] < low[visit->node]) {
+          low[visit->node] = index[next];
+        }
+        continue;
+      }
+
+      u32 node = visit->node;
+      depth--;
+      if (depth && low[node] < low[visits[depth - 1].node]) {
+        low[visits[depth - 1].node] = low[node];
+      }
+
+      if (low[node] != index[node]) continue;
+
+      graph->component_offsets[graph->component_count] = placed;
+      u32 member;
+      do {
+        member = stack[--stack_size];
+        on_stack[member] = false;
+        graph->component[member] = graph->component_count;
+        graph->component_nodes[placed++] = member;
+      } while (member != node);
+      graph->component_count++;
+    }
+  }
+  graph->component_offsets[graph->component_count] = placed;
+
+  graph->recursive = arena_array<bool>(arena, graph->component_count + 1);
+  for (u32 c = 0; c < graph->component_count; c++) {
+    auto members = graph->component_members(c);
+    bool recursive = members.count > 1;
+    for (u32 i = 0; i < members.count && !recursive; i++) {
+      u32 member = members.get(i);
+      for (auto dependency : graph->dependencies(member)) {
+        if (dependency == member) recursive = true;
+      }
+    }
+    graph->recursive[c] = recursive;
+  }
+
+  ::free(index);
+  ::free(low);
+  ::free(on_stack);
+  ::free(stack);
+  ::free(visits);
+}
+
+// a component goes in the wave after the last of its dependencies, the components are already in dependency order
+static void schedule_waves(Dependency_Graph* graph, Linear_Allocator* arena) {
+  u32 count = graph->component_count;
+  u32* component_wave = (u32*)malloc_or_die((count + 1) * sizeof(u32));
+
+  graph->wave_count = 0;
+  for (u32 c = 0; c < count; c++) {
+    u32 wave = 0;
+    for (auto member : graph->component_members(c)) {
+      for (auto dependency : graph->dependencies(member)) {
+        u32 other = graph->component[dependency];
+        if (other != c && component_wave[other] + 1 > wave) wave = component_wave[other] + 1;
+      }
+    }
+
+    component_wave[c] = wave;
+    if (wave + 1 > graph->wave_count) graph->wave_count = wave + 1;
+  }
+
+  graph->wave_offsets = arena_array<u32>(arena, graph->wave_count + 1);
+  memset(graph->wave_offsets, 0, (graph->wave_count + 1) * sizeof(u32));
+  for (u32 c = 0; c < count; c++) {
+    graph->wave_offsets[component_wave[c] + 1]++;
+  }
+  for (u32 w = 0; w < graph->wave_count; w++) {
+    graph->wave_offsets[w + 1] += graph->wave_offsets[w];
+  }
+
+  u32* cursor = (u32*)malloc_or_die((graph->wave_count + 1) * sizeof(u32));
+  memcpy(cursor, graph->wave_offsets, (graph->wave_count + 1) * sizeof(u32));
+
+  graph->schedule = arena_array<u32>(arena, count + 1);
+  for (u32 c = 0; c < count; c++) {
+    graph->schedule[cursor[component_wave[c]]++] = c;
+  }
+
+  ::free(cursor);
+  ::free(component_wave);
+}
+
+Dependency_Graph build_dependency_graph(ArrayView<Dependency_Edge> edges, u32 procedure_count, u32 global_count,
+                                        int main_proc_id, Linear_Allocator* arena) {
+  Dependency_Graph graph;
+  graph.procedure_count = procedure_count;
+  graph.global_count = global_count;
+  graph.node_count = procedure_count + global_count;
+
+  DArray<Dependency_Edge> nodes(edges.count);
+  auto node = [&](u32 id) {
+    if (id == DEPENDENCY_ROOT) return id;
+    return (id & DEPENDENCY_GLOBAL) ? graph.global_node(id & ~DEPENDENCY_GLOBAL) : id;
+  };
+  for (auto edge : edges) {
+    nodes.add(Dependency_Edge{node(edge.from), node(edge.to)});
+  }
+  auto node_edges = ArrayView<Dependency_Edge>(nodes.data, nodes.size);
+
+  build_rows(&graph, node_edges, arena);
+  mark_reachable(&graph, node_edges, main_proc_id, arena);
+  find_components(&graph, arena);
+  schedule_waves(&graph, arena);
+
+  nodes.free();
+
+  return graph;
+}
+
+void Dependency_Graph::dump(const Scope_Table* scopes) const {
+  String_Builder sb(1024);
+  auto node_name = [&](u32 node) {
+    sb.clear_and_append(is_procedure(node) ? symbol_name(scopes->procedure_names.get(node))
+                                           : symbol_name(scopes->global_names.get(node - procedure_count)));
+    return sb.c_string();
+  };
+
+  printf("dependencies:\n");
+  for (u32 node = 0; node < node_count; node++) {
+    printf("\t%s ->", node_name(node));
+    for (auto dependency : dependencies(node)) {
+      printf(" %s", node_name(dependency));
+    }
+    printf("\n");
+  }
+
+  printf("waves:\n");
+  for (u32 w = 0; w < wave_count; w++) {
+    printf("\t%d:", w);
+    for (auto c : wave(w)) {
+      auto members = component_members(c);
+      if (members.count > 1) printf(" {");
+      for (u32 i = 0; i < members.count; i++) {
+        printf(i ? " %s" : (members.count > 1 ? "%s" : " %s"), node_name(members.get(i)));
+      }
+      if (members.count > 1) printf("}");
+      if (recursive[c]) printf(" (recursive)");
+    }
+    printf("\n");
+  }
+
+  printf("unreachable:");
+  for (u32 node = 0; node < node_count; node++) {
+    if (!reachable[node]) printf(" %s", node_name(node));
+  }
+  printf("\n");
+
+  sb.free();
+}
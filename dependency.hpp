@@ -0,0 +1,78 @@
+#pragma once
+
+#include "common.hpp"
+#include "template.hpp"
+#include "linear_allocator.h"
+
+struct Scope_Table;
+
+// what the declarations of a program use, built by the resolver.
+// the nodes are the procedures (by proc_id - 1) and then the global variables (by slot), an edge goes from a
+// procedure to the procedures it calls and the globals it touches, and from a global to what its initializer uses.
+// the edges of a node are a range of one array (compressed sparse rows), built once after resolving.
+struct Dependency_Edge {
+  u32 from;
+  u32 to;
+};
+
+// the resolver finds procedures while it collects the edges, so in those a global is this bit and its slot
+static const u32 DEPENDENCY_GLOBAL = 0x80000000;
+static const u32 DEPENDENCY_ROOT = 0xFFFFFFFF;  // from of an edge used by top level code, its target is a root
+
+struct Dependency_Graph {
+  u32 procedure_count = 0;
+  u32 global_count = 0;
+  u32 node_count = 0;
+
+  u32* edge_offsets = NULL;  // node_count + 1, the edges of node n are edges[edge_offsets[n], edge_offsets[n+1])
+  u32* edges = NULL;
+
+  bool* reachable = NULL;  // from main and top level code, from everything if there is no main
+
+  // strongly connected components, a dependency comes before what depends on it.
+  // procedures in the same component call each other, they are checked and generated as one unit
+  u32 component_count = 0;
+  u32* component = NULL;  // of each node
+  u32* component_offsets = NULL;  // component_count + 1, into component_nodes
+  u32* component_nodes = NULL;
+  bool* recursive = NULL;  // of each component, more than one node or a node that uses itself
+
+  // the components in waves, a wave only depends on the ones before it so its components can be worked on at once
+  u32 wave_count = 0;
+  u32* wave_offsets = NULL;  // wave_count + 1, into schedule
+  u32* schedule = NULL;  // component ids
+
+  u32 procedure_node(int proc_id) const { return (u32)proc_id - 1; }
+  u32 global_node(u32 slot) const { return procedure_count + slot; }
+  bool is_procedure(u32 node) const { return node < procedure_count; }
+
+  ArrayView<u32> dependencies(u32 node) const {
+    return ArrayView<u32>(edges + edge_offsets[node], edge_offsets[node + 1] - edge_offsets[node]);
+  }
+
+  ArrayView<u32> component_members(u32 c) const {
+    return ArrayView<u32>(component_nodes + component_offsets[c], component_offsets[c + 1] - component_offsets[c]);
+  }
+
+  ArrayView<u32> wave(u32 w) const {
+    return ArrayView<u32>(schedule + wave_offsets[w], wave_offsets[w + 1] - wave_offsets[w]);
+  }
+
+  // procedures the resolver never saw (an empty graph) count as reachable
+  bool procedure_reachable(int proc_id) const {
+    u32 node = procedure_node(proc_id);
+    return node >= procedure_count || reachable[node];
+  }
+
+  bool procedure_recursive(int proc_id) const {
+    u32 node = procedure_node(proc_id);
+    return node < procedure_count && recursive[component[node]];
+  }
+
+  void dump(const Scope_Table* scopes) const;
+};
+
+// edges as the resolver collects them, see DEPENDENCY_GLOBAL. main_proc_id is 0 if there is no main, then every
+// procedure is a root
+Dependency_Graph build_dependency_graph(ArrayView<Dependency_Edge> edges, u32 procedure_count, u32 global_count,
+                                        int main_proc_id, Linear_Allocator* arena);
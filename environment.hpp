@@ -8,82 +8,177 @@
 #include "type.hpp"
 
 #include "scope.hpp"
+#include "intern.hpp"
 
-struct Environment {
-  Environment() = default;
-  Environment(int parent) : parent_index(parent) {}
+static const u32 DECLARATION_NONE = 0xFFFFFFFF;
 
-  int parent_index = 0;    // parent environment
+// a block or a procedure body. the declarations themselves are in the arrays of the Scope_Table, a scope only has
+// the ends of the chains of its own so a scope without declarations is this record and nothing else
+struct Scope {
+  int parent_index = -1;  // -1 for the global scope
+  int frame = -1;  // the frame layout the variables are in, -1 for globals
 
-  DArray<String> variable_names;
+  u32 first_variable = DECLARATION_NONE;
+  u32 last_variable = DECLARATION_NONE;
+  u32 variable_count = 0;
+
+  u32 first_procedure = DECLARATION_NONE;
+  u32 last_procedure = DECLARATION_NONE;
+  u32 procedure_count = 0;
+};
+
+// every scope of a compilation and what is declared in them, filled by the resolver.
+// a declaration is found with one hash lookup of (scope, name), the first declaration of a name in a scope wins.
+// variable and procedure ids are their index in these arrays plus one
+struct Scope_Table {
+  DArray<Scope> scopes;
+
+  DArray<Symbol> variable_names;
   DArray<Variable> variables;
-  int var_id = 1;
+  DArray<u32> next_variable;  // in the same scope, in declaration order
 
-  DArray<String> procedure_names;
+  DArray<Symbol> procedure_names;
   DArray<Procedure> procedures;
-  int proc_id = 1;
+  DArray<u32> next_procedure;
 
-  // type_definitions
-  DArray<String> type_names;
-  DArray<Structure> types;
-  int struct_id = 1;
+  Hash_Map<u64, u32> variable_index;
+  Hash_Map<u64, u32> procedure_index;
 
-  int bind_variable(String name, Variable var) {
-    var.var_id = var_id;
+  DArray<Frame_Layout> frames;  // of every procedure, see Var_Address
+  Frame_Layout globals;  // the slots of the global variables
+  DArray<Symbol> global_names;  // of each slot
+
+  Scope_Table() = default;
+  Scope_Table(Linear_Allocator* arena) : scopes(arena), variable_names(arena), variables(arena), next_variable(arena),
+    procedure_names(arena), procedures(arena), next_procedure(arena), variable_index(arena), procedure_index(arena),
+    frames(arena), global_names(arena) {
+    globals.slots = DArray<Type_ID>(arena);
+  }
+
+  static u64 key(int scope, Symbol name) {
+    return ((u64)(u32)scope << 32) | name;
+  }
+
+  int add_scope(int parent, int frame) {
+    Scope scope;
+    scope.parent_index = parent;
+    scope.frame = frame;
+    scopes.add(scope);
+    return (int)scopes.size - 1;
+  }
+
+  Scope* scope(int index) const {
+    return scopes.get_ref(index);
+  }
+
+  int bind_variable(int scope_index, Symbol name, Variable var) {
+    u32 index = (u32)variables.size;
+    var.var_id = (int)index + 1;
 
     variable_names.add(name);
     variables.add(var);
-    var_id++;
-    return var_id - 1;
+    next_variable.add(DECLARATION_NONE);
+
+    Scope* scope = scopes.get_ref(scope_index);
+    link(&scope->first_variable, &scope->last_variable, next_variable.data, index);
+    scope->variable_count++;
+
+    bool added;
+    u32* first = variable_index.find_or_add(key(scope_index, name), &added);
+    if (added) *first = index;
+
+    return var.var_id;
   }
 
-  int bind_procedure(String name, Procedure proc) {
-    proc.proc_id = proc_id;
+  int bind_procedure(int scope_index, Symbol name, Procedure proc) {
+    u32 index = (u32)procedures.size;
+    proc.proc_id = (int)index + 1;
 
     procedure_names.add(name);
     procedures.add(proc);
-    proc_id++;
-    return proc_id - 1;
+    next_procedure.add(DECLARATION_NONE);
+
+    Scope* scope = scopes.get_ref(scope_index);
+    link(&scope->first_procedure, &scope->last_procedure, next_procedure.data, index);
+    scope->procedure_count++;
+
+    bool added;
+    u32* first = procedure_index.find_or_add(key(scope_index, name), &added);
+    if (added) *first = index;
+
+    return proc.proc_id;
   }
 
-  // @xxx do we need to return pointers here?
-  const Variable* get_variable(String name) const {
-    int index = variable_names.find(name, compare_string);
-    return (index == -1) ? NULL : &variables.data[index];
+  // declared in the scope itself, the enclosing ones are up to the caller
+  const Variable* get_variable(int scope, Symbol name) const {
+    const u32* index = variable_index.get(key(scope, name));
+    return index ? &variables.data[*index] : NULL;
   }
 
-  const Procedure* get_procedure(String name) const {
-    int index = procedure_names.find(name, compare_string);
-    return (index == -1) ? NULL : &procedures.data[index];
+  const Procedure* get_procedure(int scope, Symbol name) const {
+    const u32* index = procedure_index.get(key(scope, name));
+    return index ? &procedures.data[*index] : NULL;
   }
 
+  // @fixme out of range ids get an empty entry, the typechecker still asks for procedures it never resolved
   Procedure get_proc_from_id(int id) const {
+    if (id < 1 || (size_t)id > procedures.size) return Procedure();
     return procedures.data[id - 1];
   }
 
   Variable get_var_from_id(int id) const {
+    if (id < 1 || (size_t)id > variables.size) return Variable();
     return variables.data[id - 1];
   }
 
-  void dump() {
+  Procedure* procedure(int id) {
+    return procedures.get_ref(id - 1);
+  }
+
+  // calls visit(name, variable) for the variables of the scope, in declaration order
+  template <typename F>
+  void for_each_variable(int scope, F visit) const {
+    for (u32 i = scopes.get_ref(scope)->first_variable; i != DECLARATION_NONE; i = next_variable.data[i]) {
+      visit(variable_names.data[i], variables.data[i]);
+    }
+  }
+
+  template <typename F>
+  void for_each_procedure(int scope, F visit) const {
+    for (u32 i = scopes.get_ref(scope)->first_procedure; i != DECLARATION_NONE; i = next_procedure.data[i]) {
+      visit(procedure_names.data[i], procedures.data[i]);
+    }
+  }
+
+  void dump(int scope_index) const {
     String_Builder sb(1024);
+    const Scope* scope = scopes.get_ref(scope_index);
 
-    if (variable_names.size != 0) {
+    if (scope->variable_count != 0) {
       printf("variables: \n");
-      for (auto var_name : variable_names) {
+      for_each_variable(scope_index, [&](Symbol var_name, const Variable&) {
         sb.clear_and_append("\t");
-        sb.append(var_name);
+        sb.append(symbol_name(var_name));
         printf("%s\n", sb.c_string());
-      }
+      });
     }
 
-    if (procedure_names.size != 0) {
+    if (scope->procedure_count != 0) {
       printf("procedures:\n");
-      for (auto proc_name : procedure_names) {
+      for_each_procedure(scope_index, [&](Symbol proc_name, const Procedure&) {
         sb.clear_and_append("\t");
-        sb.append(proc_name);
+        sb.append(symbol_name(proc_name));
         printf("%s\n", sb.c_string());
-      }
+      });
     }
+
+    sb.free();
+  }
+
+private:
+  static void link(u32* first, u32* last, u32* next, u32 index) {
+    if (*first == DECLARATION_NONE) *first = index;
+    else next[*last] = index;
+    *last = index;
   }
 };
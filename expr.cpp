@@ -1,10 +1,11 @@
 #include "expr.hpp"
+#include "ast.hpp"
 #include "log.hpp"
 
 #include <cmath>
 
-const char* expr_type_str(const Expr* expr) {
-    switch (expr->type) {
+const char* expr_type_str(Expr_ID expr) {
+    switch (expr_type(expr)) {
         case ExprType::BINARY: return "BINARY";
         case ExprType::UNARY:  return "UNARY";
         case ExprType::GROUPING: return "GROUPING";
@@ -14,61 +15,79 @@ const char* expr_type_str(const Expr* expr) {
     }
 }
 
+#ifdef DEBUG
+const char* expr_source_string(ExprSource source) {
+    switch (source) {
+        case ExprSource::PRIMARY: return "PRIMARY";
+        case ExprSource::OR:      return "EXPR_OR";
+        case ExprSource::AND:     return "EXPR_AND";
+        case ExprSource::ARITH:   return "EXPR_ARITH";
+        case ExprSource::FACTOR:  return "EXPR_FACTOR";
+        case ExprSource::COMP:    return "EXPR_COMP";
+        case ExprSource::COMP_EQ: return "EXPR_COMP_EQ";
+        case ExprSource::UNARY:   return "EXPR_UNARY";
+        case ExprSource::MEMBER:  return "EXPR_MEMBER";
+        case ExprSource::CALL:    return "EXPR_CALL";
+        default: panic_and_abort("Invalid expression source");
+    }
+}
+#endif
+
 // if we actually store or know where to find what we have from the textual input, do we need to parse everything translate to a tree and make it into a string again?
-void expression_string(Expr* expression, String_Builder* builder) {
+void expression_string(const Ast* ast, Expr_ID expression, String_Builder* builder) {
     builder->clear();
 
-    DArray<Expr*> stack;
-    if (expression)
+    DArray<Expr_ID> stack;
+    if (expression != EXPR_NONE)
         stack.add(expression);
 
     while (stack.size > 0) {
-        Expr* current = stack.pop();
+        Expr_ID current = stack.pop();
 
-        switch (current->type) {
+        switch (expr_type(current)) {
             case ExprType::BINARY: {
-                auto binary = static_cast<Binary_Expr*>(current);
+                auto binary = ast->get<Binary_Expr>(current);
 
-                if (binary->right)
+                if (binary->right != EXPR_NONE)
                     stack.add(binary->right);
                 builder->appendf(" %s ", operator_string(binary->opperator));
-                if (binary->left)
+                if (binary->left != EXPR_NONE)
                     stack.add(binary->left);
                 break;
             }
             case ExprType::UNARY: {
-                auto unary = static_cast<Unary_Expr*>(current);
+                auto unary = ast->get<Unary_Expr>(current);
                 builder->append(operator_string(unary->opperator));
-                if (unary->operand) {
+                if (unary->operand != EXPR_NONE) {
                     stack.add(unary->operand);
                 }
                 break;
             }
             case ExprType::GROUPING: {
                 builder->append("(");
-                auto grouping = static_cast<Grouping_Expr*>(current);
-                if (grouping->expr) {
+                auto grouping = ast->get<Grouping_Expr>(current);
+                if (grouping->expr != EXPR_NONE) {
                     stack.add(grouping->expr);
                 }
                 builder->append(")");
                 break;
             }
             case ExprType::LITERAL: {
-                auto lit = static_cast<Literal*>(current);
+                auto lit = ast->get<Literal>(current);
                 builder->append(lit->value.string());  // @xxx assure this returns correct string
                 break;
             }
             case ExprType::VARIABLE: {
-                auto var = static_cast<Variable_Expr*>(current);
-                builder->append(var->identifier.lexeme);
+                auto var = ast->get<Variable_Expr>(current);
+                builder->append(symbol_name(var->identifier));
                 break;
             }
             case ExprType::CALL: {
-                auto call = static_cast<Call_Expr*>(current);
-                if (call->expression) {
-                    if (call->expression->type == ExprType::VARIABLE) {
-                        Variable_Expr* proc = static_cast<Variable_Expr*>(call->expression);  // @xxx maybe i need to rename variable expression
-                        builder->append(proc->identifier.lexeme);
+                auto call = ast->get<Call_Expr>(current);
+                if (call->expression != EXPR_NONE) {
+                    if (expr_type(call->expression) == ExprType::VARIABLE) {
+                        auto proc = ast->get<Variable_Expr>(call->expression);  // @xxx maybe i need to rename variable expression
+                        builder->append(symbol_name(proc->identifier));
 
                         // @hack
                         // expression string clears the string builder it receives and manages its own stack so we can't just call it again to append on top of the existing builder
@@ -76,14 +95,18 @@ void expression_string(Expr* expression, String_Builder* builder) {
 
                         builder->append("(");
 
+                        auto arguments = ast->list(call->arguments);
                         String_Builder arguments_sb(512);
-                        for (int i = call->arguments.size - 1; i >= 1; i--) {
-                            expression_string(call->arguments.data[i], &arguments_sb);
+                        for (int i = (int)arguments.count - 1; i >= 1; i--) {
+                            expression_string(ast, arguments.get(i), &arguments_sb);
                             builder->append(arguments_sb.to_string());
                             builder->append(",");
                         }
-                        expression_string(call->arguments.data[0], &arguments_sb);
-                        builder->append(arguments_sb.to_string());
+                        if (arguments.count) {
+                            expression_string(ast, arguments.get(0), &arguments_sb);
+                            builder->append(arguments_sb.to_string());
+                        }
+                        arguments_sb.free();
 
                         builder->append(")");
                     }
@@ -102,44 +125,46 @@ void expression_string(Expr* expression, String_Builder* builder) {
             default: panic_and_abort("Invalid expression type in expression to string");
         }
     }
+
+    stack.free();
 }
 
 // @xxx do we need this?
-void expression_human_readable_string(Expr* expr, String_Builder* builder) {
-    DArray<Expr*> stack;
-    if (expr) stack.add(expr);
+void expression_human_readable_string(const Ast* ast, Expr_ID expr, String_Builder* builder) {
+    DArray<Expr_ID> stack;
+    if (expr != EXPR_NONE) stack.add(expr);
 
     int indent = 0;
 
     while (stack.size > 0) {
-        Expr* current = stack.pop();
+        Expr_ID current = stack.pop();
 
         builder->append("\n");
         for (int i = 0; i < indent; i++) {  // append_many or something like that could be usefull
             builder->append("\t");
         }
 
-        switch (current->type) {
+        switch (expr_type(current)) {
             case ExprType::BINARY: {
-                auto binary = static_cast<Binary_Expr*>(current);
+                auto binary = ast->get<Binary_Expr>(current);
                 builder->append("Binary expression: ");
                 builder->append("operator : ");
                 builder->append(operator_string(binary->opperator));
                 builder->append("\n");
 
-                if (binary->left)  stack.add(binary->left);
-                if (binary->right) stack.add(binary->right);
-                if (binary->left || binary->right) indent++;
+                if (binary->left != EXPR_NONE)  stack.add(binary->left);
+                if (binary->right != EXPR_NONE) stack.add(binary->right);
+                if (binary->left != EXPR_NONE || binary->right != EXPR_NONE) indent++;
                 break;
             }
             case ExprType::UNARY: {
                 builder->append("Unary expression: ");
 
-                auto unary = static_cast<Unary_Expr*>(current);
+                auto unary = ast->get<Unary_Expr>(current);
 
                 builder->append(operator_string(unary->opperator));
 
-                if (unary->operand) {
+                if (unary->operand != EXPR_NONE) {
                     builder->append("operand: ");
                     stack.add(unary->operand);
                     indent++;
@@ -150,9 +175,9 @@ void expression_human_readable_string(Expr* expr, String_Builder* builder) {
             case ExprType::GROUPING: {
                 builder->append("Grouping expression: ");
 
-                auto grouping = static_cast<Grouping_Expr*>(current);
+                auto grouping = ast->get<Grouping_Expr>(current);
 
-                if (grouping->expr) {
+                if (grouping->expr != EXPR_NONE) {
                     builder->append("wrapped expression: ");
                     stack.add(grouping->expr);
                     indent++;
@@ -161,31 +186,32 @@ void expression_human_readable_string(Expr* expr, String_Builder* builder) {
                 break;
             }
             case ExprType::LITERAL: {
-                auto lit = static_cast<Literal*>(current);
+                auto lit = ast->get<Literal>(current);
                 builder->append("Literal expression : ");
                 builder->append(lit->value.string());
 
                 break;
             }
             case ExprType::VARIABLE: {
-                auto var = static_cast<Variable_Expr*>(current);
+                auto var = ast->get<Variable_Expr>(current);
                 builder->append("Variable expression : ");
-                builder->append(var->identifier.lexeme);
+                builder->append(symbol_name(var->identifier));
                 break;
             }
             case ExprType::CALL: {
-                auto call = static_cast<Call_Expr*>(current);
+                auto call = ast->get<Call_Expr>(current);
                 builder->append("Call expression : ");
 
-                if (call->expression) {
-                    if (call->expression->type == ExprType::VARIABLE) {
-                        Variable_Expr* proc = static_cast<Variable_Expr*>(call->expression);  // maybe i need to rename variable expression
+                if (call->expression != EXPR_NONE) {
+                    if (expr_type(call->expression) == ExprType::VARIABLE) {
+                        auto proc = ast->get<Variable_Expr>(call->expression);  // maybe i need to rename variable expression
                         builder->append("calling procedure of name: ");
-                        builder->append(proc->identifier.lexeme);
+                        builder->append(symbol_name(proc->identifier));
 
                         builder->append("arguments : ");
-                        for (int i = call->arguments.size - 1; i >= 0; i--) {
-                            stack.add(call->arguments.get(i));  // @test
+                        auto arguments = ast->list(call->arguments);
+                        for (int i = (int)arguments.count - 1; i >= 0; i--) {
+                            stack.add(arguments.get(i));  // @test
                         }
                     }
                     else {
@@ -198,16 +224,16 @@ void expression_human_readable_string(Expr* expr, String_Builder* builder) {
                 break;
             }
             case ExprType::MEMBER: {
-                auto member = static_cast<Member_Expr*>(current);
+                auto member = ast->get<Member_Expr>(current);
                 builder->append("Member expression : ");
 
-                if (member->expression) {
-                    if (member->expression->type == ExprType::VARIABLE) {
-                        Variable_Expr* var = static_cast<Variable_Expr*>(member->expression);
+                if (member->expression != EXPR_NONE) {
+                    if (expr_type(member->expression) == ExprType::VARIABLE) {
+                        auto var = ast->get<Variable_Expr>(member->expression);
                         builder->append("accessing member ");
-                        builder->append(member->member.lexeme);
+                        builder->append(symbol_name(member->member));
                         builder->append(" of variable ");
-                        builder->append(var->identifier.lexeme);
+                        builder->append(symbol_name(var->identifier));
                     }
                     else {
                         builder->append("expression: ");
@@ -221,50 +247,39 @@ void expression_human_readable_string(Expr* expr, String_Builder* builder) {
             default: panic_and_abort("Invalid expression type in expression to string");
         }
     }
+
+    stack.free();
 }
 
-int expr_deep(Expr* expr) {
-    if (!expr) return 0;
+int expr_deep(const Ast* ast, Expr_ID expr) {
+    if (expr == EXPR_NONE) return 0;
 
-    switch (expr->type) {
-        case ExprType::BINARY: {
-            auto binary = static_cast<Binary_Expr*>(expr);
-            return MAX(expr_deep(binary->left), expr_deep(binary->left)) + 1;
-        }
-        case ExprType::UNARY: {
-            auto unary = static_cast<Unary_Expr*>(expr);
-            return expr_deep(unary->operand) + 1;
-        }
-        case ExprType::GROUPING: {
-            auto grouping = static_cast<Grouping_Expr*>(expr);
-            return expr_deep(grouping->expr) + 1;
-        }
+    switch (expr_type(expr)) {
         case ExprType::LITERAL:
         case ExprType::VARIABLE:
             return 1;
-        case ExprType::MEMBER: {
-            auto member = static_cast<Member_Expr*>(expr);
-            return 1 + expr_deep(member->expression);
-        }
-        case ExprType::CALL: {
-            auto call = static_cast<Call_Expr*>(expr);
-            return 1 + expr_deep(call->expression);
+        case ExprType::CALL:  // only the procedure side like before, not the arguments
+            return 1 + expr_deep(ast, ast->get<Call_Expr>(expr)->expression);
+        default: {
+            int deepest = 0;
+            ast->for_each_child(expr, [&](Expr_ID child) {
+                deepest = MAX(deepest, expr_deep(ast, child));
+            });
+            return deepest + 1;
         }
-        default:
-            panic_and_abort("Unknown expr type");
     }
 }
 
-static void print_expr_real(Expr* expr, int deep);
+static void print_expr_real(const Ast* ast, Expr_ID expr, int deep);
 
 // @cleanup
-void print_expr(Expr* expr) {
+void print_expr(const Ast* ast, Expr_ID expr) {
     String_Builder sb(512);
-    expression_human_readable_string(expr, &sb);
+    expression_human_readable_string(ast, expr, &sb);
     printf("%s\n", sb.c_string());
     sb.free();
 
-    // print_expr_real(expr, 0);
+    // print_expr_real(ast, expr, 0);
 }
 
 #include <stdarg.h>
@@ -279,33 +294,33 @@ void print_with_tabs(const char* format, int tabs, ...) {
     printf("%s\n", buff);
 }
 
-static void print_expr_real(Expr* expr, int deep) {
-    if (!expr) {
+static void print_expr_real(const Ast* ast, Expr_ID expr, int deep) {
+    if (expr == EXPR_NONE) {
         print_with_tabs("Empty expression", deep);
         return;
     }
 #ifdef DEBUG
-    print_with_tabs("FROM : %s", deep, expr->source ? expr->source : "PRIMARY");
+    print_with_tabs("FROM : %s", deep, expr_source_string(ast->expr(expr)->source));
 #endif
 
-    switch (expr->type) {
+    switch (expr_type(expr)) {
         case ExprType::BINARY: {
-            auto binary = static_cast<Binary_Expr*>(expr);
+            auto binary = ast->get<Binary_Expr>(expr);
             print_with_tabs("BINARY EXPR : \n", deep);
-            print_expr_real(binary->left, deep + 1);
+            print_expr_real(ast, binary->left, deep + 1);
             print_with_tabs("operator: %s : ", deep, operator_string(binary->opperator));
-            print_expr_real(binary->right, deep + 1);
+            print_expr_real(ast, binary->right, deep + 1);
             break;
         }
         case ExprType::UNARY: {
-            auto unary = static_cast<Unary_Expr*>(expr);
+            auto unary = ast->get<Unary_Expr>(expr);
             print_with_tabs("UNARY EXPR : \n", deep);
             print_with_tabs("operator : %s ", deep, operator_string(unary->opperator));
-            print_expr_real(unary->operand, deep + 1);
+            print_expr_real(ast, unary->operand, deep + 1);
             break;
         }
         case ExprType::LITERAL: {
-            auto lit = static_cast<Literal*>(expr);
+            auto lit = ast->get<Literal>(expr);
             switch (lit->value.type) {
                 case Value::REAL:
                     print_with_tabs("Literal value: %f", deep, lit->value.value.real);
@@ -314,7 +329,7 @@ static void print_expr_real(Expr* expr, int deep) {
                     print_with_tabs("Literal value: %ld", deep, lit->value.value.integer);
                     break;
                 case Value::STRING:
-                    print_with_tabs("Literal value: %s", deep, lit->value.value.string);
+                    print_with_tabs("Literal value: %.*s", deep, (int)lit->value.value.string.size, lit->value.value.string.data);
                     break;
                 case Value::BOOLEAN:
                     print_with_tabs("Literal value: %s", deep, lit->value.value.boolean ? "true" : "false");
@@ -326,26 +341,26 @@ static void print_expr_real(Expr* expr, int deep) {
             break;
         }
         case ExprType::VARIABLE: {
-            auto var = static_cast<Variable_Expr*>(expr);
-            print_with_tabs("EXPRESSION VARIABLE : %s\n", deep, var->identifier.lexeme.data);
+            String name = symbol_name(ast->get<Variable_Expr>(expr)->identifier);
+            print_with_tabs("EXPRESSION VARIABLE : %.*s\n", deep, (int)name.size, name.data);
             break;
         }
         case ExprType::GROUPING: {
-            auto grouping = static_cast<Grouping_Expr*>(expr);
+            auto grouping = ast->get<Grouping_Expr>(expr);
             print_with_tabs("GROUPING EXPRESSION : \n", deep);
-            print_expr_real(grouping->expr, deep + 1);
+            print_expr_real(ast, grouping->expr, deep + 1);
             break;
         }
         case ExprType::CALL: {
-            auto call = static_cast<Call_Expr*>(expr);
+            auto call = ast->get<Call_Expr>(expr);
             print_with_tabs("CALL EXPRESSION : \n", deep);
-            print_expr_real(call->expression, deep + 1);
+            print_expr_real(ast, call->expression, deep + 1);
             break;
         }
         case ExprType::MEMBER: {
-            auto member = static_cast<Call_Expr*>(expr);
+            auto member = ast->get<Member_Expr>(expr);
             print_with_tabs("MEMBER EXPRESSION : \n", deep);
-            print_expr_real(member->expression, deep + 1);
+            print_expr_real(ast, member->expression, deep + 1);
             break;
         }
         default:
@@ -355,38 +370,75 @@ static void print_expr_real(Expr* expr, int deep) {
 
 // @fixme memory
 
+// every diagnostic of constant folding goes through this, when had_diagnostic is given nothing is printed and
+// it is only set instead (the quiet parsers of a parallel parse)
+static bool report(bool* had_diagnostic) {
+    if (had_diagnostic) {
+        *had_diagnostic = true;
+        return false;
+    }
+
+    return true;
+}
+
 // @todo cleanup and probably move this to typechecker
-bool binary_expr_typecheck(Type_ID left, Type_ID right, const Binary_Expr* binary, bool (*proper_type)(Type_ID)) {
+bool binary_expr_typecheck(Type_ID left, Type_ID right, const Binary_Expr* binary, bool (*proper_type)(Type_ID), bool* had_diagnostic) {
     if (!proper_type(left) || !proper_type(right)) {
-        errorf(binary->location.line,"Can't use binary operator %s on given types: %s %s", operator_string(binary->opperator), type_string(left), type_string(right));
+        if (report(had_diagnostic)) errorf(source_line(binary->location.offset),"Can't use binary operator %s on given types: %s %s", operator_string(binary->opperator), type_string(left), type_string(right));
         return false;
     }
 
     return true;
 }
 
-Expr* collapse_expr(Expr* expr) {
-    if (!expr) return NULL;
+static Expr_ID add_literal(Ast* ast, Value value, location_t location) {
+    Literal literal(value);
+    literal.location = location;
+    return ast->cons(literal);
+}
+
+// nodes of a hash consed tree may be used by other expressions too, so they get a new node rather than a change
+static Expr_ID set_literal(Ast* ast, Expr_ID literal, Value value) {
+    if (ast->hash_consing) return add_literal(ast, value, ast->expr(literal)->location);
+
+    ast->get<Literal>(literal)->value = value;
+    return literal;
+}
+
+static Expr_ID set_operand(Ast* ast, Expr_ID expr, Expr_ID operand) {
+    Unary_Expr unary = *ast->get<Unary_Expr>(expr);
+    if (unary.operand == operand) return expr;
+
+    unary.operand = operand;
+    if (ast->hash_consing) return ast->cons(unary);
+
+    *ast->get<Unary_Expr>(expr) = unary;
+    return expr;
+}
+
+Expr_ID collapse_expr(Ast* ast, Expr_ID expr, bool* had_diagnostic) {
+    if (expr == EXPR_NONE) return EXPR_NONE;
 
-    auto line = expr->location.line;
-    switch (expr->type) {
+    auto location = ast->expr(expr)->location;
+    switch (expr_type(expr)) {
         case ExprType::BINARY: {
-            auto binary = static_cast<Binary_Expr*>(expr);
+            // a copy since folding the children adds literals
+            Binary_Expr node = *ast->get<Binary_Expr>(expr);
+            auto binary = &node;
 
-            if (!binary->left)  return collapse_expr(binary->right);
-            if (!binary->right) return collapse_expr(binary->left);
+            if (binary->left == EXPR_NONE)  return collapse_expr(ast, binary->right, had_diagnostic);
+            if (binary->right == EXPR_NONE) return collapse_expr(ast, binary->left, had_diagnostic);
 
-            Expr* left = collapse_expr(binary->left);
-            Expr* right = collapse_expr(binary->right);
+            Expr_ID left = collapse_expr(ast, binary->left, had_diagnostic);
+            Expr_ID right = collapse_expr(ast, binary->right, had_diagnostic);
 
-            if ((!left) || (!right)) {
-                return NULL;
+            if (left == EXPR_NONE || right == EXPR_NONE) {
+                return EXPR_NONE;
             }
 
-            if (left->type == ExprType::LITERAL && right->type == ExprType::LITERAL) {
-                Literal* result;
-                auto l = static_cast<Literal*>(left);
-                auto r = static_cast<Literal*>(right);
+            if (expr_type(left) == ExprType::LITERAL && expr_type(right) == ExprType::LITERAL) {
+                auto l = ast->get<Literal>(left);
+                auto r = ast->get<Literal>(right);
 
                 Type_ID ltype = value_type(l->value);
                 Type_ID rtype = value_type(r->value);
@@ -414,156 +466,161 @@ Expr* collapse_expr(Expr* expr) {
                     */
                     case Operator::PLUS: {
                         // @todo this needs more complete logic
-                        if (!binary_expr_typecheck(ltype, rtype, binary, is_numeric_type)) {
-                             return NULL;
+                        if (!binary_expr_typecheck(ltype, rtype, binary, is_numeric_type, had_diagnostic)) {
+                             return EXPR_NONE;
                         }
 
                         if (l->value.type == Value::REAL) {
-                            return new Literal(l->value.value.real + r->value.value.real);
+                            return add_literal(ast, l->value.value.real + r->value.value.real, location);
                         } else if (l->value.type == Value::INTEGER) {
-                            return new Literal(l->value.value.integer + r->value.value.integer);
+                            return add_literal(ast, l->value.value.integer + r->value.value.integer, location);
                         }
                     }
                     case Operator::MINUS: {
-                        if (!binary_expr_typecheck(ltype, rtype, binary, is_numeric_type)) {
-                            return NULL;
+                        if (!binary_expr_typecheck(ltype, rtype, binary, is_numeric_type, had_diagnostic)) {
+                            return EXPR_NONE;
                         }
 
                         if (l->value.type == Value::REAL) {
-                            return new Literal(l->value.value.real - r->value.value.real);
+                            return add_literal(ast, l->value.value.real - r->value.value.real, location);
                         } else if (l->value.type == Value::INTEGER) {
-                            return new Literal(l->value.value.integer - r->value.value.integer);
+                            return add_literal(ast, l->value.value.integer - r->value.value.integer, location);
                         }
                     }
                     case Operator::MULT: {
-                        if (!binary_expr_typecheck(ltype, rtype, binary, is_numeric_type)) {
-                            errorf(binary->location.line,"Can't use binary operator %s on given types: %s %s", operator_string(binary->opperator), type_string(ltype), type_string(rtype));
-                            return NULL;
+                        if (!binary_expr_typecheck(ltype, rtype, binary, is_numeric_type, had_diagnostic)) {
+                            if (report(had_diagnostic)) errorf(source_line(binary->location.offset),"Can't use binary operator %s on given types: %s %s", operator_string(binary->opperator), type_string(ltype), type_string(rtype));
+                            return EXPR_NONE;
                         }
 
                         if (l->value.type == Value::REAL) {
-                            return new Literal(l->value.value.real * r->value.value.real);
+                            return add_literal(ast, l->value.value.real * r->value.value.real, location);
                         } else if (l->value.type == Value::INTEGER) {
-                            return new Literal(l->value.value.integer * r->value.value.integer);
+                            return add_literal(ast, l->value.value.integer * r->value.value.integer, location);
                         }
                     }
                     case Operator::DIV: {
-                        if (!binary_expr_typecheck(ltype, rtype, binary, is_numeric_type)) {
-                            errorf(binary->location.line,"Can't use binary operator %s on given types: %s %s", operator_string(binary->opperator), type_string(ltype), type_string(rtype));
-                            return NULL;
+                        if (!binary_expr_typecheck(ltype, rtype, binary, is_numeric_type, had_diagnostic)) {
+                            if (report(had_diagnostic)) errorf(source_line(binary->location.offset),"Can't use binary operator %s on given types: %s %s", operator_string(binary->opperator), type_string(ltype), type_string(rtype));
+                            return EXPR_NONE;
                         }
 
-                        if (r->value.value.integer == 0)
-                            warningf(line, "Division by zero");
+                        if (r->value.value.integer == 0 && report(had_diagnostic))
+                            warningf(source_line(location.offset), "Division by zero");
 
                         if (l->value.type == Value::REAL) {
-                            return new Literal(l->value.value.real / r->value.value.real);
+                            return add_literal(ast, l->value.value.real / r->value.value.real, location);
                         } else if (l->value.type == Value::INTEGER) {
-                            return new Literal(l->value.value.integer / r->value.value.integer);
+                            return add_literal(ast, l->value.value.integer / r->value.value.integer, location);
                         }
                     }
                     case Operator::MOD: {
-                        if (binary_expr_typecheck(ltype, rtype, binary, [](Type_ID type){ return type == Type::INT; })) {
-                            return new Literal(l->value.value.integer % r->value.value.integer);
+                        if (binary_expr_typecheck(ltype, rtype, binary, [](Type_ID type){ return type == Type::INT; }, had_diagnostic)) {
+                            return add_literal(ast, l->value.value.integer % r->value.value.integer, location);
                         }
-                        else if (binary_expr_typecheck(ltype, rtype, binary, [](Type_ID type){ return type == Type::FLOAT; })) {
-                            return new Literal(fmod(l->value.value.real, r->value.value.real));
+                        else if (binary_expr_typecheck(ltype, rtype, binary, [](Type_ID type){ return type == Type::FLOAT; }, had_diagnostic)) {
+                            return add_literal(ast, fmod(l->value.value.real, r->value.value.real), location);
                         }
                         else {
-                            return NULL;
+                            return EXPR_NONE;
                         }
                     }
                     case Operator::EQUALS: {
                         if (ltype != rtype) {
-                            errorf(line, "Type mismatch for 2 sides of equals operator `==` %s %s", type_string(ltype), type_string(rtype));
-                            return NULL;
+                            if (report(had_diagnostic)) errorf(source_line(location.offset), "Type mismatch for 2 sides of equals operator `==` %s %s", type_string(ltype), type_string(rtype));
+                            return EXPR_NONE;
                         }
 
                         bool result = compare_value(l->value, r->value);
-                        return new Literal(result);
+                        return add_literal(ast, result, location);
                     }
                     case Operator::NOT_EQUALS: {
                         if (ltype != rtype) {
-                            errorf(line, "Type mismatch for 2 sides of not equal operator `!=` %s %s", type_string(ltype), type_string(rtype));
-                            return NULL;
+                            if (report(had_diagnostic)) errorf(source_line(location.offset), "Type mismatch for 2 sides of not equal operator `!=` %s %s", type_string(ltype), type_string(rtype));
+                            return EXPR_NONE;
                         }
                         bool result = !compare_value(l->value, r->value);
-                        return new Literal(result);
+                        return add_literal(ast, result, location);
                     }
                     case Operator::LESS: {
-                        if (!binary_expr_typecheck(ltype, rtype, binary, is_numeric_type)) return NULL;
+                        if (!binary_expr_typecheck(ltype, rtype, binary, is_numeric_type, had_diagnostic)) return EXPR_NONE;
                     }
                     case Operator::GREATER:
                     case Operator::LESS_EQUAL:
                     case Operator::GREATER_EQUAL:
-                      break;
+                      break;  // comparisons are left to run time
                     case Operator::OR: {
-                        if (!binary_expr_typecheck(ltype, rtype, binary, [](Type_ID type){return type == Type::BOOLEAN;}))
+                        if (!binary_expr_typecheck(ltype, rtype, binary, [](Type_ID type){return type == Type::BOOLEAN;}, had_diagnostic)) return EXPR_NONE;
 
                         bool result = l->value.value.boolean || r->value.value.boolean;
-                        return new Literal(result);
+                        return add_literal(ast, result, location);
                     }
                     case Operator::AND: {
-                        if (!binary_expr_typecheck(ltype, rtype, binary, [](Type_ID type){return type == Type::BOOLEAN;})) return NULL;
+                        if (!binary_expr_typecheck(ltype, rtype, binary, [](Type_ID type){return type == Type::BOOLEAN;}, had_diagnostic)) return EXPR_NONE;
 
                         bool result = l->value.value.boolean && r->value.value.boolean;
-                        return new Literal(result);
+                        return add_literal(ast, result, location);
                     }
                     default: {
                         panic_and_abortf("BUG: Binary_Expr expression with non-null leafs has operator %s", operator_string(binary->opperator));  // @internal
                     }
                 }
-
-                return result;
             }
 
+            // if both are not compile time known literals not much we can do
+            if (left == binary->left && right == binary->right) return expr;
+
             binary->left = left;
             binary->right = right;
-            return binary;  // if both are not compile time known literals not much we can do
+            if (ast->hash_consing) return ast->cons(*binary);
+
+            *ast->get<Binary_Expr>(expr) = *binary;
+            return expr;
         }
         case ExprType::UNARY: {
-            auto unary = static_cast<Unary_Expr*>(expr);
-            Expr* result = collapse_expr(unary->operand);
-            if (unary->opperator == Operator::NONE) {
+            Operator op = ast->get<Unary_Expr>(expr)->opperator;
+            Expr_ID result = collapse_expr(ast, ast->get<Unary_Expr>(expr)->operand, had_diagnostic);
+            if (op == Operator::NONE) {
                 return result;
-            } else if (unary->opperator == Operator::MINUS) {
+            } else if (result == EXPR_NONE) {
+                return EXPR_NONE;
+            } else if (op == Operator::MINUS) {
 
-                if (result->type == ExprType::LITERAL) {
-                    auto literal = static_cast<Literal*>(result);
+                if (expr_type(result) == ExprType::LITERAL) {
+                    Value value = ast->get<Literal>(result)->value;
 
-                    auto type = value_type(literal->value);
+                    auto type = value_type(value);
                     if (type == Type::INT) {
-                        literal->value.value.integer = - literal->value.value.integer;
+                        value.value.integer = - value.value.integer;
                     } else if (type == Type::FLOAT) {
-                        literal->value.value.real = - literal->value.value.real;
+                        value.value.real = - value.value.real;
                     } else {
-                        errorf(line, "Can't apply operator `-` on type : %s\n", type_string(type));
+                        if (report(had_diagnostic)) errorf(source_line(location.offset), "Can't apply operator `-` on type : %s\n", type_string(type));
+                        return result;
                     }
 
-                    return literal;
+                    return set_literal(ast, result, value);
                 }
 
-                unary->operand = result;
-                return unary;
-            } else if (unary->opperator == Operator::NOT) {
+                return set_operand(ast, expr, result);
+            } else if (op == Operator::NOT) {
 
-                if (result->type == ExprType::LITERAL) {
-                    auto literal = static_cast<Literal*>(result);
+                if (expr_type(result) == ExprType::LITERAL) {
+                    Value value = ast->get<Literal>(result)->value;
 
-                    auto type = value_type(literal->value);
+                    auto type = value_type(value);
                     if (type != Type::BOOLEAN) {
-                        errorf(line, "Can't apply operator `!` on type : %s\n", type_string(type));
+                        if (report(had_diagnostic)) errorf(source_line(location.offset), "Can't apply operator `!` on type : %s\n", type_string(type));
                     }
 
-                    literal->value.value.boolean = !literal->value.value.boolean;
-                    return literal;
+                    value.value.boolean = !value.value.boolean;
+                    return set_literal(ast, result, value);
                 }
 
-                unary->operand = result;
-                return unary;
+                return set_operand(ast, expr, result);
             } else {
-                errorf(line, "Invalid unary operator : %s\n", operator_string(unary->opperator));
-                return NULL;
+                if (report(had_diagnostic)) errorf(source_line(location.offset), "Invalid unary operator : %s\n", operator_string(op));
+                return EXPR_NONE;
             }
         }
         case ExprType::LITERAL: {
@@ -573,24 +630,25 @@ Expr* collapse_expr(Expr* expr) {
             return expr;
         }
         case ExprType::GROUPING: {
-            auto grouping = static_cast<Grouping_Expr*>(expr);
-            grouping->expr = collapse_expr(grouping->expr);
-            return grouping->expr;
+            Expr_ID inner = collapse_expr(ast, ast->get<Grouping_Expr>(expr)->expr, had_diagnostic);
+            if (!ast->hash_consing) ast->get<Grouping_Expr>(expr)->expr = inner;
+            return inner;
         }
         case ExprType::CALL: {
-            auto call = static_cast<Call_Expr*>(expr);
+            Expr_ID callee = collapse_expr(ast, ast->get<Call_Expr>(expr)->expression, had_diagnostic);
+            ast->get<Call_Expr>(expr)->expression = callee;
 
-            call->expression = collapse_expr(call->expression);
-            for (int i = 0; i < call->arguments.size; i++) {
-                call->arguments.data[i] = collapse_expr(call->arguments.data[i]);
+            Expr_List arguments = ast->get<Call_Expr>(expr)->arguments;
+            for (u32 i = 0; i < arguments.count; i++) {
+                Expr_ID argument = collapse_expr(ast, ast->expr_lists.data[arguments.first + i], had_diagnostic);
+                ast->expr_lists.data[arguments.first + i] = argument;
             }
-            return call;
+            return expr;
         }
         case ExprType::MEMBER: {
-            auto member = static_cast<Member_Expr*>(expr);
-
-            member->expression = collapse_expr(member->expression);
-            return member;
+            Expr_ID object = collapse_expr(ast, ast->get<Member_Expr>(expr)->expression, had_diagnostic);
+            ast->get<Member_Expr>(expr)->expression = object;
+            return expr;
         }
         default: {
             panic_and_abort("Invalid expression type");
@@ -599,58 +657,24 @@ Expr* collapse_expr(Expr* expr) {
 }
 
 // @xxx unused
-ArrayView<Expr*> find_subexpressions(Expr* expr, ExprType type) {
-    DArray<Expr*> subexprs;
+ArrayView<Expr_ID> find_subexpressions(const Ast* ast, Expr_ID expr, ExprType type) {
+    DArray<Expr_ID> subexprs;
 
-    DArray<Expr*> stack;
+    DArray<Expr_ID> stack;
     stack.add(expr);
 
     while (stack.size != 0) {
         auto current = stack.pop();
-        if (!current) continue;
+        if (current == EXPR_NONE) continue;
 
-        // @note:
-        // @volatile pointers
-        // if we will return the raw pointers inside the expression,
-        // we better be sure the expression is not modified (constant folded for example) and the pointers are still valid after calling this.
+        if (expr_type(current) == type) subexprs.add(current);
 
-        if (current->type == type) subexprs.add(current);
-
-        switch (current->type) {
-            case ExprType::BINARY: {
-                auto binary = static_cast<Binary_Expr*>(current);
-                stack.add(binary->left);
-                stack.add(binary->right);
-                break;
-            }
-            case ExprType::UNARY:  {
-                auto unary = static_cast<Unary_Expr*>(current);
-                stack.add(unary->operand);
-                break;
-            }
-            case ExprType::GROUPING: {
-                auto grouping = static_cast<Grouping_Expr*>(current);
-                stack.add(grouping->expr);
-                break;
-            }
-            case ExprType::LITERAL:
-            case ExprType::VARIABLE:
-                break;
-            case ExprType::MEMBER: {
-                auto member = static_cast<Member_Expr*>(current);
-                stack.add(member->expression);
-                break;
-            }
-            case ExprType::CALL: {
-                auto call = static_cast<Call_Expr*>(current);
-                stack.add(call->expression);
-                break;
-            }
-            default: panic_and_abort("Invalid expression type");
-        }
+        ast->for_each_child(current, [&](Expr_ID child) {
+            stack.add(child);
+        });
     }
 
     stack.free();
 
-    return ArrayView<Expr*>(subexprs.data, subexprs.size);
+    return ArrayView<Expr_ID>(subexprs.data, subexprs.size);
 }
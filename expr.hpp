@@ -4,6 +4,7 @@
 #include "common.hpp"
 #include "token.hpp"
 #include "type.hpp"
+#include "node.hpp"
 
 enum class ExprType {
     BINARY,
@@ -19,93 +20,123 @@ enum class ExprType {
     */
 };
 
-struct Expr {
-    ExprType type;
+inline ExprType expr_type(Expr_ID id) {
+    return (ExprType)node_kind(id);
+}
+
+// every node lives in the pool of its kind inside an Ast, the kind is in the id that refers to it so it isn't stored here.
+// children are ids into the same Ast, EXPR_NONE for a missing one.
+#ifdef DEBUG
+// the parsing function a node comes from, for dumps. an index rather than a string so nodes hold no pointers
+enum class ExprSource : u8 {
+    PRIMARY,
+    OR, AND, ARITH, FACTOR, COMP, COMP_EQ,  // binary, in the order of their binding powers
+    UNARY,
+    MEMBER,
+    CALL,
+};
+
+const char* expr_source_string(ExprSource source);
+#endif
 
+struct Expr {
 #ifdef DEBUG
-    const char* source;
+    ExprSource source = ExprSource::PRIMARY;
 #endif
 
-    location_t location;
+    location_t location = {0};  // first token of the expression
 };
 
 // the binary and unary operators use the same type.
 // we could split them to different types (binop, unop)
 
 struct Binary_Expr : Expr {
-    Expr* left;
-    Operator opperator;
-    Expr* right;
+    static const ExprType KIND = ExprType::BINARY;
 
-    Binary_Expr() : left(NULL), opperator(Operator::NONE), right(NULL) { type = ExprType::BINARY; }
-    Binary_Expr(Expr* left, Operator op, Expr* right) : left(left), opperator(op), right(right) { type = ExprType::BINARY; }
+    Expr_ID left = EXPR_NONE;
+    Operator opperator = Operator::NONE;
+    Expr_ID right = EXPR_NONE;
 };
 
 struct Unary_Expr : Expr {
-    Operator opperator;
-    Expr* operand;
-
-    Unary_Expr() : opperator(Operator::NONE), operand(NULL) {
-        type = ExprType::UNARY;
-    }
-    Unary_Expr(Expr* expr) : opperator(Operator::NONE), operand(expr) { type = ExprType::UNARY; }
-    Unary_Expr(Operator op, Expr* expr) : opperator(op), operand(expr) { type = ExprType::UNARY; }
+    static const ExprType KIND = ExprType::UNARY;
+
+    Operator opperator = Operator::NONE;
+    Expr_ID operand = EXPR_NONE;
 };
 
 struct Grouping_Expr : Expr {
-    Expr* expr;
+    static const ExprType KIND = ExprType::GROUPING;
 
-    Grouping_Expr(Expr* expr) : expr(expr) { type = ExprType::GROUPING; }
+    Expr_ID expr = EXPR_NONE;
+};
+
+// where a variable lives, filled in by the resolver so nothing after it has to look names up in environments
+struct Var_Address {
+    enum Kind : u8 {
+        UNRESOLVED,
+        GLOBAL,  // slot is the index of the global
+        LOCAL,   // slot is in the frame of a procedure, depth procedures out from the one the reference is in
+    };
+
+    Kind kind = UNRESOLVED;
+    u16 depth = 0;  // 0 for a variable of the procedure itself, 1 for one of the procedure it is nested in...
+    u32 slot = 0;
 };
 
 struct Variable_Expr : Expr {
-    Token identifier;
-    int var_id;  // in the current scope
+    static const ExprType KIND = ExprType::VARIABLE;
 
-    Variable_Expr(Token ident) : identifier(ident) { type = ExprType::VARIABLE; }
+    Symbol identifier = SYMBOL_NONE;  // the name is at location
+    Var_Address address;
 };
 
 struct Literal : Expr {
+    static const ExprType KIND = ExprType::LITERAL;
+
     Value value;
 
-    Literal(Value value) : value(value) { type = ExprType::LITERAL; }
+    Literal() = default;
+    Literal(Value value) : value(value) {}
 };
 
 struct Member_Expr : Expr {
-    Expr* expression;
-    Token member;
+    static const ExprType KIND = ExprType::MEMBER;
 
-    Member_Expr() { type = ExprType::MEMBER; }
+    Expr_ID expression = EXPR_NONE;
+    Symbol member = SYMBOL_NONE;
 };
 
 struct Call_Expr : Expr {
-    Expr* expression;
+    static const ExprType KIND = ExprType::CALL;
+
+    Expr_ID expression = EXPR_NONE;
     // an expression that should evaluate to a procedure
     // which can only be a call to another procedure that returns another procedure at the moment
-    Array<Expr*> arguments;  // this needs to be mutable because of collapse expression
-    int proc_id;
-
-    Call_Expr() : arguments(NULL, 0) { type = ExprType::CALL; }
+    Expr_List arguments;
+    int proc_id = 0;
 };
 
 // @todo
 /*
 struct Cast_Expr : Expr {
     Type_ID cast_type;
-    Expr* expr;
-
-    Cast_Expr(Type_ID cast_type, Expr* expr) : cast_type(cast_type), expr(expr) { type = ExprType::CAST; }
+    Expr_ID expr;
 };
 */
 
-void print_expr(Expr* expr);
-Expr* collapse_expr(Expr* expr);
+struct Ast;
+
+void print_expr(const Ast* ast, Expr_ID expr);
+// constant folding, new literals are added to the ast.
+// diagnostics are printed unless had_diagnostic is given, then it is only set
+Expr_ID collapse_expr(Ast* ast, Expr_ID expr, bool* had_diagnostic = NULL);
 
 // clears the string builder and fills it with expression string
-void expression_string(Expr* expression, String_Builder* builder);
+void expression_string(const Ast* ast, Expr_ID expression, String_Builder* builder);
 
-void expression_human_readable_string(Expr* expr, String_Builder* builder);
-const char* expr_type_str(const Expr* expr);
+void expression_human_readable_string(const Ast* ast, Expr_ID expr, String_Builder* builder);
+const char* expr_type_str(Expr_ID expr);
 
-ArrayView<Expr*> find_subexpressions(Expr* expr, ExprType type);
-int expr_deep(Expr* expr);
\ No newline at end of file
+ArrayView<Expr_ID> find_subexpressions(const Ast* ast, Expr_ID expr, ExprType type);
+int expr_deep(const Ast* ast, Expr_ID expr);
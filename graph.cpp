@@ -6,12 +6,13 @@
 #include "token.hpp"
 #include "expr.hpp"
 #include "stmt.hpp"
+#include "ast.hpp"
 
-char* expression_string(Expr* expr, const char* expr_name) {
+static char* node_label(const Expr* expr, const char* expr_name) {
   static char buffer[1024];
   int writen = 0;
 #ifdef DEBUG
-  writen = snprintf(buffer, 1024, "%s %s", expr_name, expr->source);
+  writen = snprintf(buffer, 1024, "%s %s", expr_name, expr_source_string(expr->source));
 #else
   writen = snprintf(buffer, 1024, "%s", expr_name);
 #endif
@@ -22,8 +23,8 @@ char* expression_string(Expr* expr, const char* expr_name) {
   return buffer;
 }
 
-bool expression_tree_to_dot(Expr* root, const char* filename) {
-  if (!root) {
+bool expression_tree_to_dot(const Ast* ast, Expr_ID root, const char* filename) {
+  if (root == EXPR_NONE) {
     fprintf(stderr, "INTERNAL : Provided expression is null to the graph generator\n");
     return false;
   }
@@ -39,120 +40,106 @@ bool expression_tree_to_dot(Expr* root, const char* filename) {
   int node_id = 0;
 
   struct Node_Info {
-    Expr* expr;
+    Expr_ID expr;
     int parent_id;
   };
 
   DArray<Node_Info> stack(1024);
-
-  // Node_Info stack[1024];
-  stack[0] = {root, 0};
-  int sp = 1;
+  stack.add({root, 0});
 
   int safety = 0;
 
-  Expr current_expr;
-  while (sp) {
+  while (stack.size) {
     if (safety > 1000) {
       fclose(file);
       panic_and_abort("INTERNAL: Probably infinite looping in the graph generator for expression");
     }
 
-    Node_Info ni = stack[sp-1];
+    Node_Info ni = stack.pop();
 
-    if (!ni.expr) {
-      sp--;
+    if (ni.expr == EXPR_NONE) {
       continue;
     }
 
-    current_expr = *ni.expr;
-
     // connect parent -> current
     fprintf(file, "  node%d -> node%d\n", ni.parent_id, node_id);
 
-    char scratch[1024];
-    switch (current_expr.type) {
+    String name;
+    switch (expr_type(ni.expr)) {
       case ExprType::BINARY: {
-        auto binary = static_cast<Binary_Expr*>(&current_expr);
+        auto binary = ast->get<Binary_Expr>(ni.expr);
 
-        fprintf(file, "  node%d [label=\"%s %s\"]\n", node_id, expression_string(binary, "Binary"), operator_string(binary->opperator));
+        fprintf(file, "  node%d [label=\"%s %s\"]\n", node_id, node_label(binary, "Binary"), operator_string(binary->opperator));
 
-        stack[sp] =     {binary->left, node_id};  // overwrite
-        stack[sp + 1] = {binary->right, node_id};
-        sp++;
+        stack.add({binary->right, node_id});
+        stack.add({binary->left, node_id});
         break;
       }
       case ExprType::UNARY: {
-        auto unary = static_cast<Unary_Expr*>(&current_expr);
+        auto unary = ast->get<Unary_Expr>(ni.expr);
 
-        fprintf(file, "  node%d [label=\"%s %s\"]\n", node_id, expression_string(unary, "Unary"), operator_string(unary->opperator));
+        fprintf(file, "  node%d [label=\"%s %s\"]\n", node_id, node_label(unary, "Unary"), operator_string(unary->opperator));
 
-        stack[sp] = {unary->operand, node_id};  // overwrite
+        stack.add({unary->operand, node_id});
         break;
       }
       case ExprType::GROUPING: {
-        auto grouping = static_cast<Grouping_Expr*>(&current_expr);
+        auto grouping = ast->get<Grouping_Expr>(ni.expr);
 
-        fprintf(file, "  node%d [label=\"%s\"]\n", node_id, expression_string(grouping, "Grouping"));
-        stack[sp] = {grouping->expr, node_id};  // overwrite
+        fprintf(file, "  node%d [label=\"%s\"]\n", node_id, node_label(grouping, "Grouping"));
+        stack.add({grouping->expr, node_id});
         break;
       }
       case ExprType::VARIABLE: {
-        auto variable = static_cast<Variable_Expr*>(&current_expr);
+        auto variable = ast->get<Variable_Expr>(ni.expr);
 
-        null_terminate(variable->identifier.lexeme, scratch);
-        fprintf(file, "  node%d [label=\"%s %s\"]\n", node_id, expression_string(variable, "Variable"), scratch);
-        sp--;
+        name = symbol_name(variable->identifier);
+        fprintf(file, "  node%d [label=\"%s %.*s\"]\n", node_id, node_label(variable, "Variable"), (int)name.size, name.data);
         break;
       }
       case ExprType::LITERAL: {
-        auto literal = static_cast<Literal*>(&current_expr);
+        auto literal = ast->get<Literal>(ni.expr);
 
-        null_terminate(literal->value.string(), scratch);
-        fprintf(file, "  node%d [label=\"%s %s\"]\n", node_id, expression_string(literal, "Literal"), scratch);
-        sp--;
+        name = literal->value.string();
+        fprintf(file, "  node%d [label=\"%s %.*s\"]\n", node_id, node_label(literal, "Literal"), (int)name.size, name.data);
         break;
       }
       case ExprType::CALL: {
-        auto call = static_cast<Call_Expr*>(&current_expr);
+        auto call = ast->get<Call_Expr>(ni.expr);
 
-        if (call->expression->type == ExprType::VARIABLE) {
-          auto proc = static_cast<Variable_Expr*>(call->expression);
-          null_terminate(proc->identifier.lexeme, scratch);
-          fprintf(file, "  node%d [label=\"%s %s ", node_id, expression_string(call, "Call"), scratch);
+        if (expr_type(call->expression) == ExprType::VARIABLE) {
+          name = symbol_name(ast->get<Variable_Expr>(call->expression)->identifier);
+          fprintf(file, "  node%d [label=\"%s %.*s ", node_id, node_label(call, "Call"), (int)name.size, name.data);
         } else {
-          fprintf(file, "  node%d [label=\"%s ", node_id, expression_string(call, "Call"));
+          fprintf(file, "  node%d [label=\"%s ", node_id, node_label(call, "Call"));
         }
 
-        for (int i = 0; i < call->arguments.size; i++) {
-          String_Builder sb(128);
-          expression_string(call->arguments.get(i), &sb);
+        String_Builder sb(128);
+        for (auto argument : ast->list(call->arguments)) {
+          expression_string(ast, argument, &sb);
           fprintf(file, " %s ", sb.c_string());
-          sb.free();
         }
+        sb.free();
 
         fprintf(file, "\"]\n");
-        stack[sp] = {call->expression, node_id};  // overwrite
+        stack.add({call->expression, node_id});
         break;
       }
       case ExprType::MEMBER: {
-        auto member = static_cast<Member_Expr*>(&current_expr);
+        auto member = ast->get<Member_Expr>(ni.expr);
 
-        null_terminate(member->member.lexeme, scratch);
-        fprintf(file, "  node%d [label=\"%s %s]\n", node_id, expression_string(member, "Member"), scratch);
-        stack[sp] = {member->expression, node_id};  // overwrite
+        name = symbol_name(member->member);
+        fprintf(file, "  node%d [label=\"%s %.*s\"]\n", node_id, node_label(member, "Member"), (int)name.size, name.data);
+        stack.add({member->expression, node_id});
         break;
       }
       default: {
         fprintf(stderr, "INTERNAL : Invalid expression type in graph creation\n");
-        sp--;
       }
     }
 
     node_id++;
     safety++;
-
-    stack.ensure_capacity(sp + 1);
   }
 
   fprintf(file, "}\n");
@@ -163,7 +150,7 @@ bool expression_tree_to_dot(Expr* root, const char* filename) {
   return true;
 }
 
-bool ast_to_dot(ArrayView<Stmt*> program, char* filename) {
+bool ast_to_dot(const Ast* ast, char* filename) {
   FILE* file = fopen(filename, "w");
   if (!file) {
     fprintf(stderr, "Couldn't open file: %s\n", filename);
@@ -172,8 +159,8 @@ bool ast_to_dot(ArrayView<Stmt*> program, char* filename) {
 
   int node_id = 1;
 
-  for (auto stmt : program) {
-    switch (stmt->kind) {
+  for (auto stmt : ast->list(ast->program)) {
+    switch (stmt_kind(stmt)) {
       case StmtKind::DECL_VAR: {
         fprintf(file, "  node%d [label=\"Variable Declaration\"]\n", node_id);
         break;
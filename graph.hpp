@@ -2,5 +2,7 @@
 
 // utility that uses graphiz to create visuallizations for several things we would like to do that to.
 
-struct Expr;
-bool expression_tree_to_dot(Expr* root, const char* filename);
+#include "node.hpp"
+
+struct Ast;
+bool expression_tree_to_dot(const Ast* ast, Expr_ID root, const char* filename);
@@ -0,0 +1,102 @@
+#include "intern.hpp"
+#include "template.hpp"
+
+// open addressing with linear probing over symbol ids, the names live in fixed blocks that never move
+// so the Strings handed out stay valid as the table grows
+
+static const size_t NAME_BLOCK_SIZE = 64 * 1024;
+
+struct Interner {
+  DArray<String> names;  // by symbol, index 0 is SYMBOL_NONE
+  DArray<u32> hashes;
+
+  Symbol* slots = NULL;  // SYMBOL_NONE for empty slots
+  size_t slot_count = 0;  // power of 2
+
+  char* block = NULL;
+  size_t block_used = 0;
+
+  Interner() {
+    names.add(String());
+    hashes.add(0);
+  }
+};
+
+static Interner interner;
+
+// fnv-1a
+static u32 hash_name(String name) {
+  u32 hash = 2166136261u;
+  for (size_t i = 0; i < name.size; i++) {
+    hash ^= (u8)name.data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static String store_name(String name) {
+  if (name.size > NAME_BLOCK_SIZE / 4) {  // big ones get their own allocation
+    char* data = (char*)malloc_or_die(name.size);
+    memcpy(data, name.data, name.size);
+    return String(data, name.size);
+  }
+
+  if (!interner.block || interner.block_used + name.size > NAME_BLOCK_SIZE) {
+    interner.block = (char*)malloc_or_die(NAME_BLOCK_SIZE);
+    interner.block_used = 0;
+  }
+
+  char* data = interner.block + interner.block_used;
+  memcpy(data, name.data, name.size);
+  interner.block_used += name.size;
+  return String(data, name.size);
+}
+
+static void grow_slots() {
+  size_t new_count = interner.slot_count ? interner.slot_count * 2 : 1024;
+  Symbol* new_slots = (Symbol*)malloc_or_die(new_count * sizeof(Symbol));
+  memset(new_slots, 0, new_count * sizeof(Symbol));
+
+  for (size_t i = 0; i < interner.slot_count; i++) {
+    Symbol symbol = interner.slots[i];
+    if (symbol == SYMBOL_NONE) continue;
+
+    size_t slot = interner.hashes.data[symbol] & (new_count - 1);
+    while (new_slots[slot] != SYMBOL_NONE) slot = (slot + 1) & (new_count - 1);
+    new_slots[slot] = symbol;
+  }
+
+  free(interner.slots);
+  interner.slots = new_slots;
+  interner.slot_count = new_count;
+}
+
+Symbol intern(String name) {
+  // keep the load factor under 1/2
+  if ((interner.names.size + 1) * 2 > interner.slot_count) grow_slots();
+
+  u32 hash = hash_name(name);
+  size_t mask = interner.slot_count - 1;
+  size_t slot = hash & mask;
+  while (interner.slots[slot] != SYMBOL_NONE) {
+    Symbol symbol = interner.slots[slot];
+    if (interner.hashes.data[symbol] == hash && compare_string(interner.names.data[symbol], name)) {
+      return symbol;
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  Symbol symbol = (Symbol)interner.names.size;
+  interner.names.add(store_name(name));
+  interner.hashes.add(hash);
+  interner.slots[slot] = symbol;
+  return symbol;
+}
+
+String symbol_name(Symbol symbol) {
+  return interner.names.get(symbol);
+}
+
+u32 symbol_count() {
+  return (u32)interner.names.size - 1;
+}
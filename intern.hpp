@@ -0,0 +1,19 @@
+#pragma once
+
+#include "common.hpp"
+
+// identifier interning, every distinct identifier of the compilation gets a dense symbol id.
+// names are compared by their ids everywhere after the lexer, and their bytes are stored once.
+
+typedef u32 Symbol;
+
+static const Symbol SYMBOL_NONE = 0;  // ids start from 1
+
+// the returned symbol is the same for every string with the same bytes, the bytes are copied
+Symbol intern(String name);
+
+// the interned copy, valid for the rest of the program
+String symbol_name(Symbol symbol);
+
+// number of symbols so far, ids are in [1, symbol_count]
+u32 symbol_count();
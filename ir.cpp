@@ -1,6 +1,7 @@
 #include "ir.hpp"
 #include "stmt.hpp"
 #include "expr.hpp"
+#include "ast.hpp"
 #include "linear_allocator.h"
 #include "template.hpp"
 #include "environment.hpp"
@@ -26,36 +27,36 @@
 
 // @fixme so much recursion
 
-int calculate_expression_instruction_count(Expr* expr, const Environment* scope) {
-    if (!expr) {
+int calculate_expression_instruction_count(const Ast* ast, Expr_ID expr, const Scope_Table* scope) {
+    if (expr == EXPR_NONE) {
         panic_and_abort("INTERNAL null expression on ir generation, shouldn't be on the tree at this point");
     }
 
     // @volatile @update expression_instruction_count
-    switch (expr->type) {
+    switch (expr_type(expr)) {
         case ExprType::BINARY: {
-            auto binary = static_cast<Binary_Expr*>(expr);
+            auto binary = ast->get<Binary_Expr>(expr);
             // @xxx both branches should exists, if we disable collapsing expression this is going to be a problem
-            return calculate_expression_instruction_count(binary->left, scope) +
-                   calculate_expression_instruction_count(binary->right, scope) + 1;
+            return calculate_expression_instruction_count(ast, binary->left, scope) +
+                   calculate_expression_instruction_count(ast, binary->right, scope) + 1;
         }
         case ExprType::UNARY: {
-            auto unary = static_cast<Unary_Expr*>(expr);
-            return calculate_expression_instruction_count(unary->operand, scope) + 1;
+            auto unary = ast->get<Unary_Expr>(expr);
+            return calculate_expression_instruction_count(ast, unary->operand, scope) + 1;
         }
         case ExprType::GROUPING: {
-            auto grouping = static_cast<Grouping_Expr*>(expr);
-            return calculate_expression_instruction_count(grouping->expr, scope);
+            auto grouping = ast->get<Grouping_Expr>(expr);
+            return calculate_expression_instruction_count(ast, grouping->expr, scope);
         }
         case ExprType::LITERAL:
         case ExprType::VARIABLE:
             return 1;
         case ExprType::MEMBER: {
-            auto member = static_cast<Member_Expr*>(expr);
+            auto member = ast->get<Member_Expr>(expr);
             return 0;  // @fixme @todo structures in ir
         }
         case ExprType::CALL: {
-            auto call = static_cast<Call_Expr*>(expr);
+            auto call = ast->get<Call_Expr>(expr);
             Procedure called_procedure = scope->get_proc_from_id(call->proc_id);
             return called_procedure.parameters.count + 1;
         }
@@ -65,20 +66,20 @@ int calculate_expression_instruction_count(Expr* expr, const Environment* scope)
 }
 
 // to 3AC
-ArrayView<IR_Instr> translate_expression(Expr* expr, const Environment* scope) {
+ArrayView<IR_Instr> translate_expression(const Ast* ast, Expr_ID expr, const Scope_Table* scope) {
     // first calculate the amount of instructions needed for the expression then actually translate
-    int count = calculate_expression_instruction_count(expr, scope);
+    int count = calculate_expression_instruction_count(ast, expr, scope);
     int curr = count - 1;
 
-    DArray<Expr*> stack;
+    DArray<Expr_ID> stack;
     stack.add(expr);
 
     // is this right?
     while (stack.size > 0) {
         auto top = stack.pop();
-        switch (top->type) {
+        switch (expr_type(top)) {
             case ExprType::BINARY: {
-                auto binary = static_cast<Binary_Expr*>(expr);
+                auto binary = ast->get<Binary_Expr>(top);
 
                 switch (binary->opperator) {
                     case Operator::NONE: {
@@ -111,13 +112,14 @@ ArrayView<IR_Instr> translate_expression(Expr* expr, const Environment* scope) {
                         break;
                     }
                 }
+                break;
             }
             case ExprType::UNARY: {
-                auto unary = static_cast<Unary_Expr*>(expr);
+                auto unary = ast->get<Unary_Expr>(top);
                 break;
             }
             case ExprType::GROUPING: {
-                auto grouping = static_cast<Grouping_Expr*>(expr);
+                auto grouping = ast->get<Grouping_Expr>(top);
                 break;
             }
             case ExprType::LITERAL: {
@@ -127,11 +129,11 @@ ArrayView<IR_Instr> translate_expression(Expr* expr, const Environment* scope) {
                 break;
             }
             case ExprType::MEMBER: {
-                auto member = static_cast<Member_Expr*>(expr);
+                auto member = ast->get<Member_Expr>(top);
                 break;
             }
             case ExprType::CALL: {
-                auto call = static_cast<Call_Expr*>(expr);
+                auto call = ast->get<Call_Expr>(top);
                 break;
             }
             default:
@@ -146,33 +148,33 @@ ArrayView<IR_Instr> translate_expression(Expr* expr, const Environment* scope) {
     return ArrayView<IR_Instr>(NULL, 0);
 }
 
-ArrayView<IR_Instr> translate(ArrayView<Stmt*> program, ArrayView<Environment> decls) {
+ArrayView<IR_Instr> translate(const Ast* ast, const Scope_Table* decls) {
     DArray<IR_Instr> nodes;
 
-    for (auto stmt : program) {
-        switch (stmt->kind) {
+    for (auto stmt : ast->list(ast->program)) {
+        switch (stmt_kind(stmt)) {
             case StmtKind::DECL_VAR: {
-                auto decl_var = static_cast<Decl_Var_Stmt*>(stmt);
+                auto decl_var = ast->get<Decl_Var_Stmt>(stmt);
                 break;
             }
             case StmtKind::DECL_PROC: {
-                auto decl_proc = static_cast<Decl_Proc_Stmt*>(stmt);
+                auto decl_proc = ast->get<Decl_Proc_Stmt>(stmt);
                 break;
             }
             case StmtKind::ASSIGN: {
-                auto assign = static_cast<Assign_Stmt*>(stmt);
+                auto assign = ast->get<Assign_Stmt>(stmt);
                 break;
             }
             case StmtKind::BLOCK: {
-                auto block = static_cast<Block_Stmt*>(stmt);
+                auto block = ast->get<Block_Stmt>(stmt);
                 break;
             }
             case StmtKind::IF: {
-                auto ifs = static_cast<If_Stmt*>(stmt);
+                auto ifs = ast->get<If_Stmt>(stmt);
                 break;
             }
             case StmtKind::FOR: {
-                auto fors = static_cast<For_Stmt*>(stmt);
+                auto fors = ast->get<For_Stmt>(stmt);
                 break;
             }
         }
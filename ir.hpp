@@ -27,7 +27,7 @@ struct IR_Instr {
     int operand2;
 };
 
-struct Environment;
-struct Stmt;
+struct Scope_Table;
+struct Ast;
 
-ArrayView<IR_Instr> translate(ArrayView<Stmt*> program, ArrayView<Environment> decls);
\ No newline at end of file
+ArrayView<IR_Instr> translate(const Ast* ast, const Scope_Table* decls);
\ No newline at end of file
@@ -2,27 +2,39 @@
 
 #include <cstdlib>
 #include <cassert>
+#include <thread>
 
 #include "log.hpp"
 #include "token.hpp"
 #include "common.hpp"
+#include "scan.hpp"
+#include "number.hpp"
 
+// only the byte position is tracked while lexing, lines are looked up from the line table when something is reported
 struct Source {
   String source;
   size_t current = 0;
-  int line = 1;
 
   bool at_end = false;
 
+  // a chunk of a parallel lex doesn't print anything, it only remembers that there was something to report
+  bool quiet = false;
+  bool had_diagnostic = false;
+
   Source(String source) : source(source) {}
 
+  // every diagnostic of the lexer goes through this
+  bool report() {
+    had_diagnostic = true;
+    return !quiet;
+  }
+
   char advance_if_match(char c) {
     if (!(current < source.size)) return '\0';
 
 
     if (source.get(current) == c) {
       current++;
-      if (c == '\n') line++;
       return c;
     }
 
@@ -35,7 +47,6 @@ struct Source {
       return '\0';
     }
 
-    if (source.get(current) == '\n') line++;
     current++;
     return source.get(current);
   }
@@ -46,7 +57,6 @@ struct Source {
       return '\0';
     }
 
-    if (source.get(current) == '\n') line++;
     current++;
     return source.get(current - 1);
   }
@@ -66,6 +76,34 @@ struct Source {
   char previous() const {
     return current ? source.get(current - 1) : '\0';
   }
+
+  int line() const {
+    return source_line(current);
+  }
+
+  // bulk skips, these don't look at at_end since they never step past the end of the source
+
+  void skip_whitespace() {
+    current = scan_whitespace(source.data, current, source.size);
+  }
+
+  void skip_identifier() {
+    current = scan_identifier(source.data, current, source.size);
+  }
+
+  void skip_digits() {
+    current = scan_digits(source.data, current, source.size);
+  }
+
+  // skips to the end of the line, past the newline if there is one
+  void skip_line() {
+    current = scan_line_end(source.data, current, source.size);
+    if (get() == '\n') current++;
+  }
+
+  void skip_to_comment_delimiter() {
+    current = scan_comment_delimiter(source.data, current, source.size);
+  }
 };
 
 static inline bool is_digit_ascii(char c) {
@@ -88,15 +126,18 @@ static inline bool is_valid_identifier_start(char c) {
   return is_alpha_ascii(c) || c == '_';
 }
 
-void lex_number(DArray<Token>&, Source&);
-void lex_ident(DArray<Token>&, Source&);
-void lex_string_literal(DArray<Token>&, Source&);
-void multilinecomment(Source&);
+// the lexing functions are templated on where the tokens go, either a Token_Buffer (batch)
+// or a Token_Stream (pull mode), both provide add, add_identifier and add_literal.
 
-bool handle_character(DArray<Token>& tokens, Source& source, char c);
+template <typename Tokens> bool lex_number(Tokens&, Source&);
+template <typename Tokens> void lex_ident(Tokens&, Source&);
+template <typename Tokens> void lex_string_literal(Tokens&, Source&);
+inline void multilinecomment(Source&);
 
-ArrayView<Token> lex(String src, bool* error) {
-  DArray<Token> tokens;
+template <typename Tokens> bool handle_character(Tokens& tokens, Source& source, char c);
+
+inline Token_Buffer lex(String src, bool* error) {
+  Token_Buffer tokens = Token_Buffer(src);
 
   Source source(src);
 
@@ -106,101 +147,89 @@ ArrayView<Token> lex(String src, bool* error) {
       *error = true;
   }
 
-  tokens.add(Token(String(), TokenType::END, Value(), source.line, (int)source.current));
+  tokens.add(TokenType::END, source.current, 0);
 
-  return ArrayView<Token>(tokens.data, tokens.size);
+  return tokens;
 }
 
-static inline void add_simple_token(Token&& token, DArray<Token>& tokens, Source& source) {
-  tokens.add(token);
-  source.advance();
+template <typename Tokens>
+static inline void add_simple_token(TokenType type, size_t length, Tokens& tokens, Source& source) {
+  tokens.add(type, source.current, length);
+  source.current += length;
 }
 
 // return success code
-bool handle_character(DArray<Token>& tokens, Source& source, char c) {
+template <typename Tokens>
+bool handle_character(Tokens& tokens, Source& source, char c) {
     switch (c) {
     case ' ':
     case '\t':
     case '\n':
-      source.advance();
+      source.skip_whitespace();
       break;
 
     case '.':
-      add_simple_token(Token(String(".", 1), TokenType::DOT, Value(), source.line, (int)source.current), tokens, source);
+      add_simple_token(TokenType::DOT, 1, tokens, source);
       break;
     case '%':
-      add_simple_token(Token(String("%", 1), TokenType::PERCENT, Value(), source.line,(int)source.current), tokens, source);
+      add_simple_token(TokenType::PERCENT, 1, tokens, source);
       break;
 
     case '-':
-      add_simple_token(Token(String("-", 1), TokenType::MINUS, Value(), source.line,(int)source.current), tokens, source);
+      add_simple_token(TokenType::MINUS, 1, tokens, source);
       break;
     case '+':
-      add_simple_token(Token(String("+", 1), TokenType::PLUS, Value(), source.line,(int)source.current), tokens, source);
+      add_simple_token(TokenType::PLUS, 1, tokens, source);
       break;
     case '*':
-      add_simple_token(Token(String("*", 1), TokenType::STAR, Value(), source.line,(int)source.current), tokens, source);
+      add_simple_token(TokenType::STAR, 1, tokens, source);
       break;
 
     case ',':
-      add_simple_token(Token(String(",", 1), TokenType::COMMA, Value(), source.line,(int)source.current), tokens, source);
+      add_simple_token(TokenType::COMMA, 1, tokens, source);
       break;
     case ':':
-      add_simple_token(Token(String(":", 1), TokenType::COLON, Value(), source.line,(int)source.current), tokens, source);
+      add_simple_token(TokenType::COLON, 1, tokens, source);
       break;
     case '(':
-      add_simple_token(Token(String("(",1), TokenType::PAREN_LEFT, Value(), source.line,(int)source.current), tokens, source);
+      add_simple_token(TokenType::PAREN_LEFT, 1, tokens, source);
       break;
     case ')':
-      add_simple_token(Token(String(")",1), TokenType::PAREN_RIGHT, Value(), source.line,(int)source.current), tokens, source);
+      add_simple_token(TokenType::PAREN_RIGHT, 1, tokens, source);
       break;
     case '{':
-      add_simple_token(Token(String("{",1), TokenType::BRACE_LEFT, Value(), source.line, (int)source.current), tokens, source);
+      add_simple_token(TokenType::BRACE_LEFT, 1, tokens, source);
       break;
     case '}':
-      add_simple_token(Token(String("}"), TokenType::BRACE_RIGHT, Value(), source.line, (int)source.current), tokens, source);
+      add_simple_token(TokenType::BRACE_RIGHT, 1, tokens, source);
       break;
     case '[':
-      add_simple_token(Token(String("["), TokenType::SQUARE_LEFT, Value(), source.line, (int)source.current), tokens, source);
+      add_simple_token(TokenType::SQUARE_LEFT, 1, tokens, source);
       break;
     case ']':
-      add_simple_token(Token(String("]"), TokenType::SQUARE_RIGHT, Value(), source.line, (int)source.current), tokens, source);
+      add_simple_token(TokenType::SQUARE_RIGHT, 1, tokens, source);
       break;
     case ';':
-      add_simple_token(Token(String(";"), TokenType::SEMICOLON, Value(), source.line, (int)source.current), tokens, source);
+      add_simple_token(TokenType::SEMICOLON, 1, tokens, source);
       break;
     case '!': {
-      source.advance();
-      if (source.get() == '=') {
-        add_simple_token(Token(String("!="), TokenType::EXCLAMATION_EQUAL, Value(), source.line, (int)source.current), tokens, source);
-      }
-      else tokens.add(Token(String("!"), TokenType::EXCLAMATION, Value(), source.line, (int)source.current));
+      if (source.peek() == '=') add_simple_token(TokenType::EXCLAMATION_EQUAL, 2, tokens, source);
+      else add_simple_token(TokenType::EXCLAMATION, 1, tokens, source);
     } break;
     case '=': {
-      source.advance();
-      if (source.get() == '=') {
-        add_simple_token(Token(String("==",2), TokenType::EQUAL_EQUAL, Value(), source.line, (int)source.current), tokens, source);
-      }
-      else tokens.add({"=", TokenType::EQUAL, Value(), source.line, (int)source.current});
+      if (source.peek() == '=') add_simple_token(TokenType::EQUAL_EQUAL, 2, tokens, source);
+      else add_simple_token(TokenType::EQUAL, 1, tokens, source);
     } break;
     case '>': {
-      source.advance();
-      if (source.get() == '=') {
-        add_simple_token({">=", TokenType::GREATER_EQUAL, Value(), source.line, (int)source.current}, tokens, source);
-      }
-      else tokens.add({">", TokenType::GREATER, Value(), source.line, (int)source.current});
+      if (source.peek() == '=') add_simple_token(TokenType::GREATER_EQUAL, 2, tokens, source);
+      else add_simple_token(TokenType::GREATER, 1, tokens, source);
     } break;
     case '<': {
-      source.advance();
-      if (source.get() == '=') {
-        add_simple_token({"<=", TokenType::LESS_EQUAL, Value(), source.line, (int)source.current}, tokens, source);
-      }
-      else {
-        tokens.add({"<", TokenType::LESS, Value(), source.line, (int)source.current});
-      }
+      if (source.peek() == '=') add_simple_token(TokenType::LESS_EQUAL, 2, tokens, source);
+      else add_simple_token(TokenType::LESS, 1, tokens, source);
     } break;
     case '#': {
-      add_simple_token({"#", TokenType::HASH, Value(), source.line, (int)source.current}, tokens, source);
+      add_simple_token(TokenType::HASH, 1, tokens, source);
       break;
     }
     case '"': {
@@ -208,33 +237,34 @@ bool handle_character(DArray<Token>& tokens, Source& source, char c) {
     } break;
     case '/': {
       if (source.peek() == '/') {
-        while (source.advance() != '\n') {
-          if (source.get() == '\0') break;
-        }
-        if (source.previous() != '\n') {
-          warning(source.line, "No newline found at the end while processing comment");
+        source.current += 2;  // //
+        source.skip_line();
+        if (source.previous() != '\n' && source.report()) {
+          warning(source.line(), "No newline found at the end while processing comment");
         }
       }
-      else if (source.get() == '*') {
+      else if (source.peek() == '*') {
         multilinecomment(source);
       }
       else {
-        add_simple_token(Token(String("/"), TokenType::SLASH, Value(), source.line, (int)source.current), tokens, source);
+        add_simple_token(TokenType::SLASH, 1, tokens, source);
       }
     } break;
     default: {
       if (is_digit_ascii(c)) {
-        lex_number(tokens, source);
+        return lex_number(tokens, source);
       }
       else if (is_valid_identifier_start(c)) {
         lex_ident(tokens, source);
       }
       else {
-        static int count = 0;
-        errorf(source.line, "Unexpected character : %c", source.get());
+        if (source.report()) {
+          static int count = 0;
+          errorf(source.line(), "Unexpected character : %c", source.get());
+          count++;
+          if (count > 100) panic_and_abort("Bad input string");
+        }
         source.advance();
-        count++;
-        if (count > 100) panic_and_abort("Bad input string");
         return false;
       }
     } break;
@@ -243,91 +273,392 @@ bool handle_character(DArray<Token>& tokens, Source& source, char c) {
     return true;
 }
 
-void lex_number(DArray<Token>& tokens, Source& source) {
-  size_t start = (int)source.current;
-  while (is_digit_ascii(source.next())) {}
+template <typename Tokens>
+bool lex_number(Tokens& tokens, Source& source) {
+  size_t start = source.current;
+  source.skip_digits();
   if (source.get() == '.') {  // floating point
-    while (is_digit_ascii(source.next())) {}
-    Mutable_String number_str = Mutable_String(source.source.data, start, (int)source.current);
-    double result = strtod(number_str.data, NULL);   // TODO do this yourself
-    tokens.add(Token(String(number_str.data, number_str.size), TokenType::NUMERIC_LITERAL, Value(result), source.line, source.current));
-  } else {
-    Mutable_String number_str = Mutable_String(source.source.data, start, (int)source.current);
-    long result = atoi(number_str.data);
-    tokens.add(Token(String(number_str.data, number_str.size), TokenType::NUMERIC_LITERAL, Value(result), source.line, source.current));
+    source.current++;
+    source.skip_digits();
+    double result = parse_real_literal(source.source.data + start, source.current - start);
+    tokens.add_literal(TokenType::NUMERIC_LITERAL, start, source.current - start, Value(result));
+    return true;
   }
-}
 
-struct token_type_string {
-    TokenType type;
-    const char* string;
-};
+  long result;
+  bool fits = parse_integer_literal(source.source.data + start, source.current - start, &result);
+  if (!fits && source.report()) {
+    errorf(source.line(), "Integer literal %.*s is too large", (int)(source.current - start), source.source.data + start);
+  }
+  tokens.add_literal(TokenType::NUMERIC_LITERAL, start, source.current - start, Value(result));
+  return fits;
+}
 
-token_type_string reserved[] = {
-    {TokenType::VAR, "var"},
-    {TokenType::FOR, "for"},
-    {TokenType::WHILE, "while"},
-    {TokenType::TRUE, "true"},
-    {TokenType::FALSE, "false"},
-    {TokenType::RETURN, "return"},
-    {TokenType::OR, "or"},
-    {TokenType::AND, "and"},
-    {TokenType::IF, "if"},
-    {TokenType::ELSE, "else"},
-    {TokenType::PROC, "proc"},
-    {TokenType::IMPORT, "import"},
-    {TokenType::INT, "int"},
-    {TokenType::FLOAT, "float"},
-    {TokenType::STRING, "string"},
-};
+// keywords are told apart by length first, then by the first character, so an identifier is compared against at most one keyword
+static TokenType keyword_type(const char* s, size_t length) {
+    auto is = [&](const char* keyword) { return memcmp(s, keyword, length) == 0; };
+
+    switch (length) {
+        case 2:
+            switch (s[0]) {
+                case 'o': if (is("or")) return TokenType::OR; break;
+                case 'i': if (is("if")) return TokenType::IF; break;
+            }
+            break;
+        case 3:
+            switch (s[0]) {
+                case 'v': if (is("var")) return TokenType::VAR; break;
+                case 'f': if (is("for")) return TokenType::FOR; break;
+                case 'a': if (is("and")) return TokenType::AND; break;
+                case 'i': if (is("int")) return TokenType::INT; break;
+            }
+            break;
+        case 4:
+            switch (s[0]) {
+                case 't': if (is("true")) return TokenType::TRUE; break;
+                case 'e': if (is("else")) return TokenType::ELSE; break;
+                case 'p': if (is("proc")) return TokenType::PROC; break;
+            }
+            break;
+        case 5:
+            switch (s[0]) {
+                case 'w': if (is("while")) return TokenType::WHILE; break;
+                case 'f':
+                    if (is("false")) return TokenType::FALSE;
+                    if (is("float")) return TokenType::FLOAT;
+                    break;
+            }
+            break;
+        case 6:
+            switch (s[0]) {
+                case 'r': if (is("return")) return TokenType::RETURN; break;
+                case 'i': if (is("import")) return TokenType::IMPORT; break;
+                case 's': if (is("string")) return TokenType::STRING; break;
+            }
+            break;
+    }
 
-void lex_ident(DArray<Token>& tokens, Source& source) {
-    size_t start = (int)source.current;
-    while (is_valid_identifier_char(source.next())) {}
+    return TokenType::IDENTIFIER;
+}
 
-    String ident = String(Mutable_String(source.source.data, start, (int)source.current));
-    for (size_t i = 0; i < ARRAY_SIZE(reserved); i++) {
-        if (ident.equals(reserved[i].string)) {
-          tokens.add({reserved[i].string, reserved[i].type, Value(), source.line, (int)source.current});
-          return;
-        }
-    }
+// the lexeme is a slice of the source, the source has to outlive the tokens
+template <typename Tokens>
+void lex_ident(Tokens& tokens, Source& source) {
+    size_t start = source.current;
+    source.skip_identifier();
 
-    Token identifier = Token(String(ident.data, ident.size), TokenType::IDENTIFIER, Value(), source.line, (int)source.current);
-    tokens.add(identifier);
+    size_t length = source.current - start;
+    TokenType type = keyword_type(source.source.data + start, length);
+    if (type == TokenType::IDENTIFIER) tokens.add_identifier(start, length);
+    else tokens.add(type, start, length);
 }
 
-void lex_string_literal(DArray<Token>& tokens, Source& source) {
+template <typename Tokens>
+void lex_string_literal(Tokens& tokens, Source& source) {
   // current should be pointing at the starting quote
   assert(source.advance() == '"');
   size_t start = (int)source.current;
   while (source.get() && source.advance() != '"') {}
 
   if (source.get() != '"' && source.at_end) {
-    error(source.line, "Unterminated string literal at the end of input");
+    if (source.report()) error(source.line(), "Unterminated string literal at the end of input");
     return;
   }
 
-  Mutable_String str_lit = Mutable_String(source.source.data, start, (int)source.current - 1);
-  // NOTE we chose to not put a dumy lexeme here which means the entire program is not allowed to touch a tokens lexeme without checking its type
-  tokens.add(Token((const char*)NULL /* no lexeme for string literals */, TokenType::STRING_LITERAL, Value(String(str_lit.data, str_lit.size)), source.line, (int)source.current));
+  // the lexeme includes the quotes, the value is the contents
+  String str_lit = String(source.source.data + start, source.current - 1 - start);
+  tokens.add_literal(TokenType::STRING_LITERAL, start - 1, source.current - (start - 1), Value(str_lit));
+}
+
+inline void multilinecomment(Source& source) {
+  assert(source.get() == '/' && source.peek() == '*');
+  source.current += 2;  // /*
+
+  int nest_count = 1;
+  while (nest_count) {
+    source.skip_to_comment_delimiter();
+
+    char c = source.get();
+    if (c == '\0') {
+      if (source.report()) warning(source.line(), "Unterminated multiline comment at the end of input");
+      return;
+    }
+
+    if (c == '*' && source.peek() == '/') {
+      source.current += 2;
+      nest_count--;
+    }
+    else if (c == '/' && source.peek() == '*') {
+      source.current += 2;
+      nest_count++;
+    }
+    else {
+      source.current++;
+    }
+  }
 }
 
-void multilinecomment(Source& source) {
-  // assert(source.get() == '/' && source.peek() == '*');
+// parallel lexing of big inputs. the source is split into chunks at newlines the sequential lexer would skip as
+// whitespace (so not inside a string literal or a comment), every chunk is lexed on its own thread and the
+// buffers are concatenated. a chunk lexes the whole source starting from its split, so the offsets are already
+// absolute, and lines are looked up from those anyway.
+// if any chunk has something to report the input is lexed again sequentially, so diagnostics come out exactly
+// as they would without threads.
+
+static const size_t LEX_MIN_CHUNK_SIZE = 256 * 1024;
+
+// the same nesting rules as multilinecomment, position is at the opening /*
+inline size_t skip_multiline_comment(const char* data, size_t position, size_t size) {
+  position += 2;
+
   int nest_count = 1;
-  while (source.get()) {
-    if (!nest_count) break;
-    if (source.advance_if_match('\n') == '\n') {}
-    else if (source.get() == '*' && source.peek() == '/') {
-      source.advance();
+  while (nest_count) {
+    position = scan_comment_delimiter(data, position, size);
+    if (position >= size || data[position] == '\0') break;
+
+    char next = (position + 1 < size) ? data[position + 1] : '\0';
+    if (data[position] == '*' && next == '/') {
+      position += 2;
       nest_count--;
     }
-    else if (source.get() == '/' && source.peek() == '*') {
-      source.advance();
+    else if (data[position] == '/' && next == '*') {
+      position += 2;
       nest_count++;
     }
+    else {
+      position++;
+    }
+  }
+
+  return position;
+}
+
+// start of every chunk followed by where lexing stops (the end of the source or the first null character).
+// only string literals and comments can hide a newline from the lexer, so the pre-scan follows just those.
+inline DArray<size_t> lex_split_points(String src, size_t chunk_count) {
+  const char* data = src.data;
+  size_t size = src.size;
+  size_t chunk_size = size / chunk_count;
+
+  DArray<size_t> splits;
+  splits.add(0);
+
+  size_t target = chunk_size;
+  size_t position = 0;
+  while (position < size && data[position] != '\0') {
+    // no string or comment starts before special, any newline in between is a safe split
+    size_t special = scan_quote_or_slash(data, position, size);
+    while (target < special && splits.size < chunk_count) {
+      size_t newline = scan_line_end(data, target > position ? target : position, special);
+      if (newline >= special) break;
+
+      splits.add(newline + 1);
+      target = newline + 1 + chunk_size;
+    }
+
+    if (special >= size || data[special] == '\0') {
+      position = special;
+      break;
+    }
+
+    char next = (special + 1 < size) ? data[special + 1] : '\0';
+    if (data[special] == '"') {
+      position = scan_quote(data, special + 1, size);
+      if (position < size && data[position] == '"') position++;
+    }
+    else if (next == '/') {
+      // stop at the newline that ends the comment, it is a split candidate like any other
+      position = scan_line_end(data, special + 2, size);
+    }
+    else if (next == '*') {
+      position = skip_multiline_comment(data, special, size);
+    }
+    else {
+      position = special + 1;
+    }
+  }
+
+  splits.add(position < size ? position : size);
+  return splits;
+}
+
+inline Token_Buffer lex_parallel(String src, bool* error, size_t thread_count) {
+  size_t chunk_count = src.size / LEX_MIN_CHUNK_SIZE;
+  if (chunk_count > thread_count) chunk_count = thread_count;
+  if (chunk_count < 2) return lex(src, error);
+
+  DArray<size_t> splits = lex_split_points(src, chunk_count);
+  chunk_count = splits.size - 1;
+  if (chunk_count < 2) {  // most of the input is in a single comment or string
+    splits.free();
+    return lex(src, error);
+  }
+
+  Token_Buffer* chunks = new Token_Buffer[chunk_count];
+  bool* diagnostics = new bool[chunk_count];
+
+  auto lex_chunk = [&](size_t index) {
+    Source source(String(src.data, splits[index + 1]));
+    source.current = splits[index];
+    source.quiet = true;
+
+    Token_Buffer* tokens = &chunks[index];
+    tokens->source = src;
+    tokens->intern_identifiers = false;  // the interner isn't thread safe, append interns them in order
+    while (source.get() != '\0' && !source.had_diagnostic) {
+      handle_character(*tokens, source, source.get());
+    }
+
+    diagnostics[index] = source.had_diagnostic;
+  };
+
+  std::thread* workers = new std::thread[chunk_count - 1];
+  for (size_t i = 1; i < chunk_count; i++) {
+    workers[i - 1] = std::thread(lex_chunk, i);
+  }
+  lex_chunk(0);
+  for (size_t i = 0; i < chunk_count - 1; i++) {
+    workers[i].join();
+  }
+  delete[] workers;
+
+  bool redo = false;
+  for (size_t i = 0; i < chunk_count; i++) {
+    if (diagnostics[i]) redo = true;
+  }
+
+  Token_Buffer tokens = Token_Buffer(src);
+  if (!redo) {
+    for (size_t i = 0; i < chunk_count; i++) {
+      tokens.append(chunks[i]);
+    }
+    tokens.add(TokenType::END, splits[chunk_count], 0);
+  }
+
+  for (size_t i = 0; i < chunk_count; i++) {
+    chunks[i].free();
+  }
+  delete[] chunks;
+  delete[] diagnostics;
+  splits.free();
 
-    source.advance();
+  if (redo) {
+    tokens.free();
+    return lex(src, error);
   }
+
+  return tokens;
 }
+
+// pull mode lexer, the parser reads tokens through this by their absolute index and they are lexed on demand.
+// in streaming mode only the last WINDOW tokens are kept, so memory doesn't depend on the size of the input,
+// in batch mode this is just a view over an already lexed Token_Buffer.
+struct Token_Stream {
+  // has to cover the parser's lookbehind (previous) and lookahead (peek, error_if_match)
+  static const size_t WINDOW = 8;
+
+  const Token_Buffer* buffer = NULL;  // batch mode
+
+  Source source = Source(String());
+  size_t lexed = 0;  // tokens produced so far
+  bool finished = false;  // END is lexed
+  bool had_error = false;
+
+  u8 types[WINDOW];
+  u32 offsets[WINDOW];
+  u32 lengths[WINDOW];
+  Symbol symbols[WINDOW];
+  Value values[WINDOW];
+
+  explicit Token_Stream(const Token_Buffer* buffer) : buffer(buffer) {}
+  explicit Token_Stream(String src) : source(src) {}
+
+  // sink interface for the lexing functions
+  void add(TokenType type, size_t offset, size_t length) {
+    add_literal(type, offset, length, Value());
+  }
+
+  void add_identifier(size_t offset, size_t length) {
+    add_literal(TokenType::IDENTIFIER, offset, length, Value(), intern(String(source.source.data + offset, length)));
+  }
+
+  void add_literal(TokenType type, size_t offset, size_t length, Value value, Symbol symbol = SYMBOL_NONE) {
+    size_t slot = lexed % WINDOW;
+    types[slot] = (u8)type;
+    offsets[slot] = (u32)offset;
+    lengths[slot] = (u32)length;
+    symbols[slot] = symbol;
+    values[slot] = value;
+    lexed++;
+  }
+
+  // lex until the token at index exists or the input is exhausted
+  void pull(size_t index) {
+    while (lexed <= index && !finished) {
+      char c = source.get();
+      if (c == '\0') {
+        add(TokenType::END, source.current, 0);
+        finished = true;
+        break;
+      }
+
+      if (!handle_character(*this, source, c))
+        had_error = true;
+    }
+  }
+
+  // slot of the token at index, pulls it if needed
+  size_t slot(size_t index) {
+    pull(index);
+    if (index >= lexed) {
+      panic_and_abort("Index out of range (Token_Stream)");
+    }
+    if (index + WINDOW < lexed) {
+      panic_and_abort("INTERNAL: Token is no longer in the lookahead window of the token stream");
+    }
+
+    return index % WINDOW;
+  }
+
+  // replaces index < count, since the count isn't known before END in streaming mode
+  bool in_range(size_t index) {
+    if (buffer) return index < buffer->count();
+
+    pull(index);
+    return index < lexed;
+  }
+
+  TokenType type(size_t index) {
+    if (buffer) return buffer->type(index);
+    return (TokenType)types[slot(index)];
+  }
+
+  size_t offset(size_t index) {
+    if (buffer) return buffer->offsets.get(index);
+    return offsets[slot(index)];
+  }
+
+  // only for diagnostics, this is what builds the line table
+  int line(size_t index) {
+    return source_line(offset(index));
+  }
+
+  Symbol symbol(size_t index) {
+    if (buffer) return buffer->symbols.get(index);
+    return symbols[slot(index)];
+  }
+
+  Value value(size_t index) {
+    if (buffer) return buffer->value(index);
+    return values[slot(index)];
+  }
+
+  Token get(size_t index) {
+    if (buffer) return buffer->get(index);
+
+    size_t at = slot(index);
+    TokenType token_type = (TokenType)types[at];
+    String lexeme = (token_type == TokenType::END) ? String() : String(source.source.data + offsets[at], lengths[at]);
+    return Token(lexeme, token_type, values[at], (int)offsets[at], symbols[at]);
+  }
+};
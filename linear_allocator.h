@@ -11,53 +11,134 @@ extern "C" {
 #include <stdlib.h>
 #include <string.h>
 
+// chunked bump allocator, memory handed out never moves since a full chunk is just left behind for a new one.
+// everything is released at once: reset_allocator keeps the chunks around for the next use and takes constant time,
+// destroy_allocator gives them back to the system.
+
+typedef struct LA_Chunk {
+  struct LA_Chunk* next;  // the chunk that was filled before this one
+  size_t used;  // in bytes
+  size_t size;  // in bytes, not counting the header
+} LA_Chunk;
+
 typedef struct {
-  uintptr_t* data;  // to match the word size
-  size_t used;
-  size_t size;
+  LA_Chunk* current;  // allocations come from here
+  LA_Chunk* oldest;   // end of the list starting at current
+  LA_Chunk* free_chunks;  // chunks from before the last reset
+  size_t chunk_size;  // default size of a new chunk
 } Linear_Allocator;
 
-Linear_Allocator make_allocator(size_t size);
+Linear_Allocator make_allocator(size_t chunk_size);
 void* allocate(Linear_Allocator* la, size_t size);
-void deallocate(Linear_Allocator* la, size_t size);
+void deallocate(Linear_Allocator* la, size_t size);  // give back the end of the last allocation
+void reset_allocator(Linear_Allocator* la);
+void destroy_allocator(Linear_Allocator* la);
 
 #ifdef LA_IMPLEMENTATION
 
-Linear_Allocator make_allocator(size_t size) {
-  uintptr_t* data = (uintptr_t*)malloc(size);
-  if (!data) {
-    fprintf(stderr, "Malloc failed trying to create a linear allocator buffer with size %zu\n", size);
-    exit(1);
+// the header is a multiple of the word size so the data after it stays aligned
+#define LA_HEADER_SIZE next_multiple_of_wordsize(sizeof(LA_Chunk))
+
+static char* la_chunk_data(LA_Chunk* chunk) {
+  return (char*)chunk + LA_HEADER_SIZE;
+}
+
+Linear_Allocator make_allocator(size_t chunk_size) {
+  Linear_Allocator la;
+  la.current = NULL;
+  la.oldest = NULL;
+  la.free_chunks = NULL;
+  la.chunk_size = chunk_size;
+  return la;
+}
+
+static LA_Chunk* la_new_chunk(Linear_Allocator* la, size_t size) {
+  // reuse the first free chunk if it is big enough, the free list is mostly chunks of the default size
+  LA_Chunk* chunk = la->free_chunks;
+  if (chunk && chunk->size >= size) {
+    la->free_chunks = chunk->next;
+  }
+  else {
+    size_t chunk_size = MAX(size, la->chunk_size);
+    chunk = (LA_Chunk*)malloc(LA_HEADER_SIZE + chunk_size);
+    if (!chunk) {
+      fprintf(stderr, "Malloc failed trying to create a linear allocator chunk with size %zu\n", chunk_size);
+      exit(1);
+    }
+    chunk->size = chunk_size;
   }
 
-  return (Linear_Allocator) {data, 0, size};
+  chunk->used = 0;
+  chunk->next = la->current;
+  la->current = chunk;
+  if (!la->oldest) la->oldest = chunk;
+  return chunk;
 }
 
 // @xxx takes up a precious name in the global namespace
 void* allocate(Linear_Allocator* la, size_t size) {
   size_t alloc_size = next_multiple_of_wordsize(size);
-  if (la->size < la->used + alloc_size) {
-    uintptr_t* tmp = (uintptr_t*)malloc(la->size * 1.5);  // 1.5 arbitrary
-    memcpy(tmp, la->data, la->used);
-    free(la->data);
-    la->data = tmp;
+
+  LA_Chunk* chunk = la->current;
+  if (!chunk || chunk->size - chunk->used < alloc_size) {
+    chunk = la_new_chunk(la, alloc_size);
   }
 
-  void* mem = ((uintptr_t*)la->data) + la->used;
-  la->used += size;
+  void* mem = la_chunk_data(chunk) + chunk->used;
+  chunk->used += alloc_size;
 
   return mem;
 }
 
 void deallocate(Linear_Allocator* la, size_t size) {
-  size_t dealloc_size = MIN(size, la->used);
+  if (!la->current) return;
+
+  size_t dealloc_size = MIN(next_multiple_of_wordsize(size), la->current->used);
+  la->current->used -= dealloc_size;
+}
 
-  la->used -= dealloc_size;
+void reset_allocator(Linear_Allocator* la) {
+  if (!la->current) return;
+
+  la->oldest->next = la->free_chunks;
+  la->free_chunks = la->current;
+  la->current = NULL;
+  la->oldest = NULL;
+}
+
+static void la_free_chunks(LA_Chunk* chunk) {
+  while (chunk) {
+    LA_Chunk* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+}
+
+void destroy_allocator(Linear_Allocator* la) {
+  la_free_chunks(la->current);
+  la_free_chunks(la->free_chunks);
+  la->current = NULL;
+  la->oldest = NULL;
+  la->free_chunks = NULL;
 }
 
 #endif
 
-#undef MIN
 #ifdef __cplusplus
 }
+
+#include <new>
+#include <utility>
+
+// construct a T in the allocator, nothing is destructed when the allocator is reset
+template <typename T, typename... Args>
+T* arena_new(Linear_Allocator* la, Args&&... args) {
+  void* mem = allocate(la, sizeof(T));
+  return new (mem) T(std::forward<Args>(args)...);
+}
+
+template <typename T>
+T* arena_array(Linear_Allocator* la, size_t count) {
+  return (T*)allocate(la, count * sizeof(T));
+}
 #endif
@@ -1,9 +1,55 @@
 #include "log.hpp"
+#include <atomic>
 
 // @todo cleanup this entire file
 
+static thread_local Diagnostic_Buffer* capture = NULL;
+static std::atomic<size_t> reported(0);
+
+size_t diagnostics_reported() {
+  return reported.load(std::memory_order_relaxed);
+}
+
+void capture_diagnostics(Diagnostic_Buffer* buffer) {
+  capture = buffer;
+}
+
+void write_diagnostics(const Diagnostic_Buffer* buffer, size_t first, size_t end) {
+  for (size_t i = first; i < end; i++) {
+    auto entry = buffer->entries.data[i];
+    fwrite(buffer->text.data + entry.begin, 1, entry.end - entry.begin, entry.to_stderr ? stderr : stdout);
+  }
+}
+
+// every message of this file goes through here
+static void emit(FILE* stream, char const * const format, ...) {
+  reported.fetch_add(1, std::memory_order_relaxed);
+
+  va_list args;
+  va_start(args, format);
+
+  if (!capture) {
+    vfprintf(stream, format, args);
+    va_end(args);
+    return;
+  }
+
+  char formatted[2048];
+  int length = vsnprintf(formatted, sizeof(formatted), format, args);
+  va_end(args);
+  if (length < 0) return;
+  if ((size_t)length >= sizeof(formatted)) length = sizeof(formatted) - 1;
+
+  Diagnostic_Buffer::Entry entry;
+  entry.to_stderr = stream == stderr;
+  entry.begin = (u32)capture->text.size;
+  for (int i = 0; i < length; i++) capture->text.add(formatted[i]);
+  entry.end = (u32)capture->text.size;
+  capture->entries.add(entry);
+}
+
 static void report(int line, char const * const where, char const * const msg) {
-  fprintf(stderr, "[line:%d], %s: %s\n", line, where, msg);
+  emit(stderr, "[line:%d], %s: %s\n", line, where, msg);
 }
 
 static void reportf(int line, char const * const where, char const * const fmsg, ...) {
@@ -14,7 +60,7 @@ static void reportf(int line, char const * const where, char const * const fmsg,
   vsnprintf(formatted_msg, sizeof(formatted_msg), fmsg, args);
   va_end(args);
 
-  fprintf(stderr, "[line:%d], Error %s %s\n", line, where, formatted_msg);
+  emit(stderr, "[line:%d], Error %s %s\n", line, where, formatted_msg);
 }
 
 // this changes order of arguments because varargs are terrible
@@ -26,13 +72,13 @@ static void reportf_where(int line, char const * const msg, char const * const f
   vsnprintf(formatted_where, sizeof(formatted_where), fwhere, args);
   va_end(args);
 
-  fprintf(stderr, "[line:%d], Error %s: %s\n", line, formatted_where, msg);
+  emit(stderr, "[line:%d], Error %s: %s\n", line, formatted_where, msg);
 }
 
 void errorf(int line, char const * const fmsg, ...) {
   char formatted_msg[1024];
 
-  printf("ERROR: \n");
+  emit(stdout, "ERROR: \n");
 
   va_list args;
   va_start(args, fmsg);
@@ -48,18 +94,18 @@ void error(int line, char const * const msg) {
 void error(Token t, char const * const msg) {
   char buff[1024];
   null_terminate(t.lexeme, buff);
-  fprintf(stderr, "ERROR: At token: %s | %s | line: %d  error: %s\n", buff, token_type_str(t.type), t.line, msg);
+  emit(stderr, "ERROR: At token: %s | %s | line: %d  error: %s\n", buff, token_type_str(t.type), t.line(), msg);
   t.value.print();
 }
 
 void warning(int line, char const * const msg) {
-  fprintf(stderr, "WARNING: at line %d %s\n", line, msg);
+  emit(stderr, "WARNING: at line %d %s\n", line, msg);
 }
 
 void warningf(int line, char const * const fmsg, ...) {
   char formatted_msg[1024];
 
-  printf("WARNING: at line %d ", line);
+  emit(stdout, "WARNING: at line %d ", line);
 
   va_list args;
   va_start(args, fmsg);
@@ -73,16 +119,16 @@ void error(char const * const msg) {
 }
 
 void log(char const * const msg) {
-  fprintf(stdout, "%s\n", msg);
+  emit(stdout, "%s\n", msg);
 }
 
 void error_token(const Token& token, char const*const msg) {
   token.print();
   if (token.type == TokenType::END) {
-    report(token.line, "at end", msg);
+    report(token.line(), "at end", msg);
   }
   else {
-    reportf_where(token.line, msg, "at %s", token.lexeme);
+    reportf_where(token.line(), msg, "at %.*s", (int)token.lexeme.size, token.lexeme.data);
   }
 }
 
@@ -96,10 +142,10 @@ void error_tokenf(const Token& token, char const*const fmsg, ...) {
 
   token.print();
   if (token.type == TokenType::END) {
-    reportf(token.line, "at end", formatted);
+    reportf(token.line(), "at end", formatted);
   }
   else {
-    reportf_where(token.line, formatted, "at %s", token.lexeme);
+    reportf_where(token.line(), formatted, "at %.*s", (int)token.lexeme.size, token.lexeme.data);
   }
 }
 
@@ -111,5 +157,5 @@ void report_info(char const * const format, ...) {
   vsnprintf(formatted_msg, sizeof(formatted_msg), format, args);
   va_end(args);
 
-  fprintf(stderr, "Info:  %s\n", formatted_msg);
+  emit(stderr, "Info:  %s\n", formatted_msg);
 }
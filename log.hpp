@@ -1,6 +1,7 @@
 #pragma once
 
 #include "token.hpp"
+#include "template.hpp"
 #include <cstdarg>
 #include <cstdio>
 
@@ -23,3 +24,39 @@ void error(char const * const msg);
 
 void log(char const * const msg);
 
+// what a thread reports while it works on part of a compilation, kept here instead of going to the terminal so the
+// parts can be written out in source order once they are all done
+struct Diagnostic_Buffer {
+  struct Entry {
+    bool to_stderr;
+    u32 begin;  // range in text
+    u32 end;
+  };
+
+  DArray<char> text;
+  DArray<Entry> entries;
+
+  size_t count() const { return entries.size; }
+
+  void free() {
+    text.free();
+    entries.free();
+  }
+};
+
+// what one piece of work reported, the entries [first, end) of a buffer
+struct Task_Diagnostics {
+  const Diagnostic_Buffer* buffer;
+  size_t first;
+  size_t end;
+};
+
+// everything reported from this thread goes into the buffer until it is called with NULL
+void capture_diagnostics(Diagnostic_Buffer* buffer);
+
+// writes the entries [first, end) where they would have gone
+void write_diagnostics(const Diagnostic_Buffer* buffer, size_t first, size_t end);
+
+// how many messages were reported so far, from every thread and captured or not
+size_t diagnostics_reported();
+
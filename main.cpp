@@ -8,6 +8,7 @@
 #include "graph.hpp"
 #include "stmt.hpp"
 #include "parser.hpp"
+#include "ast.hpp"
 #include "lexer.hpp"
 #include "token.hpp"
 #include "common.hpp"
@@ -17,6 +18,8 @@
 #include "typechecker.hpp"
 #include "ir.hpp"
 #include "c_emitter.hpp"
+#include "ast_cache.hpp"
+#include "check_cache.hpp"
 #include "bytecode.hpp"
 #include "bytecode_emitter.hpp"
 
@@ -35,6 +38,12 @@ struct Options {
 
   bool test_bytecode = false;
   bool test_name_resolution = false;
+  bool test_dependencies = false;  // dump the dependency graph of the declarations
+  bool full_check = false;  // parse and check every procedure body, not only the ones reachable from main
+  bool hash_consing = false;  // identical pure expressions share one node of the ast
+
+  int threads = 1;  // worker threads for the parts of the pipeline that can use them
+  const char* cache_dir = NULL;  // parsed files are cached here, keyed by the hash of their source, and the typecheck results of their procedures
 };
 
 struct File {
@@ -64,6 +73,9 @@ static int active_options(Options ops) {
   if (ops.parse_only) count++;
   if (ops.print_ast) count++;
   if (ops.test_bytecode) count++;
+  if (ops.test_dependencies) count++;
+  if (ops.full_check) count++;
+  if (ops.hash_consing) count++;
 
   return count;
 }
@@ -84,20 +96,28 @@ void print_configuration(Options ops, Context ctx) {
   if (ops.parse_only) printf("parse_only\n");
   if (ops.print_ast) printf("print_ast\n");
   if (ops.test_bytecode) printf("test_bytecode\n");
+  if (ops.test_dependencies) printf("test_dependencies\n");
+  if (ops.full_check) printf("full_check\n");
+  if (ops.hash_consing) printf("hash_consing\n");
+  if (ops.threads > 1) printf("threads: %d\n", ops.threads);
+  if (ops.cache_dir) printf("cache_dir: %s\n", ops.cache_dir);
   printf("\n");
 }
 
-void compile(String source, const Options* options, const Context* context);
+void compile(String source, const Options* options, const Context* context, bool use_cache, Check_Cache* checks);
 static bool command_line_argument(char* arg, Options* options);
 static DArray<char*> command_line_arguments(int arg_count, char** args, Options* options, Context* context);
 
+// typecheck results of the procedures of earlier lines, or of earlier runs when there is a cache directory
+static Check_Cache check_cache;
+
 bool prompt_iteration(const Options* options, Context* context) {
   // @todo more sophisticated repl, integrate with gnu readline maybe
   printf("> ");
   auto input = take_input();
   input.trim('\n');
   if (input.equals("q") || input.equals("quit")) return false;
-  compile(input, options, context);
+  compile(input, options, context, false, &check_cache);
   return true;
 }
 
@@ -114,16 +134,10 @@ void run_prompt(const Options* options, Context* context) {
   printf("\nBye\n");
 }
 
-size_t filelen(FILE* file) {
-  long position = ftell(file);
-  fseek(file, 0, SEEK_END);
-  long filelen = ftell(file);
-  fseek(file, 0, position);
-  return filelen;
-}
-
+// `-` as a path reads the source from stdin
 void handle_file(char* path, Options* options, Context* context) {
-  FILE* file = fopen(path, "rb");
+  bool from_stdin = compare_string(String(path), String("-"));
+  FILE* file = from_stdin ? stdin : fopen(path, "rb");
 
   if (!file) {
     fprintf(stderr, "Couldn't open file: %s\n", path);
@@ -132,107 +146,187 @@ void handle_file(char* path, Options* options, Context* context) {
 
   context->files.add(File{ .handle = file, .name = path, .has_main = false });
 
-  size_t flen = filelen(file);
-  Mutable_String content = Mutable_String(flen);
-  size_t read = fread(content.data, 1, flen, file);
-  content.size = read;
+  Source_File source_file;
+  bool loaded = load_source_file(file, &source_file);
+  if (!from_stdin) fclose(file);
 
-  if (read != flen) {
-    fprintf(stderr, "Couldn't read the entire file %s  %zu out of %zu\n", path, read, flen);
+  if (!loaded) {
+    fprintf(stderr, "Couldn't read file %s\n", path);
     return;
   }
 
-  fclose(file);
-
   options->parse_expr = false;
-  compile(String(content.data, content.size), options, context);
+  bool use_cache = options->cache_dir != NULL;
+  compile(source_file.content, options, context, use_cache, use_cache ? &check_cache : NULL);
+
+  unload_source_file(&source_file);
 }
 
-ArrayView<Stmt*> frontend(bool *continue_compilation, String source, Options options, Context context) {
-  ArrayView<Stmt*> statements = ArrayView<Stmt*>(NULL, 0);
+// unless everything is checked or printed the bodies of top level procedures are only parsed if they are used
+static bool lazy_bodies_enabled(const Options& options) {
+  return !options.full_check && !options.parse_expr && !options.parse_only && !options.print_ast && !options.test_name_resolution;
+}
 
+// fills the ast, returns false if the compilation shouldn't go on
+bool frontend(Ast* ast, String source, Options options, Context context, Linear_Allocator* arena) {
   bool error = false;
-  ArrayView<Token> tokens = lex(source, &error);
-  if (options.dump_lexer_output) {
-    printf("Collected %zu tokens\n", tokens.count);
-    for (const Token& token : tokens) {
-      token.print();
+  set_line_source(source);
+
+  bool lazy_bodies = lazy_bodies_enabled(options);  // needs the tokens for later
+
+  // batch lexing is only needed to look at the tokens themselves, to lex on multiple threads or for lazy bodies,
+  // otherwise the parser pulls them from the lexer as it goes
+  Token_Buffer tokens;
+  bool batch = options.dump_lexer_output || options.lexer_only || options.threads > 1 || lazy_bodies;
+  if (batch) {
+    tokens = (options.threads > 1) ? lex_parallel(source, &error, (size_t)options.threads) : lex(source, &error);
+    if (options.dump_lexer_output) {
+      printf("Collected %zu tokens\n", tokens.count());
+      for (size_t i = 0; i < tokens.count(); i++) {
+        tokens.get(i).print();
+      }
     }
-  }
 
-  if (error) {
-    *continue_compilation = false;
-    return statements;
-  }
-  if (options.lexer_only) {
-    *continue_compilation = false;
-    return statements;
+    if (error || options.lexer_only) {
+      tokens.free();
+      return false;
+    }
   }
 
-  Parser parser = Parser(tokens);
+  Parser parser = batch ? Parser(&tokens, ast, arena) : Parser(source, ast, arena);
 
   if (options.parse_expr) {
-    Expr* expr = parser.parse_expression();
-    print_expr(expr);
+    Expr_ID expr = parser.parse_expression();
+    print_expr(ast, expr);
     printf("\n");
 
     if (options.generate_dot_file) {
-      if (!expression_tree_to_dot(expr, context.dot_file_name)) {
+      if (!expression_tree_to_dot(ast, expr, context.dot_file_name)) {
         printf("Failed to generate dot file\n");
       }
     }
 
-    *continue_compilation = false;
-    return statements;
+    if (batch) tokens.free();
+    return false;
+  }
+
+  if (options.threads > 1) {
+    parse_parallel(&tokens, ast, arena, (size_t)options.threads, lazy_bodies, &error);
+  }
+  else {
+    parser.lazy_bodies = lazy_bodies;
+    parser.parse(&error);
+    if (parser.tokens.had_error) error = true;
   }
 
-  statements = parser.parse(&error);
+  if (lazy_bodies) {
+    ast->tokens = arena_new<Token_Buffer>(arena, tokens);  // freed with the ast
+    ast->arena = arena;
+  }
+  else if (batch) {
+    tokens.free();  // the tree only keeps slices of the source
+  }
 
-  if (options.print_ast) {
-    print_ast(statements);
+  if (options.verbose) {
+    printf("Ast has %zu nodes in %zu bytes\n", ast->node_count(), ast->memory_used());
+    if (ast->hash_consing) printf("%zu expressions use a node that was already there\n", ast->cons_table.shared);
   }
 
-  if (error) {
-    *continue_compilation = false;
-    return statements;
+  if (options.print_ast) {
+    print_ast(ast);
   }
-  if (options.parse_only) {
-    *continue_compilation = false;
-    return statements;
+
+  if (error || options.parse_only) {
+    return false;
   }
 
-  return statements;
+  return true;
 }
 
-void compile(const String source, const Options* options, const Context* context) {
-  bool continue_compilation = true;
-  auto statements = frontend(&continue_compilation, source, *options, *context);
+// scratch space of the parser and the environments of a compilation, all of it is released together when it is done
+static const size_t COMPILATION_ARENA_CHUNK_SIZE = 1024 * 1024;
+static Linear_Allocator compilation_arena = make_allocator(COMPILATION_ARENA_CHUNK_SIZE);
+
+static void compile_source(Ast* ast, const String source, const Options* options, const Context* context, Linear_Allocator* arena,
+                           bool use_cache, Check_Cache* checks) {
+  // the modes that look at the tokens or the tree as they are made always run the frontend
+  use_cache = use_cache && !options->dump_lexer_output && !options->lexer_only && !options->parse_only &&
+              !options->print_ast && !options->parse_expr;
+
+  bool lazy_bodies = lazy_bodies_enabled(*options);
+  u64 source_hash = use_cache ? hash_bytes(source.data, source.size) : 0;
 
-  Resolver resolver = Resolver(statements);
-  ArrayView<Environment> declarations = resolver.resolve();
+  if (use_cache && load_cached_ast(ast, source, source_hash, options->cache_dir, lazy_bodies, arena)) {
+    set_line_source(source);
+
+    if (options->verbose) {
+      printf("Loaded the ast from the cache, %zu nodes in %zu bytes\n", ast->node_count(), ast->memory_used());
+    }
+  }
+  else {
+    // an entry doesn't have what the lexer and parser reported, a source with warnings is not stored so they show every time
+    size_t reported = diagnostics_reported();
+    if (!frontend(ast, source, *options, *context, arena)) return;
+    if (use_cache && diagnostics_reported() == reported) store_cached_ast(ast, source, source_hash, options->cache_dir, lazy_bodies);
+  }
+
+  Resolver resolver = Resolver(ast, arena);
+  resolver.thread_count = (size_t)options->threads;
+  const Scope_Table* declarations = resolver.resolve();
+  if (resolver.had_parse_error) return;
 
   if (options->test_name_resolution) {
     resolver.dump_environments();
     return;
   }
 
-  Typechecker typechecker = Typechecker(declarations);
-  bool typecheck_result = typechecker.typecheck(statements, declarations);
+  if (options->test_dependencies) {
+    resolver.dependencies.dump(declarations);
+    return;
+  }
+
+  Typechecker typechecker = Typechecker(ast, declarations, &resolver.dependencies);
+  typechecker.check_unreachable = options->full_check;
+  typechecker.thread_count = (size_t)options->threads;
+
+  if (checks && use_cache && !checks->loaded) {
+    load_check_cache(checks, options->cache_dir);
+    checks->loaded = true;  // tried, the file is only read once
+  }
+  typechecker.checks = checks;
+  typechecker.source = source;
+
+  bool typecheck_result = typechecker.typecheck(ast->program);
+
+  if (checks) {
+    if (options->verbose) printf("%zu procedures checked, %zu had a result from before\n", checks->checked, checks->reused);
+    if (use_cache) store_check_cache(checks, options->cache_dir);
+  }
 
   if (!typecheck_result)
     return;
 
   // @todo
-  //semantic_analysis(statements, declarations);
+  //semantic_analysis(ast, declarations);
 
   if (options->c_output) {
-    output_c_code(statements, declarations, context->output_file);
+    output_c_code(ast, declarations, &resolver.dependencies, context->output_file);
     return;
   }
 
   // @todo ir -> bytecode -> run bytecode, backend codegen
 }
 
+void compile(const String source, const Options* options, const Context* context, bool use_cache, Check_Cache* checks) {
+  Ast ast;
+  ast.hash_consing = options->hash_consing;
+  compile_source(&ast, source, options, context, &compilation_arena, use_cache, checks);
+
+  // the chunks are kept for the next compilation (the next line in the repl)
+  ast.free();
+  reset_allocator(&compilation_arena);
+}
+
 int main(int argc, char** argv) {
   Options options;
   Context context;
@@ -285,6 +379,7 @@ int main(int argc, char** argv) {
 static void usage() {
   printf("compiler usage:\n");
   printf("<compiler> [options] filename\n");
+  printf("  (- as the filename reads from stdin)\n");
 
   printf("options: \n");
   printf("  --help\n");
@@ -293,6 +388,10 @@ static void usage() {
   printf("  -c-output\n");
   printf("  -stdout\n");
   printf("  -generate-dot-file\n");
+  printf("  -threads <count>\n");
+  printf("  -full-check\n");
+  printf("  -hash-cons\n");
+  printf("  -cache-dir <directory>\n");
 
   printf("\n");
   printf("  -dump-lexer-output\n");
@@ -305,6 +404,7 @@ static void usage() {
   printf("  -test-bytecode\n");
   printf("  -test-typecheck\n");
   printf("  -test-name-resolution\n");
+  printf("  -test-dependencies\n");
   exit(1);
 }
 
@@ -343,6 +443,8 @@ static DArray<char*> command_line_arguments(int arg_count, char** args, Options*
       options->verbose = true;
     } else if (compare_string(argument, String("-test-name-resolution"))) {
       options->test_name_resolution = true;
+    } else if (compare_string(argument, String("-test-dependencies"))) {
+      options->test_dependencies = true;
     } else if (compare_string(argument,   String("-ast"))) {
       options->print_ast = true;
     } else if (compare_string(argument,   String("-lexer-only"))) {
@@ -355,6 +457,10 @@ static DArray<char*> command_line_arguments(int arg_count, char** args, Options*
       options->parse_only = true;
     } else if (compare_string(argument,   String("-c-output"))) {
       options->c_output = true;
+    } else if (compare_string(argument,   String("-full-check"))) {
+      options->full_check = true;
+    } else if (compare_string(argument,   String("-hash-cons"))) {
+      options->hash_consing = true;
     } else if (compare_string(argument,   String("-generate-dot-file"))) {
       if (i + 1 >= arg_count) {  // if we are at the end we couldn't find the file name as expected
         fprintf(stderr, "Usage Error: Expected filename after -generate-dot-file as an argument\n");
@@ -366,6 +472,29 @@ static DArray<char*> command_line_arguments(int arg_count, char** args, Options*
       context->dot_file_name = filename;
 
       options->generate_dot_file = true;
+    } else if (compare_string(argument,   String("-threads"))) {
+      if (i + 1 >= arg_count) {
+        fprintf(stderr, "Usage Error: Expected thread count after -threads as an argument\n");
+        continue;
+      }
+
+      ++i;
+      char* end;
+      long count = strtol(args[i], &end, 10);
+      if (*end != '\0' || count < 1 || count > 256) {
+        fprintf(stderr, "Usage Error: Invalid thread count %s, expected a number between 1 and 256\n", args[i]);
+        continue;
+      }
+
+      options->threads = (int)count;
+    } else if (compare_string(argument,   String("-cache-dir"))) {
+      if (i + 1 >= arg_count) {
+        fprintf(stderr, "Usage Error: Expected directory after -cache-dir as an argument\n");
+        continue;
+      }
+
+      ++i;
+      options->cache_dir = args[i];
     } else {
       filenames.add(arg);
     }
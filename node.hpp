@@ -0,0 +1,47 @@
+#pragma once
+
+#include "common.hpp"
+
+// ids of the nodes of the syntax tree.
+// the highest 4 bits are the kind of the node (ExprType or StmtKind), the rest is the index in the pool of that kind
+typedef u32 Expr_ID;
+typedef u32 Stmt_ID;
+
+static const u32 NODE_KIND_SHIFT = 28;
+static const u32 NODE_KIND_COUNT = 1u << (32 - NODE_KIND_SHIFT);
+static const u32 NODE_INDEX_MASK = (1u << NODE_KIND_SHIFT) - 1;
+
+static const Expr_ID EXPR_NONE = 0xFFFFFFFF;
+static const Stmt_ID STMT_NONE = 0xFFFFFFFF;
+
+inline u32 make_node_id(u32 kind, u32 index) {
+  if (index > NODE_INDEX_MASK) {
+    panic_and_abort("Too many syntax tree nodes of one kind");
+  }
+
+  return (kind << NODE_KIND_SHIFT) | index;
+}
+
+inline u32 node_kind(u32 id) {
+  return id >> NODE_KIND_SHIFT;
+}
+
+inline u32 node_index(u32 id) {
+  return id & NODE_INDEX_MASK;
+}
+
+// child lists are ranges in one of the shared lists of the ast
+struct Expr_List {
+  u32 first = 0;
+  u32 count = 0;
+};
+
+struct Stmt_List {
+  u32 first = 0;
+  u32 count = 0;
+};
+
+struct Decl_List {
+  u32 first = 0;
+  u32 count = 0;
+};
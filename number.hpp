@@ -0,0 +1,73 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <climits>
+
+// numeric literal parsing straight from the source slice, the lexer has already checked the shape:
+// integers are [0-9]+ and reals are [0-9]+ '.' [0-9]*, so there are no signs or exponents to deal with.
+
+// returns false if the value doesn't fit in a long, result is clamped to LONG_MAX then
+static inline bool parse_integer_literal(const char* digits, size_t length, long* result) {
+  u64 value = 0;
+  for (size_t i = 0; i < length; i++) {
+    u64 digit = (u64)(digits[i] - '0');
+    if (value > ((u64)LONG_MAX - digit) / 10) {
+      *result = LONG_MAX;
+      return false;
+    }
+    value = value * 10 + digit;
+  }
+
+  *result = (long)value;
+  return true;
+}
+
+// every power of ten up to 1e22 is exactly representable in a double
+static const double exact_powers_of_ten[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// correctly rounded, the common case is Clinger's fast path: when the digits fit exactly in the 53 bit mantissa
+// and the scale is an exactly representable power of ten, a single ieee division rounds correctly.
+// anything else goes through strtod on a null terminated copy on the stack.
+static inline double parse_real_literal(const char* text, size_t length) {
+  u64 mantissa = 0;
+  int significant_digits = 0;
+  int fraction_digits = 0;
+  bool in_fraction = false;
+
+  for (size_t i = 0; i < length; i++) {
+    char c = text[i];
+    if (c == '.') {
+      in_fraction = true;
+      continue;
+    }
+
+    if (in_fraction) fraction_digits++;
+    if (mantissa == 0 && c == '0') continue;  // leading zeros don't take up precision
+
+    significant_digits++;
+    if (significant_digits <= 19) mantissa = mantissa * 10 + (u64)(c - '0');
+  }
+
+  if (significant_digits <= 19 && mantissa <= ((u64)1 << 53) && fraction_digits < (int)ARRAY_SIZE(exact_powers_of_ten)) {
+    return (double)mantissa / exact_powers_of_ten[fraction_digits];
+  }
+
+  char buffer[512];
+  if (length >= sizeof(buffer)) {
+    // absurdly long literal, this is the only case that allocates
+    char* copy = (char*)malloc_or_die(length + 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    double result = strtod(copy, NULL);
+    free(copy);
+    return result;
+  }
+
+  memcpy(buffer, text, length);
+  buffer[length] = '\0';
+  return strtod(buffer, NULL);
+}
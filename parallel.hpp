@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#include "common.hpp"
+#include "log.hpp"
+
+// fewer tasks than this are not worth the threads
+static const size_t PARALLEL_MIN_TASKS = 64;
+
+// runs task(worker, index) for every index below task_count on thread_count threads (worker is the index of the
+// thread, 0 is the calling one). a thread takes the next task as soon as it is done with one, so a few big
+// procedures don't hold up the others.
+// what the tasks report is kept per thread and written out in task order at the end, merge(index, worker, diagnostics)
+// is called in that order too, right after the diagnostics of its task are written, for everything else that has to
+// come out as it would without threads
+template <typename Task, typename Merge>
+void run_tasks(size_t task_count, size_t thread_count, Task task, Merge merge) {
+  struct Task_Output {
+    size_t worker;
+    size_t first_diagnostic;
+    size_t end_diagnostic;
+  };
+
+  if (thread_count > task_count) thread_count = task_count;
+  if (thread_count < 1) thread_count = 1;
+
+  build_source_lines();
+
+  // on one thread every task is written out and merged as soon as it is done, like it would be without tasks (a
+  // panic in a later task doesn't take what the earlier ones reported with it)
+  if (thread_count == 1) {
+    Diagnostic_Buffer buffer;
+    for (size_t i = 0; i < task_count; i++) {
+      size_t first = buffer.count();
+      capture_diagnostics(&buffer);
+      task(0, i);
+      capture_diagnostics(NULL);
+
+      Task_Diagnostics diagnostics = { &buffer, first, buffer.count() };
+      write_diagnostics(diagnostics.buffer, diagnostics.first, diagnostics.end);
+      merge(i, 0, diagnostics);
+    }
+
+    buffer.free();
+    return;
+  }
+
+  Diagnostic_Buffer* buffers = new Diagnostic_Buffer[thread_count];
+  Task_Output* outputs = new Task_Output[task_count];
+  std::atomic<size_t> next_task(0);
+
+  auto work = [&](size_t worker) {
+    Diagnostic_Buffer* buffer = &buffers[worker];
+    capture_diagnostics(buffer);
+
+    while (true) {
+      size_t index = next_task.fetch_add(1, std::memory_order_relaxed);
+      if (index >= task_count) break;
+
+      outputs[index].worker = worker;
+      outputs[index].first_diagnostic = buffer->count();
+      task(worker, index);
+      outputs[index].end_diagnostic = buffer->count();
+    }
+
+    capture_diagnostics(NULL);
+  };
+
+  std::thread* workers = new std::thread[thread_count - 1];
+  for (size_t i = 1; i < thread_count; i++) {
+    workers[i - 1] = std::thread(work, i);
+  }
+  work(0);
+  for (size_t i = 0; i < thread_count - 1; i++) {
+    workers[i].join();
+  }
+  delete[] workers;
+
+  for (size_t i = 0; i < task_count; i++) {
+    const Task_Output& output = outputs[i];
+    Task_Diagnostics diagnostics = { &buffers[output.worker], output.first_diagnostic, output.end_diagnostic };
+    write_diagnostics(diagnostics.buffer, diagnostics.first, diagnostics.end);
+    merge(i, output.worker, diagnostics);
+  }
+
+  for (size_t i = 0; i < thread_count; i++) {
+    buffers[i].free();
+  }
+  delete[] buffers;
+  delete[] outputs;
+}
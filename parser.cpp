@@ -6,21 +6,40 @@
 #include "log.hpp"
 #include "expr.hpp"
 
-Parser::Parser(ArrayView<Token> tokens) : tokens(tokens) {}
-
-ArrayView<Stmt*> Parser::parse(bool* error) {
-    DArray<Stmt*> statements;
-    while (current < tokens.count) {
-        Token curr_token = tokens.get(current);
-        if (curr_token.type == TokenType::END) break;
-
-        Stmt* statement = parse_statement();
-        if (!statement) {
+Parser::Parser(const Token_Buffer* buffer, Ast* ast, Linear_Allocator* arena)
+    : tokens(buffer), ast(ast), arena(arena), expr_scratch(arena), stmt_scratch(arena), decl_scratch(arena) {}
+Parser::Parser(String source, Ast* ast, Linear_Allocator* arena)
+    : tokens(source), ast(ast), arena(arena), expr_scratch(arena), stmt_scratch(arena), decl_scratch(arena) {}
+
+void Parser::parse_statements(size_t end) {
+    while (current < end && tokens.in_range(current)) {
+        if (tokens.type(current) == TokenType::END) break;
+        if (quiet && had_diagnostic) break;  // the parse is going to be redone anyway
+
+        Stmt_ID statement = parse_statement();
+        if (statement == STMT_NONE) {
             continue;
         }
 
-        statements.add(statement);
+        stmt_scratch.add(statement);
     }
+}
+
+bool Parser::report() {
+    had_diagnostic = true;
+    return !quiet;
+}
+
+// the statements pushed since base become a list of the ast
+Stmt_List Parser::finish_statements(size_t base) {
+    Stmt_List list = ast->add_stmt_list(stmt_scratch.data + base, stmt_scratch.size - base);
+    stmt_scratch.size = base;
+    return list;
+}
+
+Stmt_List Parser::parse(bool* error) {
+    size_t base = stmt_scratch.size;
+    parse_statements(SIZE_MAX);
 
     if (current_scope_depth < 0)
         parse_error("Mismatched parenthesis you need to add %d more {", abs(current_scope_depth));
@@ -28,7 +47,8 @@ ArrayView<Stmt*> Parser::parse(bool* error) {
         parse_error("Mismatched parenthesis you need to add %d more }", abs(current_scope_depth));
 
     *error = had_parse_error;
-    return ArrayView<Stmt*>(statements.data, statements.size);
+    ast->program = finish_statements(base);
+    return ast->program;
 }
 
 static bool starts_statement(const TokenType type) {
@@ -48,8 +68,8 @@ static bool starts_statement(const TokenType type) {
     }
 }
 
-Stmt* Parser::parse_statement() {
-    switch (tokens.get(current).type) {
+Stmt_ID Parser::parse_statement() {
+    switch (tokens.type(current)) {
         case TokenType::IF: {
             return if_stmt();
         }
@@ -77,16 +97,16 @@ Stmt* Parser::parse_statement() {
         case TokenType::SEMICOLON:  // this is to allow empty statements
             // @todo @fixme warn
             advance();
-            return NULL;
+            return STMT_NONE;
         default: {
-            Expr_Stmt* expression_stmt = expr_stmt();
-            if (expression_stmt) return expression_stmt;
+            Stmt_ID expression_stmt = expr_stmt();
+            if (expression_stmt != STMT_NONE) return expression_stmt;
 
-            error(tokens.get(current), "Expected statement");
-            while (current < tokens.count) {
-                auto type = tokens.get(current).type;
+            if (report()) error(tokens.get(current), "Expected statement");
+            while (tokens.in_range(current)) {
+                auto type = tokens.type(current);
                 if (starts_statement(type) || type == TokenType::END) {
-                    return NULL;
+                    return STMT_NONE;
                 }
                 advance();  // this is so that we don't issue more than one expected statement errors sequentially
             }
@@ -96,67 +116,69 @@ Stmt* Parser::parse_statement() {
     }
 }
 
-// @xxx there is a lot of dynamic array usage here. if we could replace those use cases with non-dynamic allocation versions we would be happy
-// @fixme @fixme we are leaking memory
-
 // { statements* }
-Block_Stmt* Parser::block_stmt() {
+Stmt_ID Parser::block_stmt() {
     advance();  // {
 
-    DArray<Stmt*> statements;
-    while (tokens.get(current).type != TokenType::END && tokens.get(current).type != TokenType::BRACE_RIGHT) {
-        Stmt* stmt = parse_statement();
-        if (!stmt) return NULL;
-        statements.add(stmt);
+    size_t base = stmt_scratch.size;
+    while (tokens.type(current) != TokenType::END && tokens.type(current) != TokenType::BRACE_RIGHT) {
+        Stmt_ID stmt = parse_statement();
+        if (stmt == STMT_NONE) {
+            stmt_scratch.size = base;
+            return STMT_NONE;
+        }
+        stmt_scratch.add(stmt);
     }
 
     // the only way the condition here is true is that the current token is the end
     if (!eat_token(TokenType::BRACE_RIGHT, "Expected `}` at the end of block statement")) {
-        return NULL;
+        stmt_scratch.size = base;
+        return STMT_NONE;
     }
 
-    return new Block_Stmt(statements.data, statements.size);
+    Block_Stmt block;
+    block.body = finish_statements(base);
+    return ast->add(block);
 }
 
 // if cond-expr then_stmt else else_stmt?
-If_Stmt* Parser::if_stmt() {
-    If_Stmt* stmt = new If_Stmt;
+Stmt_ID Parser::if_stmt() {
+    If_Stmt stmt;
 
     advance(); // if token
 
-    stmt->cond = parse_expression();
-    if (!stmt->cond) return NULL;
+    stmt.cond = parse_expression();
+    if (stmt.cond == EXPR_NONE) return STMT_NONE;
 
-    stmt->then_stmt = parse_statement();
-    if (!stmt->then_stmt) return NULL;
+    stmt.then_stmt = parse_statement();
+    if (stmt.then_stmt == STMT_NONE) return STMT_NONE;
 
-    if (tokens.get(current).type == TokenType::ELSE) {
+    if (tokens.type(current) == TokenType::ELSE) {
         advance();
-        stmt->else_stmt = parse_statement();
-        if (!stmt->else_stmt) return NULL;
+        stmt.else_stmt = parse_statement();
+        if (stmt.else_stmt == STMT_NONE) return STMT_NONE;
     }
 
-    return stmt;
+    return ast->add(stmt);
 }
 
 // for init_expr ; cond_expr ; end_expr loop_body
-For_Stmt* Parser::for_stmt() {
-    For_Stmt* stmt = new For_Stmt;
+Stmt_ID Parser::for_stmt() {
+    For_Stmt stmt;
 
     advance();  // for token
-    auto line = tokens.get(current).line;
 
-    stmt->condition = parse_expression();
-    if (!stmt->condition) return NULL;
-    if (!eat_token(TokenType::SEMICOLON, "Expected semicolon after the condition of the for loop")) return NULL;
+    stmt.condition = parse_expression();
+    if (stmt.condition == EXPR_NONE) return STMT_NONE;
+    if (!eat_token(TokenType::SEMICOLON, "Expected semicolon after the condition of the for loop")) return STMT_NONE;
 
-    stmt->body = parse_statement();
-    if (!stmt->body) return NULL;
+    stmt.body = parse_statement();
+    if (stmt.body == STMT_NONE) return STMT_NONE;
 
-    return stmt;
+    return ast->add(stmt);
 }
 
-Stmt* Parser::parse_after_identifier() {
+Stmt_ID Parser::parse_after_identifier() {
     Token current_token = tokens.get(current);
     assert(current_token.type == TokenType::IDENTIFIER);
 
@@ -174,101 +196,104 @@ Stmt* Parser::parse_after_identifier() {
             sb.append(" for a valid statement but found ");
             sb.append(token.lexeme);
             sb.append(" instead");
-            error_tokenf(token, sb.c_string());
+            if (report()) error_tokenf(token, sb.c_string());
 
             advance();
-            if (current + 1 >= tokens.count) return NULL;
+            if (!tokens.in_range(current + 1)) return STMT_NONE;
 
             auto next_token_type = peek().type;
             if (token.type == TokenType::COLON && (next_token_type == TokenType::IDENTIFIER || is_basic_type(next_token_type))) {
-                report_info("Maybe this is intended to be a variable declaration but missing var keyword at the beginning (var a : int = 10;)");
+                if (report()) report_info("Maybe this is intended to be a variable declaration but missing var keyword at the beginning (var a : int = 10;)");
                 advance(); advance();
             }
 
-            return NULL;
+            return STMT_NONE;
         }
     }
 }
 
 // identifier = expr;
-Assign_Stmt* Parser::assign_stmt() {
-    Assign_Stmt* stmt = new Assign_Stmt;
+Stmt_ID Parser::assign_stmt() {
+    Assign_Stmt stmt;
 
-    stmt->target = tokens.get(current);
+    stmt.target = tokens.symbol(current);
+    stmt.offset = (int)tokens.offset(current);
     advance();
 
     if (!eat_token(TokenType::EQUAL, "Expected `=` after identifier in assignment")) {
         skip_past(TokenType::SEMICOLON);
-        return NULL;
+        return STMT_NONE;
     }
 
-    stmt->rhs = parse_expression();
-    if (!stmt->rhs) {
+    stmt.rhs = parse_expression();
+    if (stmt.rhs == EXPR_NONE) {
         skip_past(TokenType::SEMICOLON);
-        return NULL;
+        return STMT_NONE;
     }
 
-    return stmt;
+    return ast->add(stmt);
 }
 
 // var identifier : type (= initializer);
-Decl_Var_Stmt* Parser::decl_var_stmt() {
+Stmt_ID Parser::decl_var_stmt() {
     advance();  // var keyword
 
     Decl_Var var_decl;
 
     // name : type
 
-    Token name = tokens.get(current);
-    if (name.type != TokenType::IDENTIFIER) {
+    if (tokens.type(current) != TokenType::IDENTIFIER) {
         parse_error("Expected variable name after `var` keyword in variable declaration");
-        return NULL;
+        return STMT_NONE;
     }
+    Symbol name = tokens.symbol(current);
+    int name_offset = (int)tokens.offset(current);
 
     advance();
 
-    if (tokens.get(current).type != TokenType::COLON) {
+    if (tokens.type(current) != TokenType::COLON) {
         parse_error("Expected `:` after variable name in variable declaration");
-        return NULL;
+        return STMT_NONE;
     }
     advance();  // :
 
-    Token type_ident = tokens.get(current);
+    TokenType type_ident = tokens.type(current);
     advance();
 
-    if (is_basic_type(type_ident.type) || type_ident.type == TokenType::IDENTIFIER) {
+    if (is_basic_type(type_ident) || type_ident == TokenType::IDENTIFIER) {
         var_decl.name = name;
-        var_decl.type = get_basic_type(type_ident.type);
+        var_decl.offset = name_offset;
+        var_decl.type = get_basic_type(type_ident);
     } else {
         parse_error("Expected type name after `:` in variable declaration");
-        return NULL;
+        return STMT_NONE;
     }
 
     // @todo type inference
 
-    Expr* initializer = NULL;
-    if (tokens.get(current).type == TokenType::EQUAL) {
+    Expr_ID initializer = EXPR_NONE;
+    if (tokens.type(current) == TokenType::EQUAL) {
         advance();
 
         initializer = parse_expression();
-        if (!initializer) {
+        if (initializer == EXPR_NONE) {
             skip_past(TokenType::SEMICOLON);
-            return NULL;
+            return STMT_NONE;
         }
     }
 
     if (!eat_token(TokenType::SEMICOLON, "Expected `;` at the end of variable declaration")) {
-        return NULL;
+        return STMT_NONE;
     }
 
-    Decl_Var_Stmt* stmt = new Decl_Var_Stmt;
-    stmt->decl        = var_decl;
-    stmt->initializer = initializer;
-    return stmt;
+    Decl_Var_Stmt stmt;
+    stmt.decl        = var_decl;
+    stmt.initializer = initializer;
+    return ast->add(stmt);
 }
 
 void Parser::skip_to_global_scope() {
-    while (tokens.get(current).type != TokenType::END && current_scope_depth != 0) {
+    while (tokens.type(current) != TokenType::END && current_scope_depth != 0) {
         advance();
     }
 
@@ -286,497 +311,497 @@ void Parser::skip_to_global_scope() {
 // params -> (identifier(,identifier))
 // or
 // proc name { body }
-Decl_Proc_Stmt* Parser::decl_proc_stmt() {
-    auto good = true;
-
+Stmt_ID Parser::decl_proc_stmt() {
     advance();  // proc keyword
 
-    if (!(tokens.get(current).type == TokenType::IDENTIFIER)) {
+    if (!(tokens.type(current) == TokenType::IDENTIFIER)) {
         parse_error("Expected function name after func keyword");
-        return NULL;
+        return STMT_NONE;
     }
 
     Token name = tokens.get(current);
     advance();
 
-    ArrayView<Decl_Var> parameters = ArrayView<Decl_Var>(NULL, 0);
-
-    Token after_ident = tokens.get(current);
+    TokenType after_ident = tokens.type(current);
 
-    if (after_ident.type != TokenType::PAREN_LEFT && after_ident.type != TokenType::BRACE_LEFT) {
+    if (after_ident != TokenType::PAREN_LEFT && after_ident != TokenType::BRACE_LEFT) {
         skip_to_global_scope();
-        return NULL;
+        return STMT_NONE;
     }
 
     char proc_name[1024];
     null_terminate(name.lexeme, proc_name);
 
-    if (after_ident.type == TokenType::PAREN_LEFT) {
+    // the parameters and then the returns are collected on top of each other
+    size_t decl_base = decl_scratch.size;
+    size_t parameter_count = 0;
+
+    if (after_ident == TokenType::PAREN_LEFT) {
         advance();  // (
-        DArray<Decl_Var> params;  // @fixme memory leak on some control paths
 
         Decl_Var param;
 
         do {
-            if (tokens.get(current).type == TokenType::PAREN_RIGHT) {
+            if (tokens.type(current) == TokenType::PAREN_RIGHT) {
                 break;
             }
 
-            if (tokens.get(current).type != TokenType::IDENTIFIER) {
+            if (tokens.type(current) != TokenType::IDENTIFIER) {
                 parse_error("Expected parameter name in parameter list of the procedure declaration for %s", proc_name);
                 skip_to_global_scope();
-                return NULL;
+                decl_scratch.size = decl_base;
+                return STMT_NONE;
             }
-            param.name = tokens.get(current);
+            param.name = tokens.symbol(current);
+            param.offset = (int)tokens.offset(current);
             advance();
 
             if (!eat_token(TokenType::COLON, "Expected `:` after parameter name in parameter list of the procedure")) {
                 skip_to_global_scope();
-                return NULL;
+                decl_scratch.size = decl_base;
+                return STMT_NONE;
             }
 
-            auto type = tokens.get(current);
-            if (type.type != TokenType::IDENTIFIER && !is_basic_type(type.type)) {
+            auto type = tokens.type(current);
+            if (type != TokenType::IDENTIFIER && !is_basic_type(type)) {
                 parse_error("Expected type name in parameter list of the procedure declaration for %s", proc_name);
                 skip_to_global_scope();
-                return NULL;
+                decl_scratch.size = decl_base;
+                return STMT_NONE;
             }
-            param.type = get_basic_type(tokens.get(current).type);
+            param.type = get_basic_type(tokens.type(current));
             advance();
 
-            params.add(param);
+            decl_scratch.add(param);
 
-            if (tokens.get(current).type != TokenType::COMMA) break;
+            if (tokens.type(current) != TokenType::COMMA) break;
             advance();
         } while (true);
 
         if (!eat_token(TokenType::PAREN_RIGHT, "Expected closing paranthesis after argument list of the function")) {
             skip_to_global_scope();
-            return NULL;
+            decl_scratch.size = decl_base;
+            return STMT_NONE;
         }
 
-        parameters = ArrayView<Decl_Var>(params.data, params.size);
+        parameter_count = decl_scratch.size - decl_base;
     }
 
     // @todo debug
-    DArray<Decl_Var> rets;
-    while (tokens.get(current).type != TokenType::BRACE_LEFT) {
+    while (tokens.type(current) != TokenType::BRACE_LEFT) {
         // @xxx this can have better error reporting with some effort
-        Decl_Var ret;
-        ret.name = Token();  // a default non-named return value
+        Decl_Var ret;  // a default non-named return value
 
-        if (tokens.get(current).type != TokenType::IDENTIFIER && !is_basic_type(tokens.get(current).type)) {
+        if (tokens.type(current) != TokenType::IDENTIFIER && !is_basic_type(tokens.type(current))) {
             parse_error("Expected type name in return type list of the procedure declaration for %s", proc_name);
             skip_to_global_scope();
-            return NULL;
+            decl_scratch.size = decl_base;
+            return STMT_NONE;
         }
 
         if (peek().type == TokenType::COLON) {
-            ret.name = tokens.get(current);
+            ret.name = tokens.symbol(current);
+            ret.offset = (int)tokens.offset(current);
             advance();  // name
             advance();  // :
             Token type = tokens.get(current);
             if (type.type != TokenType::IDENTIFIER) {
                 parse_error("Expected typename after `:` in return list of procedure %s", proc_name);
                 skip_to_global_scope();
-                return NULL;
+                decl_scratch.size = decl_base;
+                return STMT_NONE;
             }
 
             ret.type = get_basic_type(type.type);
             advance();  // type
         } else {
-            ret.type = get_basic_type(tokens.get(current).type);
+            ret.offset = (int)tokens.offset(current);
+            ret.type = get_basic_type(tokens.type(current));
             advance();
         }
 
-        rets.add(ret);
+        decl_scratch.add(ret);
 
-        if (tokens.get(current).type == TokenType::COMMA) {
+        if (tokens.type(current) == TokenType::COMMA) {
             advance();  // ,
         }
     }
 
-    if (tokens.get(current).type != TokenType::BRACE_LEFT) {
-        error(tokens.get(current).line, "Expected `{` at the start of the procedure body");
-        good = false;
-        return NULL;
+    Decl_Proc_Stmt stmt;
+    stmt.name = name.symbol;
+    stmt.offset = name.offset;
+    stmt.parameters = ast->add_decl_list(decl_scratch.data + decl_base, parameter_count);
+    stmt.returns = ast->add_decl_list(decl_scratch.data + decl_base + parameter_count, decl_scratch.size - decl_base - parameter_count);
+    decl_scratch.size = decl_base;
+
+    if (tokens.type(current) != TokenType::BRACE_LEFT) {
+        if (report()) error(tokens.line(current), "Expected `{` at the start of the procedure body");
+        return STMT_NONE;
     }
 
     advance();  // {
 
-    DArray<Stmt*> body;
-    while (tokens.get(current).type != TokenType::END && tokens.get(current).type != TokenType::BRACE_RIGHT) {
-        auto stmt = parse_statement();
-        if (!stmt) {
+    if (lazy_bodies && current_scope_depth == 1) {
+        // only the braces are looked at until the matching }
+        stmt.body_begin = (u32)current;
+        while (tokens.type(current) != TokenType::END && current_scope_depth != 0) {
+            advance();
+        }
+
+        if (current_scope_depth != 0) {
+            parse_error("Expected closing `}` at the end of procedure body");
+            return STMT_NONE;
+        }
+
+        stmt.body_end = (u32)(current - 1);
+        stmt.end_offset = (int)tokens.offset(current - 1);
+        stmt.body_state = BodyState::SKIPPED;
+        return ast->add(stmt);
+    }
+
+    if (!proc_body(&stmt)) return STMT_NONE;
+    return ast->add(stmt);
+}
+
+// the statements of a procedure body up to and including the closing }, the opening one is already consumed
+bool Parser::proc_body(Decl_Proc_Stmt* stmt) {
+    bool good = true;
+
+    size_t base = stmt_scratch.size;
+    while (tokens.type(current) != TokenType::END && tokens.type(current) != TokenType::BRACE_RIGHT) {
+        auto body_stmt = parse_statement();
+        if (body_stmt == STMT_NONE) {
             good = false;
             continue;
         }
 
-        body.add(stmt);
+        stmt_scratch.add(body_stmt);
     }
 
+    stmt->end_offset = (int)tokens.offset(current);
     if (!eat_token(TokenType::BRACE_RIGHT, "Expected closing `}` at the end of procedure body")) {
         good = false;
     }
 
-    auto* stmt = new Decl_Proc_Stmt;
-    stmt->body = ArrayView<Stmt*>(body.data, body.size);
-    stmt->name = name;
-    stmt->parameters = parameters;
-    stmt->returns = ArrayView<Decl_Var>(rets.data, rets.size);
-
     if (!good) {
-        body.free();
-        return NULL;
+        stmt_scratch.size = base;
+        return false;
     }
-    return stmt;
+
+    stmt->body = finish_statements(base);
+    return true;
 }
 
-Expr_Stmt* Parser::expr_stmt() {
-    Expr* expr = parse_expression();  // function call etc. are here
-    if (!expr) skip_past(TokenType::SEMICOLON);
-    if (tokens.get(current).type != TokenType::SEMICOLON) {  // @todo expression type
+bool parse_body(Ast* ast, Stmt_ID proc) {
+    Decl_Proc_Stmt stmt = *ast->get<Decl_Proc_Stmt>(proc);  // a copy since the body adds procedures of its own
+    if (stmt.body_state == BodyState::PARSED) return true;
+
+    // quiet, a body that doesn't parse on its own is reported by parse_whole
+    Parser parser(ast->tokens, ast, ast->arena);
+    parser.quiet = true;
+    parser.current = stmt.body_begin;
+    parser.current_scope_depth = 1;
+    ast->cons_table.scope++;  // the `{` was skipped by the lazy parse
+
+    bool good = parser.proc_body(&stmt) && !parser.had_diagnostic && parser.current == stmt.body_end + 1;
+    if (good) {
+        stmt.body_state = BodyState::PARSED;
+    }
+    else {
+        stmt.body = Stmt_List();
+    }
+
+    *ast->get<Decl_Proc_Stmt>(proc) = stmt;
+    return good;
+}
+
+bool parse_whole(Ast* ast) {
+    Parser parser(ast->tokens, ast, ast->arena);
+    bool error = false;
+    parser.parse(&error);
+    return !error;
+}
+
+Stmt_ID Parser::expr_stmt() {
+    Expr_ID expr = parse_expression();  // function call etc. are here
+    if (expr == EXPR_NONE) skip_past(TokenType::SEMICOLON);
+    if (tokens.type(current) != TokenType::SEMICOLON) {  // @todo expression type
         parse_error("Expceted ´;´ after expression statement");
     }
     advance();
-    return new Expr_Stmt(expr);
+
+    Expr_Stmt stmt;
+    stmt.expr = expr;
+    return ast->add(stmt);
 }
 
-Import_Stmt* Parser::import_stmt() {
+Stmt_ID Parser::import_stmt() {
     advance();  // import
 
-    Token mod = tokens.get(current);
-    if (mod.type != TokenType::IDENTIFIER) {
+    if (tokens.type(current) != TokenType::IDENTIFIER) {
         parse_error("Expected module name in import statement");
         skip_past(TokenType::SEMICOLON);
-        return NULL;
+        return STMT_NONE;
     }
+
+    Import_Stmt stmt;
+    stmt.module_name = tokens.symbol(current);
+    stmt.offset = (int)tokens.offset(current);
     advance();
 
     if (!eat_token(TokenType::SEMICOLON, "Expected `;` at the end of import statement")) {
-        return NULL;
+        return STMT_NONE;
     }
 
-    return new Import_Stmt(mod);
+    return ast->add(stmt);
 }
 
 // return expr ; (; is optional)
 // return expr1, expr2 ... (;) (comma seperated multiple returns
-Return_Stmt* Parser::return_stmt() {
+Stmt_ID Parser::return_stmt() {
     advance();  // return
 
-    auto returns = DArray<Expr*>();
+    size_t base = expr_scratch.size;
 
-    Expr* expr = parse_expression();
-    if (!expr) {
+    Expr_ID expr = parse_expression();
+    if (expr == EXPR_NONE) {
         skip_past(TokenType::SEMICOLON);
-        return NULL;
+        return STMT_NONE;
     }
 
-    returns.add(expr);
+    expr_scratch.add(expr);
 
-    while (tokens.get(current).type == TokenType::COMMA) {
+    while (tokens.type(current) == TokenType::COMMA) {
         advance();
 
         expr = parse_expression();
-        if (!expr) {
+        if (expr == EXPR_NONE) {
             skip_past(TokenType::SEMICOLON);
-            return NULL;
+            expr_scratch.size = base;
+            return STMT_NONE;
         }
-        returns.add(expr);
+        expr_scratch.add(expr);
     }
 
-    if (tokens.get(current).type == TokenType::SEMICOLON)
+    if (tokens.type(current) == TokenType::SEMICOLON)
         advance();
 
-    return new Return_Stmt(returns);
+    Return_Stmt stmt;
+    stmt.returns = ast->add_expr_list(expr_scratch.data + base, expr_scratch.size - base);
+    expr_scratch.size = base;
+    return ast->add(stmt);
 }
 
 // expressions
 /*
-  1 grouping
-  2 unary
-  3 arithmetic
-  4 comparison
-  5 land
-  6 lor
+  pratt parser over the binary operators, binding power from lowest to highest:
+  1 lor
+  2 land
+  3 arithmetic (+ -)
+  4 factor (* /)
+  5 comparison (< > <= >=)
+  6 equality (== !=)
+  everything binds left to right, the operands are unary expressions: unary -> postfix (member, call) -> primary
 */
 
-Expr* Parser::parse_expression() {
-    int line = tokens.get(current).line;
-    Expr* expr = logical_or_expr();
-    expr = collapse_expr(expr);
-    if (expr) expr->location.line = line;
-    return expr;
-}
-
-Expr* Parser::logical_or_expr() {
-    auto left = logical_and_expr();
-    if (!(tokens.get(current).type == TokenType::OR)) {
-        return left;
-    }
-
-    Binary_Expr* lor = new Binary_Expr;
-    lor->left = left;
-
-#ifdef DEBUG
-    lor->source = "EXPR_OR";
-#endif
-    while (tokens.get(current).type == TokenType::OR) {
-        lor->opperator = token_to_operator(TokenType::OR);
+// 0 for anything that isn't a binary operator, Operator shares its values with TokenType so any token can be asked
+static int binding_power(Operator op) {
+    // @update Operator
+    switch (op) {
+        case Operator::OR:            return 1;
+        case Operator::AND:           return 2;
+        case Operator::PLUS:
+        case Operator::MINUS:         return 3;
+        case Operator::MULT:
+        case Operator::DIV:           return 4;
+        case Operator::LESS:
+        case Operator::GREATER:
+        case Operator::LESS_EQUAL:
+        case Operator::GREATER_EQUAL: return 5;
+        case Operator::EQUALS:
+        case Operator::NOT_EQUALS:    return 6;
+        default:                      return 0;
+    }
+}
+
+static const int EQUALITY_BINDING_POWER = 6;
+
+Expr_ID Parser::parse_expression() {
+    Expr_ID expr = binary_expr(0);
+    return collapse_expr(ast, expr, quiet ? &had_diagnostic : NULL);
+}
+
+// operators binding tighter than min_power
+Expr_ID Parser::binary_expr(int min_power) {
+    int offset = (int)tokens.offset(current);
+    Expr_ID left = unary_expr();
+
+    while (true) {
+        Operator op = (Operator)tokens.type(current);
+        int power = binding_power(op);
+        if (power <= min_power) break;
         advance();
 
-        lor->right = logical_or_expr();
-    }
-
-    return lor;
-}
-
-Expr* Parser::logical_and_expr() {
-    auto left = arithmetic_expr();
-    if (!(tokens.get(current).type == TokenType::AND)) {
-        return left;
-    }
-
-    Binary_Expr* land = new Binary_Expr;
-    land->left = left;
-
+        Binary_Expr binary;
 #ifdef DEBUG
-    land->source = "EXPR_AND";
+        binary.source = (ExprSource)power;
 #endif
-    while (tokens.get(current).type == TokenType::AND) {
-        land->opperator = token_to_operator(TokenType::AND);
-        advance();
-
-        land->right = logical_and_expr();
-    }
-
-    return land;
-}
-
-// multiplication, division ...
-Expr* Parser::arithmetic_expr() {
-    auto left = factor_expr();
-    if (!(tokens.get(current).type == TokenType::MINUS || tokens.get(current).type == TokenType::PLUS)) {
-        return left;
-    }
+        binary.location.offset = offset;
+        binary.opperator = op;
+        binary.left = left;
+        binary.right = binary_expr(power);
 
-    Binary_Expr* arith = new Binary_Expr;
-    arith->left = left;
-
-#ifdef DEBUG
-    arith->source = "EXPR_ARITH";
-#endif
-    while (tokens.get(current).type == TokenType::MINUS || tokens.get(current).type == TokenType::PLUS) {
-        arith->opperator = token_to_operator(tokens.get(current).type);
-        advance();
+        if (power == EQUALITY_BINDING_POWER && binding_power((Operator)tokens.type(current)) == EQUALITY_BINDING_POWER) {
+            parse_error("Chained equality comparisons are not supported, use parentheses");  // don't allow 3 != 4 == 5
+        }
 
-        arith->right = arithmetic_expr();
+        left = ast->cons(binary);
     }
 
-    return arith;
+    return left;
 }
 
-Expr* Parser::factor_expr() {
-    auto left = comparison_expr();
-    if (!(tokens.get(current).type == TokenType::STAR || tokens.get(current).type == TokenType::SLASH)) {
-        return left;
-    }
-
-    Binary_Expr* factor = new Binary_Expr;
-    factor->left = left;
-
-#ifdef DEBUG
-    factor->source = "EXPR_FACTOR";
-#endif
-    while (tokens.get(current).type == TokenType::STAR || tokens.get(current).type == TokenType::SLASH) {
-        factor->opperator = token_to_operator(tokens.get(current).type);
-        advance();
-        factor->right = factor_expr();
-    }
-
-    return factor;
+static bool is_unary_operator(TokenType type) {
+    return type == TokenType::MINUS || type == TokenType::EXCLAMATION;
 }
 
-Expr* Parser::comparison_expr() {
-    Expr* comp_eq = comparison_equality_expr();
-    if (!(tokens.get(current).type == TokenType::LESS
-        || tokens.get(current).type == TokenType::GREATER
-        || tokens.get(current).type == TokenType::LESS_EQUAL
-        || tokens.get(current).type == TokenType::GREATER_EQUAL)) {
-      return comp_eq;
-    }
-
-    Binary_Expr* comp = new Binary_Expr;
-
-    comp->left = comp_eq;
-
-#ifdef DEBUG
-    comp->source = "EXPR_COMP";
-#endif
-
-    while (tokens.get(current).type == TokenType::LESS
-        || tokens.get(current).type == TokenType::GREATER
-        || tokens.get(current).type == TokenType::LESS_EQUAL
-        || tokens.get(current).type == TokenType::GREATER_EQUAL) {
-        comp->opperator = token_to_operator(tokens.get(current).type);
-        advance();
-
-        comp->right = comparison_equality_expr();
+Expr_ID Parser::unary_expr() {
+    TokenType type = tokens.type(current);
+    if (!is_unary_operator(type)) {
+        return postfix_expr();
     }
+    int offset = (int)tokens.offset(current);
+    advance();
 
-    return comp;
-}
+    if (is_unary_operator(tokens.type(current))) {
+        parse_error("Nested unary operators are not supported\n");  // @xxx maybe we want nested unary operators
+        while (is_unary_operator(tokens.type(current))) {
+            advance();
+        }
 
-Expr* Parser::comparison_equality_expr() {
-    Expr* unary = unary_expr();
-    if (!(tokens.get(current).type == TokenType::EQUAL_EQUAL || tokens.get(current).type == TokenType::EXCLAMATION_EQUAL)) {
-      return unary;
+        return EXPR_NONE;
     }
 
-    Binary_Expr* comp = new Binary_Expr;
-
-    comp->left = unary;
-
+    Unary_Expr unary;
 #ifdef DEBUG
-    comp->source = "EXPR_COMP_EQ";
+    unary.source = ExprSource::UNARY;
 #endif
-    while (tokens.get(current).type == TokenType::EQUAL_EQUAL || tokens.get(current).type == TokenType::EXCLAMATION_EQUAL) {
-        comp->opperator = token_to_operator(tokens.get(current).type);
-        advance();
-
-        comp->right = unary_expr();  // don't allow 3 != 4 == 5
-    }
-
-    return comp;
+    unary.location.offset = offset;
+    unary.opperator = token_to_operator(type);
+    unary.operand = postfix_expr();
+    return ast->cons(unary);
 }
 
-Expr* Parser::unary_expr() {
-    if (tokens.get(current).type == TokenType::MINUS || tokens.get(current).type == TokenType::EXCLAMATION) {
-        if (tokens.get(current).type == TokenType::MINUS || tokens.get(current).type == TokenType::EXCLAMATION) {
-            parse_error("Nested unary operators are not supported\n");  // @xxx maybe we want nested unary operators
-            while (tokens.get(current).type == TokenType::MINUS || tokens.get(current).type == TokenType::EXCLAMATION) {
-                advance();
-            }
+// a primary expression followed by at most one member access and then at most one call: a.b(c)
+Expr_ID Parser::postfix_expr() {
+    int offset = (int)tokens.offset(current);
+    Expr_ID expr = primary_expr();
 
-            return NULL;
+    if (tokens.type(current) == TokenType::DOT) {
+        advance();
+        if (tokens.type(current) != TokenType::IDENTIFIER) {
+            parse_error("Expected member name after `.` in expression");
+            advance();
+            return EXPR_NONE;
         }
 
-        Unary_Expr* unary = new Unary_Expr;
+        Member_Expr member;
 #ifdef DEBUG
-        unary->source = "EXPR_UNARY";
+        member.source = ExprSource::MEMBER;
 #endif
-        unary->opperator = token_to_operator(tokens.get(current).type);
+        member.location.offset = offset;
+        member.expression = expr;
+        member.member = tokens.symbol(current);
         advance();
-
-        unary->operand = call_expr();
-        return unary;
+        expr = ast->add(member);
     }
 
-    return call_expr();
-}
-
-Expr* Parser::call_expr() {
-    Expr* expr = member_expr();
-
-    if (tokens.get(current).type == TokenType::PAREN_LEFT) {
-        Call_Expr* call = new Call_Expr;
+    if (tokens.type(current) == TokenType::PAREN_LEFT) {
+        Call_Expr call;
 #ifdef DEBUG
-        call->source = "EXPR_CALL";
+        call.source = ExprSource::CALL;
 #endif
-        call->expression = expr;
+        call.location.offset = offset;
+        call.expression = expr;
         advance();
 
-        DArray<Expr*> arguments;
-        while (current < tokens.count && tokens.get(current).type != TokenType::PAREN_RIGHT) {
-            Expr* argument = parse_expression();
-            if (!argument) {
+        size_t base = expr_scratch.size;
+        while (tokens.in_range(current) && tokens.type(current) != TokenType::PAREN_RIGHT) {
+            Expr_ID argument = parse_expression();
+            if (argument == EXPR_NONE) {
                 parse_error("Faulty expression for call argument");
-                Token curr = tokens.get(current);
-                while (!(starts_statement(curr.type) || curr.type == TokenType::PAREN_RIGHT)) {
+                while (!(starts_statement(tokens.type(current)) || tokens.type(current) == TokenType::PAREN_RIGHT)) {
                     advance();
                 }
-                return NULL;
+                expr_scratch.size = base;
+                return EXPR_NONE;
             }
-            arguments.add(argument);
+            expr_scratch.add(argument);
 
-            if (tokens.get(current).type != TokenType::COMMA) {
+            if (tokens.type(current) != TokenType::COMMA) {
                 break;
             }
             advance();
 
         }
 
-        if (tokens.get(current).type != TokenType::PAREN_RIGHT) {
+        if (tokens.type(current) != TokenType::PAREN_RIGHT) {
             parse_error("Reached end of input while parsing call arguments");
-            return NULL;
+            expr_scratch.size = base;
+            return EXPR_NONE;
         }
 
         advance();
-        call->arguments = Array(arguments.data, arguments.size);
+        call.arguments = ast->add_expr_list(expr_scratch.data + base, expr_scratch.size - base);
+        expr_scratch.size = base;
 
-        return call;
+        return ast->add(call);
     }
 
     return expr;
 }
 
-Expr* Parser::member_expr() {
-    Expr* expr = grouping_expr();
-    if (tokens.get(current).type == TokenType::DOT) {
-        advance();
-        if (tokens.get(current).type != TokenType::IDENTIFIER) {
-            parse_error("Expected member name after `.` in expression");
-            advance();
-            return NULL;
-        }
-
-        Member_Expr* member = new Member_Expr;
-#ifdef DEBUG
-        member->source = "EXPR_MEMBER";
-#endif
-
-        member->expression = expr;
-        member->member = tokens.get(current);
-        advance();
-        return member;
-    }
-
-    return expr;
-}
+Expr_ID Parser::primary_expr() {
+    int offset = (int)tokens.offset(current);
+    switch (tokens.type(current)) {
+        case TokenType::PAREN_LEFT: {
+            advance(); // (
+            Grouping_Expr grouping;
+            grouping.location.offset = offset;
+            grouping.expr = parse_expression();
+            if (tokens.type(current) != TokenType::PAREN_RIGHT) {
+                if (report()) error_token(tokens.get(current), "Unmatched parentheses");
+            }
+            else {
+                advance(); // )
+            }
 
-Expr* Parser::grouping_expr() {
-    if (tokens.get(current).type == TokenType::PAREN_LEFT) {
-        advance(); // (
-        Expr* expr = parse_expression();
-        if (tokens.get(current).type != TokenType::PAREN_RIGHT) {
-            error_token(tokens.get(current), "Unmatched parentheses");
+            return ast->cons(grouping);
         }
-
-        return new Grouping_Expr(expr);
-    } else {
-        return primary_expr();
-    }
-}
-
-Expr* Parser::primary_expr() {
-    switch (tokens.get(current).type) {
         case TokenType::NUMERIC_LITERAL:
-        case TokenType::STRING_LITERAL:
+        case TokenType::STRING_LITERAL: {
             advance();
-            return new Literal(previous().value);
-        case TokenType::IDENTIFIER:
+            Literal literal(tokens.value(current - 1));
+            literal.location.offset = offset;
+            return ast->cons(literal);
+        }
+        case TokenType::IDENTIFIER: {
+            Variable_Expr variable;
+            variable.location.offset = offset;
+            variable.identifier = tokens.symbol(current);
             advance();
-            return new Variable_Expr(tokens.get(current-1));
+            return ast->cons(variable);
+        }
         case TokenType::TRUE:
+        case TokenType::FALSE: {
+            Literal literal(Value(tokens.type(current) == TokenType::TRUE));
+            literal.location.offset = offset;
             advance();
-            return new Literal(Value(true));
-        case TokenType::FALSE:
-            advance();
-            return new Literal(Value(false));
+            return ast->cons(literal);
+        }
         default:
             parse_error("Unrecognized token sequence");  // @fixme this should be more helpfull
-            return NULL;
+            return EXPR_NONE;
     }
 }
 
@@ -786,24 +811,26 @@ Token Parser::previous() {
 }
 
 void Parser::advance() {
-    if (current >= tokens.count) {
+    if (!tokens.in_range(current) && report()) {
         printf("Exhausted the token stream\n");  // if we try to access after this it will panic and thats probably what we want.
     }
 
-    if (tokens.get(current).type == TokenType::BRACE_LEFT) {
+    if (tokens.type(current) == TokenType::BRACE_LEFT) {
         current_scope_depth++;
+        ast->cons_table.scope++;
     }
-    else if (tokens.get(current).type == TokenType::BRACE_RIGHT) {
+    else if (tokens.type(current) == TokenType::BRACE_RIGHT) {
         current_scope_depth--;
+        ast->cons_table.scope++;
     }
 
     current++;
 }
 
 bool Parser::error_if_match(const char* error, Array<TokenType> match_seq) {
-    if (tokens.count >= current + match_seq.size) return false;
+    if (match_seq.size == 0 || !tokens.in_range(current + match_seq.size - 1)) return false;
     for (int i = 0; i < match_seq.size; i++) {
-        if (tokens.get(current + i).type != match_seq.get(i)) {
+        if (tokens.type(current + i) != match_seq.get(i)) {
             return false;
         }
     }
@@ -813,7 +840,7 @@ bool Parser::error_if_match(const char* error, Array<TokenType> match_seq) {
 }
 
 Token Parser::peek() {
-    if (current + 1 >= tokens.count) {
+    if (!tokens.in_range(current + 1) && report()) {
         printf("Peeking beyond the token stream\n");
     }
 
@@ -822,6 +849,7 @@ Token Parser::peek() {
 
 void Parser::parse_error(char const * const msg, ...) {
     had_parse_error = true;
+    if (!report()) return;
 
     char formatted_msg[1024];
     va_list args;
@@ -829,11 +857,11 @@ void Parser::parse_error(char const * const msg, ...) {
     vsnprintf(formatted_msg, sizeof(formatted_msg), msg, args);
     va_end(args);
 
-    error(tokens.get(current).line, formatted_msg);
+    error(tokens.line(current), formatted_msg);
 }
 
 bool Parser::eat_token(TokenType type, char const * const msg) {
-    if (tokens.get(current).type != type) {
+    if (tokens.type(current) != type) {
         parse_error(msg);
         return false;
     }
@@ -843,18 +871,143 @@ bool Parser::eat_token(TokenType type, char const * const msg) {
 }
 
 void Parser::skip_past(TokenType type) {
-    while (current < tokens.count) {
-        auto curr_type = tokens.get(current).type;
+    while (tokens.in_range(current)) {
+        auto curr_type = tokens.type(current);
+        if (curr_type == TokenType::END) break;  // the callers still look at the current token
         advance();
         if (curr_type == type || starts_statement(curr_type)) break;
     }
 }
 
-void print_ast(ArrayView<Stmt*> program) {
+void print_ast(const Ast* ast) {
     printf("Ast of the program\n");
-    printf("Program has %zu top level statements\n", program.count);
+    printf("Program has %u top level statements\n", ast->program.count);
+
+    for (auto s : ast->list(ast->program)) {
+        print_stmt(ast, s);
+    }
+}
+
+// parallel parsing of big inputs. the tokens are split into chunks in front of a declaration at the top level
+// (outside of any braces), every chunk is parsed on its own thread into its own ast and the asts are appended in
+// order, so the nodes end up exactly where the sequential parse would put them.
+// a chunk that has something to report, or a statement that runs over the end of its chunk, means the chunks
+// don't line up with the statements and the input is parsed again sequentially, so diagnostics come out exactly
+// as they would without threads.
+
+static const size_t PARSE_MIN_CHUNK_TOKENS = 64 * 1024;
+static const size_t PARSE_ARENA_CHUNK_SIZE = 256 * 1024;
+
+static bool starts_declaration(TokenType type) {
+    return type == TokenType::PROC || type == TokenType::VAR || type == TokenType::IMPORT;
+}
+
+// start of every chunk followed by the index of the end token
+static DArray<size_t> parse_split_points(const Token_Buffer* tokens, size_t chunk_count) {
+    size_t count = tokens->count();
+    size_t chunk_size = count / chunk_count;
+
+    DArray<size_t> splits;
+    splits.add(0);
+
+    size_t target = chunk_size;
+    int depth = 0;
+    size_t i = 0;
+    for (; i < count; i++) {
+        TokenType type = tokens->type(i);
+        if (type == TokenType::END) break;
+
+        if (type == TokenType::BRACE_LEFT) depth++;
+        else if (type == TokenType::BRACE_RIGHT) depth--;
+        else if (depth == 0 && i >= target && splits.size < chunk_count && starts_declaration(type)) {
+            splits.add(i);
+            target = i + chunk_size;
+        }
+    }
+
+    splits.add(i);
+    return splits;
+}
+
+Stmt_List parse_parallel(const Token_Buffer* tokens, Ast* ast, Linear_Allocator* arena, size_t thread_count, bool lazy_bodies, bool* error) {
+    auto parse_sequential = [&]() {
+        Parser parser(tokens, ast, arena);
+        parser.lazy_bodies = lazy_bodies;
+        return parser.parse(error);
+    };
+
+    size_t chunk_count = tokens->count() / PARSE_MIN_CHUNK_TOKENS;
+    if (chunk_count > thread_count) chunk_count = thread_count;
+    if (chunk_count < 2) return parse_sequential();
 
-    for (auto s : program) {
-        print_stmt(s);
+    DArray<size_t> splits = parse_split_points(tokens, chunk_count);
+    chunk_count = splits.size - 1;
+    if (chunk_count < 2) {  // a few huge declarations
+        splits.free();
+        return parse_sequential();
     }
+
+    Ast* chunks = new Ast[chunk_count];
+    Linear_Allocator* arenas = new Linear_Allocator[chunk_count];
+    ArrayView<Stmt_ID>* statements = new ArrayView<Stmt_ID>[chunk_count];  // top level statements of every chunk, in its arena
+    bool* redo = new bool[chunk_count];
+
+    auto parse_chunk = [&](size_t index) {
+        arenas[index] = make_allocator(PARSE_ARENA_CHUNK_SIZE);
+
+        chunks[index].hash_consing = ast->hash_consing;
+
+        Parser parser(tokens, &chunks[index], &arenas[index]);
+        parser.quiet = true;
+        parser.lazy_bodies = lazy_bodies;
+        parser.current = splits[index];
+        parser.parse_statements(splits[index + 1]);
+
+        statements[index] = ArrayView<Stmt_ID>(parser.stmt_scratch.data, parser.stmt_scratch.size);
+        redo[index] = parser.had_diagnostic || parser.current != splits[index + 1] || parser.current_scope_depth != 0;
+    };
+
+    std::thread* workers = new std::thread[chunk_count - 1];
+    for (size_t i = 1; i < chunk_count; i++) {
+        workers[i - 1] = std::thread(parse_chunk, i);
+    }
+    parse_chunk(0);
+    for (size_t i = 0; i < chunk_count - 1; i++) {
+        workers[i].join();
+    }
+    delete[] workers;
+
+    bool sequential = false;
+    for (size_t i = 0; i < chunk_count; i++) {
+        if (redo[i]) sequential = true;
+    }
+
+    if (!sequential) {
+        DArray<Stmt_ID> program(arena);
+        for (size_t i = 0; i < chunk_count; i++) {
+            Ast_Rebase rebase = ast->append(chunks[i]);
+            for (auto statement : statements[i]) {
+                program.add(rebase.stmt(statement));
+            }
+        }
+
+        ast->program = ast->add_stmt_list(program.data, program.size);
+        *error = false;
+    }
+
+    for (size_t i = 0; i < chunk_count; i++) {
+        chunks[i].free();
+        destroy_allocator(&arenas[i]);
+    }
+    delete[] chunks;
+    delete[] arenas;
+    delete[] statements;
+    delete[] redo;
+    splits.free();
+
+    if (sequential) {
+        return parse_sequential();
+    }
+
+    return ast->program;
 }
@@ -2,8 +2,10 @@
 
 #include "common.hpp"
 #include "token.hpp"
+#include "lexer.hpp"
 #include "stmt.hpp"
 #include "expr.hpp"
+#include "ast.hpp"
 
 /*
   precedence:
@@ -13,25 +15,47 @@
   * member
   * call
   * unary
-  * arithmetic
-  * factor
-  * comparison
   * eq_comparison
+  * comparison
+  * factor
+  * arithmetic
   * land
   * lor
 */
 
 struct Parser {
-  ArrayView<Token> tokens;
+  Token_Stream tokens;
   size_t current = 0;
-  Parser(ArrayView<Token>);
+
+  Ast* ast;  // the nodes go here
+  Linear_Allocator* arena;  // scratch space of the parser
+
+  // children of the lists being parsed, a nested list goes on top of the ones enclosing it and
+  // each is copied to the ast in one piece when it is complete so the ranges there stay contiguous
+  DArray<Expr_ID> expr_scratch;
+  DArray<Stmt_ID> stmt_scratch;
+  DArray<Decl_Var> decl_scratch;
+
+  Parser(const Token_Buffer*, Ast* ast, Linear_Allocator* arena);  // batch, the buffer has to outlive the parser
+  Parser(String source, Ast* ast, Linear_Allocator* arena);        // streaming, tokens are lexed as the parser asks for them
 
   int current_scope_depth = 0;
   bool had_parse_error = false;
 
-  ArrayView<Stmt*> parse(bool* error);
-  Stmt* parse_statement();
-  Expr* parse_expression();
+  // leave the bodies of top level procedures to parse_body, they are only skipped over
+  bool lazy_bodies = false;
+
+  // the parsers of a parallel parse don't print anything, they only remember that there was something to report
+  bool quiet = false;
+  bool had_diagnostic = false;
+
+  Stmt_List parse(bool* error);  // also sets ast->program
+  void parse_statements(size_t end);  // top level statements that start before end, they are left on stmt_scratch
+  Stmt_ID parse_statement();
+  Expr_ID parse_expression();
+  bool proc_body(Decl_Proc_Stmt* stmt);
+
+  void parse_error(char const * const, ...);
 private:
   void skip_to_global_scope();
   void advance();
@@ -44,33 +68,39 @@ private:
   [[nodiscard]]
   bool eat_token(TokenType, char const * const);
 
-  void parse_error(char const * const, ...);
+  bool report();  // every diagnostic of the parser goes through this
   bool error_if_match(const char* error, Array<TokenType> match_seq);
 
-  Stmt* statement();
-  Block_Stmt* block_stmt();
-  If_Stmt* if_stmt();
-  For_Stmt* for_stmt();
-  Assign_Stmt* assign_stmt();
-  Decl_Var_Stmt* decl_var_stmt();
-  Decl_Proc_Stmt* decl_proc_stmt();
-  Expr_Stmt* expr_stmt();
-  Import_Stmt* import_stmt();
-  Return_Stmt* return_stmt();
-
-  Stmt* parse_after_identifier();
-
-  Expr* logical_or_expr();
-  Expr* logical_and_expr();
-  Expr* arithmetic_expr();
-  Expr* factor_expr();
-  Expr* grouping_expr();
-  Expr* unary_expr();
-  Expr* comparison_expr();
-  Expr* comparison_equality_expr();
-  Expr* call_expr();
-  Expr* member_expr();
-  Expr* primary_expr();
+  Stmt_List finish_statements(size_t base);
+
+  Stmt_ID statement();
+  Stmt_ID block_stmt();
+  Stmt_ID if_stmt();
+  Stmt_ID for_stmt();
+  Stmt_ID assign_stmt();
+  Stmt_ID decl_var_stmt();
+  Stmt_ID decl_proc_stmt();
+  Stmt_ID expr_stmt();
+  Stmt_ID import_stmt();
+  Stmt_ID return_stmt();
+
+  Stmt_ID parse_after_identifier();
+
+  Expr_ID binary_expr(int min_power);
+  Expr_ID unary_expr();
+  Expr_ID postfix_expr();
+  Expr_ID primary_expr();
 };
 
-void print_ast(ArrayView<Stmt*> program);
\ No newline at end of file
+// parses the top level statements on multiple threads, gives the same tree and diagnostics as Parser::parse
+Stmt_List parse_parallel(const Token_Buffer* tokens, Ast* ast, Linear_Allocator* arena, size_t thread_count, bool lazy_bodies, bool* error);
+
+// parses a body skipped by a lazy parse from ast->tokens. nothing is reported, it returns false if the body doesn't
+// parse cleanly up to the } the skip matched (it is left empty then), and the program has to go through parse_whole
+bool parse_body(Ast* ast, Stmt_ID proc);
+
+// parses the program again from ast->tokens with every body and replaces ast->program, reporting what a parse
+// without lazy bodies reports. the nodes of the lazy parse are left unused. returns false if it had errors
+bool parse_whole(Ast* ast);
+
+void print_ast(const Ast* ast);
@@ -1,93 +1,140 @@
 #include "resolve.hpp"
+#include "parser.hpp"
 #include "log.hpp"
+#include "parallel.hpp"
+
+const Scope_Table* Resolver::resolve() {
+  // with skipped bodies what is reported is held back until they all parsed, if one didn't it all goes away
+  Diagnostic_Buffer held;
+  if (ast->tokens) capture_diagnostics(&held);
+  resolve_program();
+  capture_diagnostics(NULL);
+
+  if (!body_parse_failed) write_diagnostics(&held, 0, held.count());
+  held.free();
+
+  if (body_parse_failed) {
+    // what the lazy parse skipped has errors, parsing it all reports them like -full-check does. if that parse is
+    // clean (a body can fail without a message) it is resolved again from the start like it would be there
+    if (!parse_whole(ast)) {
+      had_parse_error = true;
+      return &scopes;
+    }
+
+    scopes = Scope_Table(arena);
+    dependency_edges = DArray<Dependency_Edge>(arena);
+    requested_bodies = DArray<Stmt_ID>(arena);
+    current_dependent = DEPENDENCY_ROOT;
+    body_parse_failed = false;
+    resolve_program();
+  }
 
-ArrayView<Environment> Resolver::resolve() {
-  auto global = Environment(-1);  // @hack, -1
-  environments.add(global);
-  current_environment = environments.size-1;
+  const Procedure* main_proc = scopes.get_procedure(0, intern(String("main")));
+  dependencies = build_dependency_graph(ArrayView<Dependency_Edge>(dependency_edges.data, dependency_edges.size),
+                                        scopes.procedures.size, scopes.globals.slots.size,
+                                        main_proc ? main_proc->proc_id : 0, arena);
+
+  return &scopes;
+}
+
+void Resolver::resolve_program() {
+  current_environment = scopes.add_scope(-1, -1);  // global
 
   collect_declarations();
   resolve_references();
-
-  return ArrayView<Environment>(environments.data, environments.size);
+  resolve_requested_bodies();
 }
 
 void Resolver::collect_declarations() {
-  for (auto stmt : program) {
+  for (auto stmt : ast->list(ast->program)) {
     collect_declaration(stmt);
   }
 }
 
-// collect procedure declarations and fill in the environments array
-void Resolver::collect_declaration(Stmt* stmt) {
-  stmt->scope = environments.get_ref(current_environment);
+// collect procedure declarations and fill in the scope table
+void Resolver::collect_declaration(Stmt_ID stmt) {
+  ast->stmt(stmt)->scope = current_environment;
 
-  switch (stmt->kind) {
+  switch (stmt_kind(stmt)) {
     case StmtKind::DECL_VAR: {
-      auto decl_var = static_cast<Decl_Var_Stmt*>(stmt);
+      auto decl_var = ast->get<Decl_Var_Stmt>(stmt);
 
-      Variable var;
-      var.type = decl_var->decl.type;
       // for type inferrence this should pass through as non-determined to typecheck
-      environments.get_ref(current_environment)->bind_variable(decl_var->decl.name.lexeme, var);
+      decl_var->address = declare_variable(decl_var->decl.name, decl_var->decl.type);
       break;
     }
     case StmtKind::DECL_PROC: {
-      auto decl_proc = static_cast<Decl_Proc_Stmt*>(stmt);
+      auto decl_proc = ast->get<Decl_Proc_Stmt>(stmt);
 
       Procedure proc;
 
       int enclosing = current_environment;
-      Environment proc_scope = Environment(current_environment);
-      environments.add(proc_scope);
-      current_environment = environments.size - 1;
 
-      proc.procedure_scope = environments.get_ref(current_environment);
+      // the parameters take the first slots of the frame, they are bound after the body
+      auto decl_parameters = ast->list(decl_proc->parameters);
+      Frame_Layout frame;
+      frame.procedure = stmt;
+      frame.parent = scopes.scope(enclosing)->frame;
+      frame.depth = (frame.parent == -1) ? 0 : scopes.frames.get_ref(frame.parent)->depth + 1;
+      frame.slots = DArray<Type_ID>(arena, decl_parameters.count);
+      for (auto param : decl_parameters) {
+        frame.slots.add(param.type);
+      }
+      scopes.frames.add(frame);
+
+      current_environment = scopes.add_scope(enclosing, scopes.frames.size - 1);
+
+      proc.procedure_scope = current_environment;
       proc.body = decl_proc->body;
+      proc.declaration = stmt;
       proc.proc_id = 0;  // assigned by the environment
+      decl_proc->body_scope = current_environment;
 
-      for (auto proc_stmt : decl_proc->body) {
-          collect_declaration(proc_stmt);
-      }
-
-      DArray<Variable> parameters(decl_proc->parameters.count);
-      for (int i = 0; i < decl_proc->parameters.count; i++) {
-        Decl_Var param = decl_proc->parameters.get(i);
-        int var_id = environments.get_ref(current_environment)->bind_variable(param.name.lexeme, Variable{0 /*assigned in the call*/, param.type});
-        parameters.add(Variable{var_id, param.type});
+      // a skipped body gets its parameters once its declarations are collected in resolve_requested_bodies
+      if (decl_proc->body_state == BodyState::PARSED) {
+        for (auto proc_stmt : ast->list(decl_proc->body)) {
+            collect_declaration(proc_stmt);
+        }
+        proc.parameters = bind_parameters(decl_proc);
       }
 
-      proc.parameters = ArrayView<Variable>(parameters.data, parameters.size);
+      auto decl_returns = ast->list(decl_proc->returns);
+      DArray<Type_ID> parameter_types(arena, decl_parameters.count);
+      DArray<Type_ID> return_types(arena, decl_returns.count);
+      for (auto param : decl_parameters) parameter_types.add(param.type);
+      for (auto ret : decl_returns) return_types.add(ret.type);
+      proc.type = procedure_type(ArrayView<Type_ID>(parameter_types.data, parameter_types.size),
+                                 ArrayView<Type_ID>(return_types.data, return_types.size));
 
       proc.is_nested = enclosing > 1;
 
       current_environment = enclosing;
 
-      decl_proc->proc_id = environments.get_ref(current_environment)->bind_procedure(decl_proc->name.lexeme, proc);
+      decl_proc->proc_id = scopes.bind_procedure(current_environment, decl_proc->name, proc);
       break;
     }
     case StmtKind::IF: {
-      auto if_s = static_cast<If_Stmt*>(stmt);
+      auto if_s = ast->get<If_Stmt>(stmt);
+      Stmt_ID else_stmt = if_s->else_stmt;
       collect_declaration(if_s->then_stmt);  // then statement must exist
-      if (if_s->else_stmt) {
-        collect_declaration(if_s->else_stmt);
+      if (else_stmt != STMT_NONE) {
+        collect_declaration(else_stmt);
       }
       break;
     }
     case StmtKind::FOR: {
-      auto for_s = static_cast<For_Stmt*>(stmt);
+      auto for_s = ast->get<For_Stmt>(stmt);
       collect_declaration(for_s->body);
       break;
     }
     case StmtKind::BLOCK: {
-      auto block = static_cast<Block_Stmt*>(stmt);
+      auto block = ast->get<Block_Stmt>(stmt);
 
       int enclosing = current_environment;
-      Environment proc_scope = Environment(current_environment);
-      environments.add(proc_scope);
-      current_environment = environments.size - 1;  // last index
+      // a block's locals go in the frame of its procedure
+      current_environment = scopes.add_scope(enclosing, scopes.scope(enclosing)->frame);
 
-      for (auto s : block->body) {
+      for (auto s : ast->list(block->body)) {
         collect_declaration(s);
       }
 
@@ -100,65 +147,121 @@ void Resolver::collect_declaration(Stmt* stmt) {
 }
 
 void Resolver::resolve_references() {
-  for (auto stmt : program) {
-    resolve_reference(stmt);
+  auto program = ast->list(ast->program);
+  if (thread_count < 2 || program.count < PARALLEL_MIN_TASKS) {
+    for (auto stmt : program) {
+      resolve_reference(stmt);
+    }
+    return;
+  }
+
+  // every top level statement is a task, what a worker finds is merged in source order so the edges and the
+  // requested bodies come out as they would from one thread
+  struct Task_Output {
+    size_t first_edge, end_edge;
+    size_t first_request, end_request;
+  };
+
+  DArray<Resolver> workers(thread_count);
+  for (size_t i = 0; i < thread_count; i++) {
+    workers.add(Resolver(this));
+  }
+  Task_Output* outputs = new Task_Output[program.count];
+
+  run_tasks(program.count, thread_count,
+    [&](size_t worker, size_t index) {
+      Resolver* resolver = workers.get_ref(worker);
+      Task_Output* output = &outputs[index];
+      output->first_edge = resolver->dependency_edges.size;
+      output->first_request = resolver->requested_bodies.size;
+      resolver->resolve_reference(program.get(index));
+      output->end_edge = resolver->dependency_edges.size;
+      output->end_request = resolver->requested_bodies.size;
+    },
+    [&](size_t index, size_t worker, Task_Diagnostics) {
+      Resolver* resolver = workers.get_ref(worker);
+      Task_Output output = outputs[index];
+      for (size_t i = output.first_edge; i < output.end_edge; i++) {
+        dependency_edges.add(resolver->dependency_edges.data[i]);
+      }
+      for (size_t i = output.first_request; i < output.end_request; i++) {
+        request_body(resolver->requested_bodies.data[i]);
+      }
+    });
+
+  for (auto& worker : workers) {
+    worker.dependency_edges.free();
+    worker.requested_bodies.free();
   }
+  workers.free();
+  delete[] outputs;
 }
 
-void Resolver::resolve_reference(Stmt* stmt) {
+void Resolver::resolve_reference(Stmt_ID stmt) {
   // visit every expression and fill in the variable and procedure references with correct ids
-  auto scope = stmt->scope;
+  auto scope = ast->stmt(stmt)->scope;
 
-  switch (stmt->kind) {
+  switch (stmt_kind(stmt)) {
     case StmtKind::DECL_VAR: {
-      auto decl_var = static_cast<Decl_Var_Stmt*>(stmt);
+      auto decl_var = ast->get<Decl_Var_Stmt>(stmt);
+
+      if (decl_var->initializer != EXPR_NONE) {
+        u32 dependent = current_dependent;
+        if (decl_var->address.kind == Var_Address::GLOBAL) current_dependent = DEPENDENCY_GLOBAL | decl_var->address.slot;
 
-      if (decl_var->initializer) {
         resolve_expression(decl_var->initializer, scope);
+        current_dependent = dependent;
       }
       break;
     }
     case StmtKind::DECL_PROC: {
-      auto decl_proc = static_cast<Decl_Proc_Stmt*>(stmt);
+      auto decl_proc = ast->get<Decl_Proc_Stmt>(stmt);
+      if (decl_proc->body_state != BodyState::PARSED) break;  // resolved when something calls it
 
-      for (auto s : decl_proc->body) {
+      u32 dependent = current_dependent;
+      current_dependent = decl_proc->proc_id - 1;
+      for (auto s : ast->list(decl_proc->body)) {
         resolve_reference(s);
       }
+      current_dependent = dependent;
       break;
     }
     case StmtKind::IF: {
-      auto if_s = static_cast<If_Stmt*>(stmt);
+      auto if_s = ast->get<If_Stmt>(stmt);
 
       resolve_expression(if_s->cond, scope);
       resolve_reference(if_s->then_stmt);
-      if (if_s->else_stmt) {
+      if (if_s->else_stmt != STMT_NONE) {
         resolve_reference(if_s->else_stmt);
       }
       break;
     }
     case StmtKind::FOR: {
-      auto for_s = static_cast<For_Stmt*>(stmt);
+      auto for_s = ast->get<For_Stmt>(stmt);
 
       resolve_expression(for_s->condition, scope);
       resolve_reference(for_s->body);
       break;
     }
     case StmtKind::BLOCK: {
-      auto block = static_cast<Block_Stmt*>(stmt);
+      auto block = ast->get<Block_Stmt>(stmt);
 
-      for (auto s : block->body) {
+      for (auto s : ast->list(block->body)) {
         resolve_reference(s);
       }
 
       break;
     }
     case StmtKind::EXPRESSION: {
-      auto expr = static_cast<Expr_Stmt*>(stmt);
-      resolve_expression(expr->expr, scope);
+      auto expr = ast->get<Expr_Stmt>(stmt);
+      if (expr->expr != EXPR_NONE) {
+        resolve_expression(expr->expr, scope);
+      }
       break;
     }
     case StmtKind::ASSIGN: {
-      auto assign = static_cast<Assign_Stmt*>(stmt);
+      auto assign = ast->get<Assign_Stmt>(stmt);
+      resolve_variable(assign->target, scope, assign->offset, &assign->address);
       resolve_expression(assign->rhs, scope);
       break;
     }
@@ -167,8 +270,8 @@ void Resolver::resolve_reference(Stmt* stmt) {
       break;
     }
     case StmtKind::RETURN: {
-      auto return_s = static_cast<Return_Stmt*>(stmt);
-      for (auto ret : return_s->returns) {
+      auto return_s = ast->get<Return_Stmt>(stmt);
+      for (auto ret : ast->list(return_s->returns)) {
         resolve_expression(ret, scope);
       }
       break;
@@ -178,85 +281,133 @@ void Resolver::resolve_reference(Stmt* stmt) {
   }
 }
 
-bool Resolver::resolve_expression(Expr* expr, const Environment*  scope) {
-  switch (expr->type) {
+void Resolver::request_body(Stmt_ID proc) {
+  auto decl_proc = ast->get<Decl_Proc_Stmt>(proc);
+  if (decl_proc->body_state != BodyState::SKIPPED) return;
+  if (defer_requests) {
+    requested_bodies.add(proc);
+    return;
+  }
+
+  decl_proc->body_state = BodyState::REQUESTED;
+  requested_bodies.add(proc);
+}
+
+// bodies left by a lazy parse, main and everything it calls. without a main every procedure is a root
+void Resolver::resolve_requested_bodies() {
+  if (!ast->tokens) return;  // nothing was skipped
+
+  const Procedure* main_proc = scopes.get_procedure(0, intern(String("main")));
+  if (main_proc) {
+    request_body(main_proc->declaration);
+  }
+  else {
+    for (auto stmt : ast->list(ast->program)) {
+      if (stmt_kind(stmt) == StmtKind::DECL_PROC) request_body(stmt);
+    }
+  }
+
+  // resolving a body can request more
+  for (size_t i = 0; i < requested_bodies.size; i++) {
+    Stmt_ID proc = requested_bodies.data[i];
+    if (!parse_body(ast, proc)) {
+      body_parse_failed = true;
+      return;
+    }
+
+    auto decl_proc = ast->get<Decl_Proc_Stmt>(proc);
+    Stmt_List body = decl_proc->body;
+    scopes.procedure(decl_proc->proc_id)->body = body;
+
+    int enclosing = current_environment;
+    current_environment = decl_proc->body_scope;
+    for (auto s : ast->list(body)) {
+      collect_declaration(s);
+    }
+    current_environment = enclosing;
+    scopes.procedure(decl_proc->proc_id)->parameters = bind_parameters(decl_proc);
+
+    current_dependent = decl_proc->proc_id - 1;
+    for (auto s : ast->list(body)) {
+      resolve_reference(s);
+    }
+    current_dependent = DEPENDENCY_ROOT;
+  }
+}
+
+// after the declarations of the body, like those the first declaration of a name in the scope wins
+ArrayView<Variable> Resolver::bind_parameters(Decl_Proc_Stmt* decl_proc) {
+  auto decl_parameters = ast->list(decl_proc->parameters);
+  DArray<Variable> parameters(arena, decl_parameters.count);
+  for (u32 i = 0; i < decl_parameters.count; i++) {
+    auto param = decl_parameters.get(i);
+    int var_id = scopes.bind_variable(decl_proc->body_scope, param.name, Variable{0 /*assigned in the call*/, param.type, i});
+    parameters.add(Variable{var_id, param.type, i});
+  }
+
+  return ArrayView<Variable>(parameters.data, parameters.size);
+}
+
+void Resolver::add_dependency(u32 dependency) {
+  dependency_edges.add(Dependency_Edge{current_dependent, dependency});
+}
+
+bool Resolver::resolve_expression(Expr_ID expr, int scope) {
+  switch (expr_type(expr)) {
     case ExprType::BINARY: {
-      auto binary = static_cast<Binary_Expr*>(expr);
-      if (binary->left)  resolve_expression(binary->left, scope);
-      if (binary->right) resolve_expression(binary->right, scope);
+      auto binary = ast->get<Binary_Expr>(expr);
+      if (binary->left != EXPR_NONE)  resolve_expression(binary->left, scope);
+      if (binary->right != EXPR_NONE) resolve_expression(binary->right, scope);
       break;
     }
     case ExprType::UNARY: {
-      auto unary = static_cast<Unary_Expr*>(expr);
+      auto unary = ast->get<Unary_Expr>(expr);
       resolve_expression(unary->operand, scope);
       break;
     }
     case ExprType::GROUPING: {
-      auto grouping = static_cast<Grouping_Expr*>(expr);
+      auto grouping = ast->get<Grouping_Expr>(expr);
       resolve_expression(grouping->expr, scope);
       break;
     }
     case ExprType::VARIABLE: {
-      auto var = static_cast<Variable_Expr*>(expr);
-
-      const Variable* declaration = NULL;;
-      auto search = scope;
-      while (search != NULL) {
-        declaration = search->get_variable(var->identifier.lexeme);
-        if (declaration) break;
-
-        if (search->parent_index == -1)  // global
-          break;
-        search = environments.get_ref(search->parent_index);
-      }
-
-      if (!declaration) {
-        char buff[1024];
-        null_terminate(var->identifier.lexeme, buff);
-        errorf(var->identifier.line, "Use of undeclared variable %s", buff);
-        return false;
-      }
-
-      var->var_id = declaration->var_id;
-      break;
+      auto var = ast->get<Variable_Expr>(expr);
+      return resolve_variable(var->identifier, scope, var->location.offset, &var->address);
     }
     case ExprType::LITERAL:
       break; // nothing to do
     case ExprType::CALL: {
-      auto call = static_cast<Call_Expr*>(expr);
-
-      auto call_expr = call;
+      auto call_expr = ast->get<Call_Expr>(expr);
       bool found = false;
-      while (call_expr->expression && !found) {
-        auto expr = call_expr->expression;
-        if (expr->type == ExprType::VARIABLE) {
+      while (call_expr->expression != EXPR_NONE && !found) {
+        auto callee = call_expr->expression;
+        if (expr_type(callee) == ExprType::VARIABLE) {
           found = true;
 
-          auto proc_name = static_cast <Variable_Expr*> (expr);
+          auto proc_name = ast->get<Variable_Expr>(callee);
           const Procedure* proc = NULL;
-          auto search = scope;
-          while (search != NULL) {
-            proc = search->get_procedure(proc_name->identifier.lexeme);
+          int search = scope;
+          while (search != -1) {  // up to the global scope
+            proc = scopes.get_procedure(search, proc_name->identifier);
             if (proc) {
               break;
             }
 
-            if (search->parent_index == -1) { // global
-              break;
-            }
-            search = environments.get_ref(search->parent_index);
+            search = scopes.scope(search)->parent_index;
           }
 
           if (!proc) {
-            String_Builder* scratch = scratch_string_builder();
-            scratch->clear_and_append(proc_name->identifier.lexeme);
-            errorf(proc_name->identifier.line, "Use of undeclared procedure %s", scratch->c_string());
+            char buff[1024];
+            null_terminate(symbol_name(proc_name->identifier), buff);
+            errorf(source_line(proc_name->location.offset), "Use of undeclared procedure %s", buff);
             return false;
           }
 
           call_expr->proc_id = proc->proc_id;
-        } else if (expr->type == ExprType::CALL) {
-          call_expr = static_cast <Call_Expr*> (expr);
+          add_dependency(proc->proc_id - 1);
+          request_body(proc->declaration);
+        } else if (expr_type(callee) == ExprType::CALL) {
+          call_expr = ast->get<Call_Expr>(callee);
         } else {
           panic_and_abort("INTERNAL Expression chain in call expression should only contain call expressions or procedure names");
         }
@@ -266,7 +417,7 @@ bool Resolver::resolve_expression(Expr* expr, const Environment*  scope) {
     }
     case ExprType::MEMBER: {
       // @todo member lookup
-      auto member = static_cast<Member_Expr*>(expr);
+      auto member = ast->get<Member_Expr>(expr);
       resolve_expression(member->expression, scope);
       break;
     }
@@ -277,15 +428,70 @@ bool Resolver::resolve_expression(Expr* expr, const Environment*  scope) {
   return true;
 }
 
+// the declaration the name refers to from scope, as an address relative to the frame of scope
+bool Resolver::resolve_variable(Symbol name, int scope, int offset, Var_Address* address) {
+  const Scope* from = scopes.scope(scope);
+
+  const Variable* declaration = NULL;
+  const Scope* search = from;
+  for (int index = scope; index != -1; index = search->parent_index) {  // up to the global scope
+    search = scopes.scope(index);
+    declaration = scopes.get_variable(index, name);
+    if (declaration) break;
+  }
+
+  if (!declaration) {
+    char buff[1024];
+    null_terminate(symbol_name(name), buff);
+    errorf(source_line(offset), "Use of undeclared variable %s", buff);
+    return false;
+  }
+
+  address->slot = declaration->slot;
+  if (search->frame == -1) {
+    address->kind = Var_Address::GLOBAL;
+    address->depth = 0;
+    add_dependency(DEPENDENCY_GLOBAL | declaration->slot);
+  } else {
+    address->kind = Var_Address::LOCAL;
+    address->depth = scopes.frames.get_ref(from->frame)->depth - scopes.frames.get_ref(search->frame)->depth;
+  }
+
+  return true;
+}
+
+// binds the name in the current scope and gives it the next slot of its frame
+Var_Address Resolver::declare_variable(Symbol name, Type_ID type) {
+  const Scope* scope = scopes.scope(current_environment);
+
+  Variable var;
+  var.type = type;
+
+  Var_Address address;
+  if (scope->frame == -1) {
+    var.slot = (u32)scopes.globals.slots.size;
+    scopes.globals.slots.add(type);
+    scopes.global_names.add(name);
+    address.kind = Var_Address::GLOBAL;
+  } else {
+    Frame_Layout* frame = scopes.frames.get_ref(scope->frame);
+    var.slot = (u32)frame->slots.size;
+    frame->slots.add(type);
+    address.kind = Var_Address::LOCAL;
+  }
+
+  address.slot = var.slot;
+  scopes.bind_variable(current_environment, name, var);
+  return address;
+}
+
 void Resolver::dump_environments() {
-  auto global_scope = environments.data[0];
   printf("global scope:\n");
-  global_scope.dump();
+  scopes.dump(0);
 
-  for (int index = 1; index < environments.size; index++) {
-    auto env = environments.data[index];
-    auto parent_index = env.parent_index;
+  for (int index = 1; index < scopes.scopes.size; index++) {
+    auto parent_index = scopes.scope(index)->parent_index;
     printf("%s environment, child of %s\n", ordinal_string(index), ordinal_string(parent_index));  // debug
-    env.dump();
+    scopes.dump(index);
   }
 }
@@ -4,31 +4,57 @@
 #include "expr.hpp"
 #include "template.hpp"
 #include "stmt.hpp"
+#include "ast.hpp"
 
 #include "environment.hpp"
+#include "dependency.hpp"
 #include "type.hpp"
 
 // resolve names and build a dependency tree
 struct Resolver {
-    DArray<Environment> environments;
-    ArrayView<Stmt*> program;
+    Linear_Allocator* arena;  // the scopes live as long as the ast
+    Scope_Table scopes;
+    Ast* ast;
 
-    // @todo dependency tree
+    // what each procedure and global initializer uses, collected while resolving and built into the graph at the end
+    DArray<Dependency_Edge> dependency_edges;
+    u32 current_dependent = DEPENDENCY_ROOT;  // the declaration whose references are being resolved
+    Dependency_Graph dependencies;
 
     int current_environment = 0;
-    //Environment* current_environment = NULL;
 
-    Resolver(ArrayView<Stmt*> program) : program(program) {}
+    // skipped procedure bodies that are called from a resolved one, they are parsed and resolved in this order
+    DArray<Stmt_ID> requested_bodies;
+    bool body_parse_failed = false;  // a requested body didn't parse on its own, the program is parsed again whole
+    bool had_parse_error = false;  // in the program parsed again, there is nothing to go on with
 
-    ArrayView<Environment> resolve();
+    size_t thread_count = 1;  // the references of the top level statements are resolved on this many threads
+    bool defer_requests = false;  // only note requested bodies, the resolver that started this one requests them
+
+    Resolver(Ast* ast, Linear_Allocator* arena) : arena(arena), scopes(arena), ast(ast), dependency_edges(arena), requested_bodies(arena) {}
+
+    // resolves references for the resolver on another thread, the scopes are shared and only read
+    Resolver(const Resolver* shared) : arena(NULL), scopes(shared->scopes), ast(shared->ast), defer_requests(true) {}
+
+    const Scope_Table* resolve();
+    void resolve_program();
 
     void collect_declarations();
-    void collect_declaration(Stmt* stmt);
+    void collect_declaration(Stmt_ID stmt);
+    ArrayView<Variable> bind_parameters(Decl_Proc_Stmt* decl_proc);
 
-    bool resolve_expression(Expr* expr, const Environment* begin_scope);
+    bool resolve_expression(Expr_ID expr, int begin_scope);
+    bool resolve_variable(Symbol name, int scope, int offset, Var_Address* address);
+    Var_Address declare_variable(Symbol name, Type_ID type);
 
-    void resolve_reference(Stmt* stmt);
+
+    void resolve_reference(Stmt_ID stmt);
     void resolve_references();
 
+    void add_dependency(u32 dependency);
+
+    void request_body(Stmt_ID proc);
+    void resolve_requested_bodies();
+
     void dump_environments();
 };
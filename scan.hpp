@@ -0,0 +1,162 @@
+#pragma once
+
+#include "common.hpp"
+
+// bulk character class scanning for the lexer.
+// every scanner takes a position inside data[0..size) and returns the position of the first byte
+// that doesn't belong to the scanned run (or size).
+// with AVX2 we look at 32 bytes at a time, with SSE2 16 at a time, anything that doesn't fit in a block
+// (and everything if neither is available or SCAN_SCALAR is defined) goes through the scalar loop.
+
+#if !defined(SCAN_SCALAR) && defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_SIMD
+typedef __m256i scan_block_t;
+static const size_t SCAN_WIDTH = 32;
+
+static inline scan_block_t scan_load(const char* p) { return _mm256_loadu_si256((const __m256i*)p); }
+static inline scan_block_t scan_eq(scan_block_t b, char c) { return _mm256_cmpeq_epi8(b, _mm256_set1_epi8(c)); }
+static inline scan_block_t scan_or(scan_block_t a, scan_block_t b) { return _mm256_or_si256(a, b); }
+// lo <= b <= hi, signed compare so bytes >= 0x80 never match which is what we want for ascii classes
+static inline scan_block_t scan_in_range(scan_block_t b, char lo, char hi) {
+  return _mm256_and_si256(_mm256_cmpgt_epi8(b, _mm256_set1_epi8(lo - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), b));
+}
+static inline uint32_t scan_mask(scan_block_t b) { return (uint32_t)_mm256_movemask_epi8(b); }
+static inline scan_block_t scan_to_lower(scan_block_t b) { return _mm256_or_si256(b, _mm256_set1_epi8(0x20)); }
+#elif !defined(SCAN_SCALAR) && defined(__SSE2__)
+#include <emmintrin.h>
+#define SCAN_SIMD
+typedef __m128i scan_block_t;
+static const size_t SCAN_WIDTH = 16;
+
+static inline scan_block_t scan_load(const char* p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline scan_block_t scan_eq(scan_block_t b, char c) { return _mm_cmpeq_epi8(b, _mm_set1_epi8(c)); }
+static inline scan_block_t scan_or(scan_block_t a, scan_block_t b) { return _mm_or_si128(a, b); }
+static inline scan_block_t scan_in_range(scan_block_t b, char lo, char hi) {
+  return _mm_and_si128(_mm_cmpgt_epi8(b, _mm_set1_epi8(lo - 1)), _mm_cmplt_epi8(b, _mm_set1_epi8(hi + 1)));
+}
+static inline uint32_t scan_mask(scan_block_t b) { return (uint32_t)_mm_movemask_epi8(b); }
+static inline scan_block_t scan_to_lower(scan_block_t b) { return _mm_or_si128(b, _mm_set1_epi8(0x20)); }
+#endif
+
+#ifdef SCAN_SIMD
+static const uint32_t SCAN_FULL_MASK = (SCAN_WIDTH == 32) ? 0xFFFFFFFFu : 0xFFFFu;
+#endif
+
+// ' ', '\t' and '\n' are the only whitespace the lexer knows about
+static inline size_t scan_whitespace(const char* data, size_t position, size_t size) {
+  size_t i = position;
+#ifdef SCAN_SIMD
+  for (; i + SCAN_WIDTH <= size; i += SCAN_WIDTH) {
+    scan_block_t block = scan_load(data + i);
+    scan_block_t ws = scan_or(scan_eq(block, '\n'), scan_or(scan_eq(block, ' '), scan_eq(block, '\t')));
+    uint32_t other = ~scan_mask(ws) & SCAN_FULL_MASK;
+    if (other) return i + __builtin_ctz(other);
+  }
+#endif
+  for (; i < size; i++) {
+    char c = data[i];
+    if (c != '\n' && c != ' ' && c != '\t') break;
+  }
+  return i;
+}
+
+// [a-zA-Z0-9_]*
+static inline size_t scan_identifier(const char* data, size_t position, size_t size) {
+  size_t i = position;
+#ifdef SCAN_SIMD
+  for (; i + SCAN_WIDTH <= size; i += SCAN_WIDTH) {
+    scan_block_t block = scan_load(data + i);
+    scan_block_t ident = scan_or(scan_in_range(scan_to_lower(block), 'a', 'z'),
+                                 scan_or(scan_in_range(block, '0', '9'), scan_eq(block, '_')));
+    uint32_t other = ~scan_mask(ident) & SCAN_FULL_MASK;
+    if (other) return i + __builtin_ctz(other);
+  }
+#endif
+  for (; i < size; i++) {
+    char c = data[i];
+    if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_')) break;
+  }
+  return i;
+}
+
+// [0-9]*
+static inline size_t scan_digits(const char* data, size_t position, size_t size) {
+  size_t i = position;
+#ifdef SCAN_SIMD
+  for (; i + SCAN_WIDTH <= size; i += SCAN_WIDTH) {
+    uint32_t other = ~scan_mask(scan_in_range(scan_load(data + i), '0', '9')) & SCAN_FULL_MASK;
+    if (other) return i + __builtin_ctz(other);
+  }
+#endif
+  for (; i < size; i++) {
+    if (data[i] < '0' || data[i] > '9') break;
+  }
+  return i;
+}
+
+// position of the next '\n' or '\0', size if there is none
+static inline size_t scan_line_end(const char* data, size_t position, size_t size) {
+  size_t i = position;
+#ifdef SCAN_SIMD
+  for (; i + SCAN_WIDTH <= size; i += SCAN_WIDTH) {
+    scan_block_t block = scan_load(data + i);
+    uint32_t end = scan_mask(scan_or(scan_eq(block, '\n'), scan_eq(block, '\0')));
+    if (end) return i + __builtin_ctz(end);
+  }
+#endif
+  for (; i < size; i++) {
+    if (data[i] == '\n' || data[i] == '\0') break;
+  }
+  return i;
+}
+
+// position of the next byte that can start or end a multiline comment ('*' or '/') or '\0', size if there is none
+static inline size_t scan_comment_delimiter(const char* data, size_t position, size_t size) {
+  size_t i = position;
+#ifdef SCAN_SIMD
+  for (; i + SCAN_WIDTH <= size; i += SCAN_WIDTH) {
+    scan_block_t block = scan_load(data + i);
+    uint32_t delim = scan_mask(scan_or(scan_or(scan_eq(block, '*'), scan_eq(block, '/')), scan_eq(block, '\0')));
+    if (delim) return i + __builtin_ctz(delim);
+  }
+#endif
+  for (; i < size; i++) {
+    char c = data[i];
+    if (c == '*' || c == '/' || c == '\0') break;
+  }
+  return i;
+}
+
+// position of the next '"' or '\0', size if there is none
+static inline size_t scan_quote(const char* data, size_t position, size_t size) {
+  size_t i = position;
+#ifdef SCAN_SIMD
+  for (; i + SCAN_WIDTH <= size; i += SCAN_WIDTH) {
+    scan_block_t block = scan_load(data + i);
+    uint32_t end = scan_mask(scan_or(scan_eq(block, '"'), scan_eq(block, '\0')));
+    if (end) return i + __builtin_ctz(end);
+  }
+#endif
+  for (; i < size; i++) {
+    if (data[i] == '"' || data[i] == '\0') break;
+  }
+  return i;
+}
+
+// position of the next byte that can start a string literal or a comment ('"' or '/') or '\0', size if there is none
+static inline size_t scan_quote_or_slash(const char* data, size_t position, size_t size) {
+  size_t i = position;
+#ifdef SCAN_SIMD
+  for (; i + SCAN_WIDTH <= size; i += SCAN_WIDTH) {
+    scan_block_t block = scan_load(data + i);
+    uint32_t end = scan_mask(scan_or(scan_or(scan_eq(block, '"'), scan_eq(block, '/')), scan_eq(block, '\0')));
+    if (end) return i + __builtin_ctz(end);
+  }
+#endif
+  for (; i < size; i++) {
+    char c = data[i];
+    if (c == '"' || c == '/' || c == '\0') break;
+  }
+  return i;
+}
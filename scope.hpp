@@ -2,29 +2,39 @@
 
 #include "type.hpp"
 #include "template.hpp"
+#include "node.hpp"
 struct Value;
-struct Stmt;
-struct Environment;
 
 // we enumarete the variables and procedure inside the same scope
 
 struct Variable {
     int var_id = 0;  // this is assigned by the environment
     Type_ID type = Type::NONE;
+    u32 slot = 0;  // in the frame of its procedure, or the index of a global
+};
+
+// the storage of a procedure's variables: its parameters and then the locals of all of its blocks, in the order the
+// resolver meets them. nested procedures have frames of their own
+struct Frame_Layout {
+    Stmt_ID procedure = STMT_NONE;
+    int parent = -1;  // frame of the procedure this one is nested in, -1 for top level procedures
+    u16 depth = 0;    // number of procedures this one is nested in
+    DArray<Type_ID> slots;  // type of each slot
 };
 
 struct Procedure {
     int proc_id = 0;  // this is assigned by the environment
-    const Environment* procedure_scope;
+    int procedure_scope = -1;  // of the body, in the Scope_Table
     ArrayView<Variable> parameters;
-    ArrayView<Stmt*> body;
-    Type_ID return_type;
+    Stmt_List body;
+    Stmt_ID declaration = STMT_NONE;
+    Type_ID type = Type::NONE;  // its procedure type, from the type table
 
     // proc_flags
     bool is_nested : 1;  // lexically scoped inside a scope
 
-    Procedure() : parameters(NULL, 0),body(NULL, 0) {}
-    Procedure(ArrayView<Stmt*> body, ArrayView<Variable> parameters, const Environment* proc_scope) : procedure_scope(proc_scope), parameters(parameters), body(body) {}
+    Procedure() : parameters(NULL, 0) {}
+    Procedure(Stmt_List body, ArrayView<Variable> parameters, int proc_scope) : procedure_scope(proc_scope), parameters(parameters), body(body) {}
 };
 
 // @todo structures
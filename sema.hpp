@@ -2,7 +2,7 @@
 
 #include "template.hpp"
 
-struct Stmt;
-struct Environment;
+struct Ast;
+struct Scope_Table;
 
-void semantic_analysis(ArrayView<Stmt*>, ArrayView<Environment>);
\ No newline at end of file
+void semantic_analysis(const Ast*, const Scope_Table*);
@@ -1,78 +1,82 @@
 #include "stmt.hpp"
+#include "ast.hpp"
 
-void print_stmt(Stmt* s) {
-    if (!s) panic_and_abort("Internal: called print_stmt with null statement");
+void print_stmt(const Ast* ast, Stmt_ID s) {
+    if (s == STMT_NONE) panic_and_abort("Internal: called print_stmt with null statement");
 
     String_Builder sb(512);
 
-    switch (s->kind) {
+    switch (stmt_kind(s)) {
         case StmtKind::DECL_VAR: {
-            auto stmt = static_cast<Decl_Var_Stmt*>(s);
+            auto stmt = ast->get<Decl_Var_Stmt>(s);
 
             String type_s = String(type_string(stmt->decl.type));
 
             const auto none = String("none");
             String expr_string = String(none);
             sb.clear();
-            if (stmt->initializer) {
-                expression_human_readable_string(stmt->initializer, &sb);
+            if (stmt->initializer != EXPR_NONE) {
+                expression_human_readable_string(ast, stmt->initializer, &sb);
             }
 
             char decl_name[512];
-            null_terminate(stmt->decl.name.lexeme, decl_name);
+            null_terminate(symbol_name(stmt->decl.name), decl_name);
 
             printf("Statement Variable Declaration, declared variable name: %s, type: %s, initilializer: %s\n", decl_name, type_s.data, expr_string.data);
             break;
         }
         case StmtKind::DECL_PROC: {
-            auto proc = static_cast<Decl_Proc_Stmt*>(s);
+            auto proc = ast->get<Decl_Proc_Stmt>(s);
 
             printf("Statement Procedure Declaration:\n");
             char proc_name_nt[1024];
-            null_terminate(proc->name.lexeme, proc_name_nt);
-            printf("Declared procedure name: %s, parameter count: %zu, return count: %zu\n", proc_name_nt, proc->parameters.count, proc->returns.count);
+            null_terminate(symbol_name(proc->name), proc_name_nt);
+            printf("Declared procedure name: %s, parameter count: %u, return count: %u\n", proc_name_nt, proc->parameters.count, proc->returns.count);
 
-            for (int i = 0; i < proc->parameters.count; i++) {
+            auto parameters = ast->list(proc->parameters);
+            for (int i = 0; i < parameters.count; i++) {
                 char buff[1024];
-                null_terminate(proc->parameters.get(i).name.lexeme, buff);
+                null_terminate(symbol_name(parameters.get(i).name), buff);
                 printf("        %dth parameter name: %s\n", i+1, buff);
             }
 
-            for (int i = 0; i < proc->returns.count; i++) {
+            auto returns = ast->list(proc->returns);
+            for (int i = 0; i < returns.count; i++) {
                 char buff[1024];
-                null_terminate(proc->returns.get(i).name.lexeme, buff);
-                printf("        %dth return name, type: %s %s\n", i+1, buff, type_string(proc->returns.get(i).type));
+                null_terminate(symbol_name(returns.get(i).name), buff);
+                printf("        %dth return name, type: %s %s\n", i+1, buff, type_string(returns.get(i).type));
             }
 
-            printf("Statement body has %zu statements\n", proc->body.count);
-            for (auto bstmt : proc->body) {
-                print_stmt(bstmt);  // @todo indent?
+            if (proc->body_state != BodyState::PARSED) printf("Statement body is not parsed\n");
+            else printf("Statement body has %u statements\n", proc->body.count);
+            for (auto bstmt : ast->list(proc->body)) {
+                print_stmt(ast, bstmt);  // @todo indent?
             }
 
             printf("End of procedure %s\n", proc_name_nt);
             break;
         }
         case StmtKind::ASSIGN: {
-            auto stmt = static_cast<Assign_Stmt*>(s);
+            auto stmt = ast->get<Assign_Stmt>(s);
 
             printf("Statement Assignment\n");
             char buff[1024];
-            null_terminate(stmt->target.lexeme, buff);
+            null_terminate(symbol_name(stmt->target), buff);
             printf("assignment target : %s\n", buff);
-            if (!stmt->rhs) {
+            if (stmt->rhs == EXPR_NONE) {
                 panic_and_abort("Internal: Invalid assign statement, null source expression (shouldn't have been appended to the ast)");
             }
             printf("assignment source : ");
-            print_expr(stmt->rhs);
+            print_expr(ast, stmt->rhs);
 
             break;
         }
         case StmtKind::BLOCK: {
-            auto stmt = static_cast<Block_Stmt*>(s);
+            auto stmt = ast->get<Block_Stmt>(s);
 
             printf("Block Statement\n");
-            for (auto block_s : stmt->body) {
-                print_stmt(block_s);
+            for (auto block_s : ast->list(stmt->body)) {
+                print_stmt(ast, block_s);
             }
             printf("End Block Statement\n");
 
@@ -80,14 +84,14 @@ void print_stmt(Stmt* s) {
         }
         case StmtKind::IF: {
             printf("If Statement : \n");
-            auto stmt = static_cast<If_Stmt*>(s);
+            auto stmt = ast->get<If_Stmt>(s);
 
             printf("then branch: \n");
-            print_stmt(stmt->then_stmt);
+            print_stmt(ast, stmt->then_stmt);
 
-            if (stmt->else_stmt) {
+            if (stmt->else_stmt != STMT_NONE) {
                 printf("else branch: \n");
-                print_stmt(stmt->else_stmt);
+                print_stmt(ast, stmt->else_stmt);
             }
 
             break;
@@ -98,23 +102,23 @@ void print_stmt(Stmt* s) {
             break;
         }
         case StmtKind::IMPORT: {
-            auto import = static_cast<Import_Stmt*>(s);
+            auto import = ast->get<Import_Stmt>(s);
             char buff[1024];
-            null_terminate(import->module_name.lexeme, buff);
+            null_terminate(symbol_name(import->module_name), buff);
             printf("Import Statement, imported module name %s\n", buff);
             break;
         }
         case StmtKind::EXPRESSION: {
-            auto expr_stmt = static_cast<Expr_Stmt*>(s);
+            auto expr_stmt = ast->get<Expr_Stmt>(s);
             printf("Expression Statement\n");
-            print_expr(expr_stmt->expr);
+            print_expr(ast, expr_stmt->expr);
             break;
         }
         case StmtKind::RETURN: {
-            auto ret_s = static_cast<Return_Stmt*>(s);
+            auto ret_s = ast->get<Return_Stmt>(s);
             printf("Return statement\n");
-            for (auto ret : ret_s->returns) {
-                print_expr(ret);
+            for (auto ret : ast->list(ret_s->returns)) {
+                print_expr(ast, ret);
             }
             break;
         }
@@ -14,83 +14,109 @@ enum class StmtKind {
     IMPORT, RETURN
 };
 
+inline StmtKind stmt_kind(Stmt_ID id) {
+    return (StmtKind)node_kind(id);
+}
+
+// like expressions the kind is in the id, children are ids into the same Ast
 struct Stmt {
-    StmtKind kind;
-    // @volatile maybe an id instead of a direct pointer
-    const Environment* scope = NULL;
+    int scope = -1;  // index of the enclosing environment, filled by the resolver
 };
 
 struct Block_Stmt : Stmt {
-    ArrayView<Stmt*> body;
+    static const StmtKind KIND = StmtKind::BLOCK;
 
-    Block_Stmt(Stmt* const * data, size_t count) : body(data, count) { kind = StmtKind::BLOCK; }
+    Stmt_List body;
 };
 
 // this exists because we want to use these both in the parameter list and variable declaration
 struct Decl_Var {
-    Token name;
+    Symbol name = SYMBOL_NONE;
+    int offset = 0;  // of the name
     Type_ID type = Type::NONE;
+
+    int line() const {
+        return source_line(offset);
+    }
 };
 
 struct Decl_Var_Stmt : Stmt {
+    static const StmtKind KIND = StmtKind::DECL_VAR;
+
     Decl_Var decl;
-    Expr* initializer = NULL;
-    int var_id;
+    Expr_ID initializer = EXPR_NONE;
+    Var_Address address;  // of the declared variable
+};
 
-    Decl_Var_Stmt() { kind = StmtKind::DECL_VAR; }
+// a lazy parse skips the bodies of top level procedures, they are parsed when something needs them (parse_body)
+enum class BodyState : u8 {
+    PARSED,
+    SKIPPED,
+    REQUESTED,  // waiting to be parsed by the resolver
 };
 
 struct Decl_Proc_Stmt : Stmt {
-    Token name;
-    ArrayView<Decl_Var> parameters;
-    ArrayView<Decl_Var> returns;
-    ArrayView<Stmt*> body;
-    int proc_id;
-
-    Decl_Proc_Stmt() : parameters(NULL, 0), returns(NULL, 0), body(NULL, 0) { kind = StmtKind::DECL_PROC; }
+    static const StmtKind KIND = StmtKind::DECL_PROC;
+
+    Symbol name = SYMBOL_NONE;
+    int offset = 0;  // of the name
+    int end_offset = 0;  // of the closing }
+    Decl_List parameters;
+    Decl_List returns;
+    Stmt_List body;
+    int proc_id = 0;
+    int body_scope = -1;  // environment of the parameters and the body
+
+    BodyState body_state = BodyState::PARSED;
+    u32 body_begin = 0;  // first token after the `{` of a skipped body
+    u32 body_end = 0;    // the matching `}`
 };
 
 struct If_Stmt : Stmt {
-    Expr* cond = NULL;       // @todo rename to condition
-    Stmt* then_stmt = NULL;  // @todo rename
-    Stmt* else_stmt = NULL;
+    static const StmtKind KIND = StmtKind::IF;
 
-    If_Stmt() { kind = StmtKind::IF; }
+    Expr_ID cond = EXPR_NONE;       // @todo rename to condition
+    Stmt_ID then_stmt = STMT_NONE;  // @todo rename
+    Stmt_ID else_stmt = STMT_NONE;
 };
 
 struct For_Stmt : Stmt {
-    Expr* condition = NULL;
-    Stmt* body = NULL;
+    static const StmtKind KIND = StmtKind::FOR;
 
-    For_Stmt() { kind = StmtKind::FOR; }
+    Expr_ID condition = EXPR_NONE;
+    Stmt_ID body = STMT_NONE;
 };
 
 struct Assign_Stmt : Stmt {
-    Token target;
-    Expr* rhs = NULL;
+    static const StmtKind KIND = StmtKind::ASSIGN;
 
-    int var_id;
+    Symbol target = SYMBOL_NONE;
+    int offset = 0;  // of the target
+    Expr_ID rhs = EXPR_NONE;
 
-    Assign_Stmt() { kind = StmtKind::ASSIGN; }
+    Var_Address address;  // of the target
 };
 
 struct Expr_Stmt : Stmt {
-    // @todo Expr_Type expr_type;
-    Expr* expr;
+    static const StmtKind KIND = StmtKind::EXPRESSION;
 
-    Expr_Stmt(Expr* expr) : expr(expr) { kind = StmtKind::EXPRESSION; }
+    // @todo Expr_Type expr_type;
+    Expr_ID expr = EXPR_NONE;
 };
 
 struct Import_Stmt : Stmt {
-    Token module_name;
+    static const StmtKind KIND = StmtKind::IMPORT;
 
-    Import_Stmt(Token mod_name) : module_name(mod_name) { kind = StmtKind::IMPORT; }
+    Symbol module_name = SYMBOL_NONE;
+    int offset = 0;
 };
 
 struct Return_Stmt : Stmt {
-    DArray<Expr*> returns;
+    static const StmtKind KIND = StmtKind::RETURN;
 
-    Return_Stmt(DArray<Expr*> return_exprs) : returns(return_exprs) { kind = StmtKind::RETURN; }
+    Expr_List returns;
 };
 
-void print_stmt(Stmt* s);
+struct Ast;
+
+void print_stmt(const Ast* ast, Stmt_ID s);
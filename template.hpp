@@ -1,6 +1,11 @@
 #pragma once
 
 #include "common.hpp"
+#include "linear_allocator.h"
+
+#include <new>
+#include <utility>
+#include <type_traits>
 
 template <typename T>
 struct ArrayView {
@@ -38,17 +43,53 @@ struct ArrayView {
   }
 };
 
+// storage of the growable arrays below. the elements are only constructed when they are added, growing moves them
+// (a realloc for the ones that can be copied as bytes) and nothing is allocated until the first one is added.
+// copying an array copies the handle, not the elements, like the rest of the views here
+template <typename T>
+T* array_grow(T* data, size_t size, size_t capacity, Linear_Allocator* arena) {
+  if (std::is_trivially_copyable<T>::value) {
+    if (!arena) return (T*)realloc_or_die(data, capacity * sizeof(T));
+
+    T* grown = arena_array<T>(arena, capacity);
+    if (size) memcpy((void*)grown, (const void*)data, size * sizeof(T));
+    return grown;  // the old storage goes away with the arena
+  }
+
+  T* grown = arena ? arena_array<T>(arena, capacity) : (T*)malloc_or_die(capacity * sizeof(T));
+  for (size_t i = 0; i < size; i++) {
+    new (&grown[i]) T(std::move(data[i]));
+    data[i].~T();
+  }
+
+  if (!arena) ::free(data);
+  return grown;
+}
+
+template <typename T>
+void array_destroy(T* data, size_t size) {
+  if (std::is_trivially_destructible<T>::value) return;
+  for (size_t i = 0; i < size; i++) data[i].~T();
+}
+
 template<typename T>
 struct DArray {
-  T* data;
-  size_t size;
-  size_t capacity;
+  T* data = NULL;
+  size_t size = 0;
+  size_t capacity = 0;
+  Linear_Allocator* arena = NULL;  // if set the storage comes from here and goes away with the arena
+
+  DArray() = default;
+
+  DArray(size_t init_cap) {
+    if (init_cap) resize_storage(init_cap);
+  }
 
-  DArray() : size(0), capacity(8) {
-    data = new T[8];
+  DArray(Linear_Allocator* arena, size_t init_cap = 0) : arena(arena) {
+    if (init_cap) resize_storage(init_cap);
   }
 
-  T get(size_t index) const {
+  T& get(size_t index) {
     if (index >= size) {
       panic_and_abort("Index out of range");
     }
@@ -56,13 +97,15 @@ struct DArray {
     return data[index];
   }
 
-  DArray(size_t init_cap) {
-    data = new T[init_cap];
-    size = 0;
-    capacity = init_cap;
+  const T& get(size_t index) const {
+    return const_cast<DArray*>(this)->get(index);
+  }
+
+  T& operator[](size_t index) {
+    return data[index];
   }
 
-  T operator[](size_t index) const {
+  const T& operator[](size_t index) const {
     return data[index];
   }
 
@@ -75,31 +118,45 @@ struct DArray {
   }
 
   void add(const T& element) {
-    ensure_capacity(size);
+    if (size == capacity) {
+      T copy = element;  // it may be one of ours
+      grow(size + 1);
+      new (&data[size]) T(std::move(copy));
+    } else {
+      new (&data[size]) T(element);
+    }
+
+    size++;
+  }
+
+  void add(T&& element) {
+    if (size == capacity) {
+      T moved = std::move(element);
+      grow(size + 1);
+      new (&data[size]) T(std::move(moved));
+    } else {
+      new (&data[size]) T(std::move(element));
+    }
 
-    data[size] = element;
     size++;
   }
 
   void free() {
-    delete[] data;
+    array_destroy(data, size);
+    if (!arena) ::free(data);
+
+    data = NULL;
+    size = 0;
+    capacity = 0;
   }
 
   T* last() const {
     return data + size - 1;
   }
 
+  // room for p_capacity + 1 elements
   void ensure_capacity(size_t p_capacity) {
-    if (capacity <= p_capacity) {
-      T* ndata = new T[capacity * 2];
-      for (size_t i = 0; i < size; i++) {
-        ndata[i] = data[i];
-      }
-
-      delete[] data;
-      data = ndata;
-      capacity *= 2;
-    }
+    if (capacity <= p_capacity) grow(p_capacity + 1);
   }
 
   T pop() {
@@ -108,14 +165,16 @@ struct DArray {
     }
 
     size--;
-    return data[size];
+    T element = std::move(data[size]);
+    data[size].~T();
+    return element;
   }
 
-  T* begin() {
+  T* begin() const {
     return data;
   }
 
-  T* end() {
+  T* end() const {
     return data + size;
   }
 
@@ -128,6 +187,302 @@ struct DArray {
 
     return -1;
   }
+
+private:
+  void grow(size_t needed) {
+    size_t new_capacity = capacity ? capacity * 2 : 8;
+    while (new_capacity < needed) new_capacity *= 2;
+    resize_storage(new_capacity);
+  }
+
+  void resize_storage(size_t new_capacity) {
+    data = array_grow(data, size, new_capacity, arena);
+    capacity = new_capacity;
+  }
+};
+
+// a DArray that keeps its first N elements inline, for the lists that are almost always short.
+// the inline part isn't pointed to, so the array can be moved around as bytes like the other handles
+template <typename T, size_t N>
+struct Small_Array {
+  static_assert(std::is_trivially_copyable<T>::value, "Small_Array is for plain data");
+
+  T inline_data[N];
+  T* heap_data = NULL;  // once there are more than N
+  size_t size = 0;
+  size_t capacity = N;
+  Linear_Allocator* arena = NULL;  // of the spilled storage
+
+  Small_Array() = default;
+  Small_Array(Linear_Allocator* arena) : arena(arena) {}
+
+  T* data() { return capacity > N ? heap_data : inline_data; }
+  const T* data() const { return capacity > N ? heap_data : inline_data; }
+
+  T& operator[](size_t index) { return data()[index]; }
+  const T& operator[](size_t index) const { return data()[index]; }
+
+  T& get(size_t index) {
+    if (index >= size) {
+      panic_and_abort("Index out of range (Small_Array)");
+    }
+
+    return data()[index];
+  }
+
+  const T& get(size_t index) const {
+    return const_cast<Small_Array*>(this)->get(index);
+  }
+
+  void add(const T& element) {
+    if (size == capacity) {
+      T copy = element;
+      size_t new_capacity = capacity * 2;
+      T* grown = arena ? arena_array<T>(arena, new_capacity) : (T*)malloc_or_die(new_capacity * sizeof(T));
+      memcpy((void*)grown, (const void*)data(), size * sizeof(T));
+      if (capacity > N && !arena) ::free(heap_data);
+
+      heap_data = grown;
+      capacity = new_capacity;
+      heap_data[size] = copy;
+    } else {
+      data()[size] = element;
+    }
+
+    size++;
+  }
+
+  void free() {
+    if (capacity > N && !arena) ::free(heap_data);
+    heap_data = NULL;
+    size = 0;
+    capacity = N;
+  }
+
+  ArrayView<T> view() const {
+    return ArrayView<T>(data(), size);
+  }
+
+  T* begin() { return data(); }
+  T* end() { return data() + size; }
+  const T* begin() const { return data(); }
+  const T* end() const { return data() + size; }
+};
+
+// hashing and comparing the keys of a Hash_Map, specialized for the kinds of keys there are
+template <typename K>
+struct Hash_Traits;
+
+// integers and interned symbols, the ids are dense so the multiply is mostly there to move the high bits down
+template <>
+struct Hash_Traits<u32> {
+  static u64 hash(u32 key) {
+    u64 hash = key * 0x9e3779b97f4a7c15;
+    return hash ^ (hash >> 32);
+  }
+
+  static bool equal(u32 a, u32 b) { return a == b; }
+};
+
+// the murmur3 finalizer, keys made of parts like (scope << 32) | symbol need every bit mixed into the low ones
+template <>
+struct Hash_Traits<u64> {
+  static u64 hash(u64 key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccd;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53;
+    key ^= key >> 33;
+    return key;
+  }
+
+  static bool equal(u64 a, u64 b) { return a == b; }
+};
+
+// the map doesn't copy the characters, they have to outlive it (interned names and the source do)
+template <>
+struct Hash_Traits<String> {
+  static u64 hash(String key) { return hash_string(key); }
+  static bool equal(String a, String b) { return a.size == b.size && memcmp(a.data, b.data, a.size) == 0; }
+};
+
+// open addressing with robin hood linear probing. an entry that is further from its home slot takes the place of one
+// that is closer to its own, so every probe sequence is short and a lookup can stop as soon as it passes entries that
+// are closer to home than the key would be. removing shifts the following entries back instead of leaving tombstones.
+// the probe distances are kept in a byte array of their own so the probe mostly touches that.
+// keys and values are copied as bytes, like Small_Array
+template <typename K, typename V, typename Traits = Hash_Traits<K>>
+struct Hash_Map {
+  static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value, "Hash_Map is for plain data");
+
+  struct Entry {
+    K key;
+    V value;
+  };
+
+  Entry* entries = NULL;
+  u8* distances = NULL;   // of each slot from where its key hashes to plus one, 0 for an empty slot
+  size_t capacity = 0;    // power of 2
+  size_t count = 0;
+  Linear_Allocator* arena = NULL;  // if set the storage comes from here and goes away with the arena
+
+  Hash_Map() = default;
+  Hash_Map(Linear_Allocator* arena) : arena(arena) {}
+
+  // NULL if the key isn't there. good until the next insert or remove
+  V* get(const K& key) const {
+    if (!count) return NULL;
+
+    size_t mask = capacity - 1;
+    size_t slot = Traits::hash(key) & mask;
+    for (u32 distance = 1;; distance++, slot = (slot + 1) & mask) {
+      if (distances[slot] < distance) return NULL;  // an empty slot or one closer to home than the key would be
+      if (distances[slot] == distance && Traits::equal(entries[slot].key, key)) return &entries[slot].value;
+    }
+  }
+
+  bool contains(const K& key) const {
+    return get(key) != NULL;
+  }
+
+  // adds the key or replaces its value
+  V* put(const K& key, const V& value) {
+    bool added;
+    V* slot = find_or_add(key, &added);
+    *slot = value;
+    return slot;
+  }
+
+  // the value of the key, a new key gets an uninitialized value for the caller to fill in
+  V* find_or_add(const K& key, bool* added) {
+    if (V* value = get(key)) {
+      *added = false;
+      return value;
+    }
+
+    *added = true;
+    if ((count + 1) * 8 > capacity * 7) grow();
+
+    Entry entry;
+    entry.key = key;
+    count++;
+
+    size_t index = place(entry);
+    if (index != (size_t)-1) return &entries[index].value;
+    return get(key);  // the table grew while placing it
+  }
+
+  // room for this many entries without growing, for filling a map with a known number of keys
+  void reserve(size_t entry_count) {
+    while (entry_count * 8 > capacity * 7) grow();
+  }
+
+  bool remove(const K& key) {
+    V* value = get(key);
+    if (!value) return false;
+
+    size_t mask = capacity - 1;
+    size_t slot = (Entry*)((char*)value - offsetof(Entry, value)) - entries;
+    size_t next = (slot + 1) & mask;
+    while (distances[next] > 1) {  // shift back everything that isn't at home
+      entries[slot] = entries[next];
+      distances[slot] = distances[next] - 1;
+      slot = next;
+      next = (next + 1) & mask;
+    }
+
+    distances[slot] = 0;
+    count--;
+    return true;
+  }
+
+  void clear() {
+    if (capacity) memset(distances, 0, capacity);
+    count = 0;
+  }
+
+  void free() {
+    if (!arena) {
+      ::free(entries);
+      ::free(distances);
+    }
+
+    entries = NULL;
+    distances = NULL;
+    capacity = 0;
+    count = 0;
+  }
+
+  // calls visit(key, value) for every entry, in no particular order
+  template <typename F>
+  void for_each(F visit) const {
+    for (size_t i = 0; i < capacity; i++) {
+      if (distances[i]) visit(entries[i].key, entries[i].value);
+    }
+  }
+
+private:
+  // robin hood insertion of an entry whose key isn't in the table, the index it ended up at. when a probe gets longer
+  // than a byte can say the table grows and the entry being carried (the new one or one it moved) goes into the bigger
+  // one, -1 is returned then since the index of the new one changed
+  size_t place(Entry entry) {
+    size_t placed = (size_t)-1;
+    bool grew = false;
+
+    while (true) {
+      size_t mask = capacity - 1;
+      size_t slot = Traits::hash(entry.key) & mask;
+
+      for (u32 distance = 1; distance <= 255; distance++, slot = (slot + 1) & mask) {
+        if (distances[slot] == 0) {
+          entries[slot] = entry;
+          distances[slot] = (u8)distance;
+          if (placed == (size_t)-1) placed = slot;
+          return grew ? (size_t)-1 : placed;
+        }
+
+        if (distances[slot] < distance) {
+          Entry swapped_entry = entries[slot];
+          u32 swapped_distance = distances[slot];
+          entries[slot] = entry;
+          distances[slot] = (u8)distance;
+          if (placed == (size_t)-1) placed = slot;
+
+          entry = swapped_entry;
+          distance = swapped_distance;
+        }
+      }
+
+      grow();
+      grew = true;
+    }
+  }
+
+  void grow() {
+    Entry* old_entries = entries;
+    u8* old_distances = distances;
+    size_t old_capacity = capacity;
+
+    capacity = capacity ? capacity * 2 : 16;
+    if (arena) {
+      entries = arena_array<Entry>(arena, capacity);
+      distances = arena_array<u8>(arena, capacity);
+    } else {
+      entries = (Entry*)malloc_or_die(capacity * sizeof(Entry));
+      distances = (u8*)malloc_or_die(capacity);
+    }
+    memset(distances, 0, capacity);
+
+    // placing one can grow the table again, these old ones still go in the newest
+    for (size_t i = 0; i < old_capacity; i++) {
+      if (old_distances[i]) place(old_entries[i]);
+    }
+
+    if (!arena) {
+      ::free(old_entries);
+      ::free(old_distances);
+    }
+  }
 };
 
 template<typename T>
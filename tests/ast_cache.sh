@@ -0,0 +1,52 @@
+#!/bin/sh
+# a tree that comes from the cache directory reports the same as one that was parsed
+# usage: ast_cache.sh <compiler>
+compiler=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+failed=0
+
+# same <name>: the cold and the warm run of $dir/<name>.tpz print and report what the run without the cache does
+same() {
+  "$compiler" -stdout "$dir/$1.tpz" > "$dir/$1.out" 2> "$dir/$1.err"
+  plain_status=$?
+
+  for run in cold warm; do
+    "$compiler" -stdout -cache-dir "$dir/$1.cache" "$dir/$1.tpz" > "$dir/$1.$run.out" 2> "$dir/$1.$run.err"
+    status=$?
+    if [ $status -ne $plain_status ] || ! cmp -s "$dir/$1.$run.err" "$dir/$1.err" ||
+       ! grep -v cache_dir "$dir/$1.$run.out" | cmp -s - "$dir/$1.out"; then
+      echo "$1: the $run run differs from the one without the cache (exit $status and $plain_status)"
+      diff "$dir/$1.$run.err" "$dir/$1.err"
+      failed=1
+    fi
+  done
+}
+
+# the lexer warns about the comment at the end without a newline
+printf 'proc main() {\n var x : int = 1;\n}\n// trailing' > "$dir/trailing_comment.tpz"
+same trailing_comment
+
+# corrupt <name> <section>: after the cold run the first element of the section (the program range with -1) is an id out
+# of every pool, the warm run has to take that as a miss
+corrupt() {
+  cp "$dir/ids.tpz" "$dir/$1.tpz"
+  "$compiler" -stdout -cache-dir "$dir/$1.cache" "$dir/$1.tpz" > /dev/null 2>&1
+
+  entry=$(ls "$dir/$1.cache/"*.ast)
+  if [ $2 -lt 0 ]; then
+    at=44  # count of the program range in the header
+  else
+    at=$(od -An -t u8 -j $((48 + $2 * 16)) -N 8 "$entry" | tr -d ' ')  # sections start after it, offset and count
+  fi
+  printf '\377\377\377\017' | dd of="$entry" bs=1 seek=$at conv=notrunc 2> /dev/null
+
+  same $1
+}
+
+printf 'proc main() {\n var x : int = 1;\n var y : int = x + 2;\n}\n' > "$dir/ids.tpz"
+corrupt program -1
+corrupt stmt_lists 17
+corrupt token_offsets 20
+
+exit $failed
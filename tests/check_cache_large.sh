@@ -0,0 +1,39 @@
+#!/bin/sh
+# the typecheck results of a file with many top level procedures go through the cache directory and come back
+# usage: check_cache_large.sh <compiler>
+compiler=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+# no main, so every procedure is checked. every 100th one has an error to replay
+i=0
+while [ $i -lt 20000 ]; do
+  if [ $((i % 100)) -eq 0 ]; then
+    echo "proc p$i(n : int) { var a : float = n; }"
+  else
+    echo "proc p$i(n : int) { var a : int = n + $i; }"
+  fi
+  i=$((i + 1))
+done > "$dir/many.tpz"
+
+# the runs with the cache have to end the same way as the one without
+"$compiler" -stdout "$dir/many.tpz" > "$dir/plain.out" 2> "$dir/plain.err"
+plain_status=$?
+
+for run in cold warm; do
+  "$compiler" -stdout -cache-dir "$dir/cache" "$dir/many.tpz" > "$dir/$run.out" 2> "$dir/$run.err"
+  status=$?
+  if [ $status -ne $plain_status ]; then
+    echo "$run run with the cache exited with $status instead of $plain_status"
+    tail -n 5 "$dir/$run.err"
+    exit 1
+  fi
+
+  grep -v cache_dir "$dir/$run.out" | cmp -s - "$dir/plain.out" || { echo "$run run printed something else"; exit 1; }
+  cmp -s "$dir/$run.err" "$dir/plain.err" || { echo "$run run reported something else"; exit 1; }
+done
+
+"$compiler" -stdout -cache-dir "$dir/cache" -v "$dir/many.tpz" 2> /dev/null | grep -q "^0 procedures checked, 20000 had a result" || {
+  echo "the warm run checked procedures again"
+  exit 1
+}
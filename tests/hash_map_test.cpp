@@ -0,0 +1,109 @@
+#define LA_IMPLEMENTATION
+#include "../linear_allocator.h"
+#include "../template.hpp"
+
+// Hash_Map with key sets that make long probes: copying a map in its own iteration order into a fresh one puts the
+// keys down in the order of their home slots, and the keys of the scope table are (scope << 32) | symbol
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+  if (!condition) {
+    fprintf(stderr, "FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+// no mixing at all, so keys can be made to land in the same slot
+struct Identity_Traits {
+  static u64 hash(u64 key) { return key; }
+  static bool equal(u64 a, u64 b) { return a == b; }
+};
+
+static u64 next_random(u64* state) {  // splitmix64
+  u64 z = (*state += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+static void copy_in_iteration_order(const DArray<u64>& keys, const char* what) {
+  Hash_Map<u64, u32> map;
+  for (size_t i = 0; i < keys.size; i++) map.put(keys.data[i], (u32)i);
+
+  Hash_Map<u64, u32> copy;
+  map.for_each([&](u64 key, u32 value) { copy.put(key, value); });
+
+  bool same = copy.count == map.count;
+  for (size_t i = 0; i < keys.size && same; i++) {
+    const u32* value = copy.get(keys.data[i]);
+    same = value && *value == (u32)i;
+  }
+  check(same, what);
+
+  // and into one with the room reserved up front
+  Hash_Map<u64, u32> reserved;
+  reserved.reserve(map.count);
+  size_t capacity = reserved.capacity;
+  map.for_each([&](u64 key, u32 value) { reserved.put(key, value); });
+  check(reserved.count == map.count && reserved.capacity == capacity, "reserve makes room for every entry");
+
+  map.free();
+  copy.free();
+  reserved.free();
+}
+
+int main() {
+  u64 state = 1;
+
+  DArray<u64> keys;
+  for (int i = 0; i < 10000; i++) keys.add(next_random(&state));
+  copy_in_iteration_order(keys, "copy of 10k random keys");
+  keys.free();
+
+  for (int i = 0; i < 100000; i++) keys.add((u64)i);
+  copy_in_iteration_order(keys, "copy of 100k sequential keys");
+  keys.free();
+
+  for (u64 scope = 0; scope < 200; scope++) {
+    for (u64 symbol = 1; symbol <= 500; symbol++) keys.add((scope << 32) | symbol);
+  }
+  copy_in_iteration_order(keys, "copy of 100k scope and symbol keys");
+  keys.free();
+
+  // 300 keys with the same home slot until the table has 4096 slots, more than a probe distance can say
+  Hash_Map<u64, u32, Identity_Traits> crowded;
+  for (u64 i = 0; i < 300; i++) crowded.put(i << 12, (u32)i);
+  bool found = crowded.count == 300;
+  for (u64 i = 0; i < 300 && found; i++) found = crowded.get(i << 12) && *crowded.get(i << 12) == (u32)i;
+  check(found, "keys crowding one slot grow the table");
+  crowded.free();
+
+  // adding and removing against a plain table of what should be there
+  const u64 key_range = 5000;
+  bool* present = (bool*)calloc(key_range, sizeof(bool));
+  size_t present_count = 0;
+  Hash_Map<u64, u32> map;
+  for (int round = 0; round < 200000; round++) {
+    u64 key = next_random(&state) % key_range;
+    if (round % 3 == 2) {
+      check(map.remove(key) == present[key], "remove finds what was added");
+      if (present[key]) present_count--;
+      present[key] = false;
+    } else {
+      map.put(key, (u32)key);
+      if (!present[key]) present_count++;
+      present[key] = true;
+    }
+  }
+
+  bool all = map.count == present_count;
+  for (u64 key = 0; key < key_range && all; key++) all = map.contains(key) == present[key];
+  check(all, "random adds and removes");
+  map.free();
+  free(present);
+
+  if (failures) return 1;
+  printf("hash map tests passed\n");
+  return 0;
+}
@@ -0,0 +1,49 @@
+#!/bin/sh
+# bodies parsed on demand report the same as with -full-check
+# usage: lazy_body_diagnostics.sh <compiler>
+compiler=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+failed=0
+
+# compare <name>: the source is in $dir/<name>.tpz
+compare() {
+  "$compiler" -stdout -c-output "$dir/$1.tpz" > /dev/null 2> "$dir/$1.lazy"
+  lazy_status=$?
+  "$compiler" -stdout -c-output -full-check "$dir/$1.tpz" > /dev/null 2> "$dir/$1.full"
+  full_status=$?
+
+  # stack traces have addresses in them
+  grep -v -e '^/' -e 'compiler(' "$dir/$1.lazy" > "$dir/$1.lazy.f"
+  grep -v -e '^/' -e 'compiler(' "$dir/$1.full" > "$dir/$1.full.f"
+
+  if ! cmp -s "$dir/$1.lazy.f" "$dir/$1.full.f" || [ $lazy_status -ne $full_status ]; then
+    echo "$1: lazy and -full-check differ (exit $lazy_status and $full_status)"
+    diff "$dir/$1.lazy.f" "$dir/$1.full.f"
+    failed=1
+  fi
+}
+
+# the ; after the assignment is an empty statement, which fails the body without a message
+cat > "$dir/empty_statement.tpz" <<'SOURCE'
+var y : int = 1;
+proc f(n : int) int {
+  y = f(y);
+  return n;
+}
+SOURCE
+compare empty_statement
+
+# the failed block makes the whole parse end the body at its }, the rest of the body is top level code then
+printf 'proc main() {\n var s : int = 1;\n if s == 3 { s = 1; }\n var q : int = 2;\n}' > "$dir/inner_brace.tpz"
+compare inner_brace
+
+# the resolve before the body was found broken mustn't report anything of its own
+printf 'var g : int = missing;\nproc main() {\n var s : int = 1;\n if s == 3 { s = 1; }\n var q : int = 2;\n}' > "$dir/held_back.tpz"
+compare held_back
+
+# the local comes before the parameter of the same name
+printf 'proc main(a : int) {\n var a : float = 1.5;\n var b : int = a;\n}' > "$dir/shadowed_parameter.tpz"
+compare shadowed_parameter
+
+exit $failed
@@ -1,19 +1,115 @@
 #include "token.hpp"
+#include "scan.hpp"
 
 #include <cstdio>
 
 void Token::print() const {
-    char lex[512];
-    null_terminate(lexeme, lex);
-    char str[512];
-    null_terminate(value.string(), str);
+    // no fixed size copies, string literals can be arbitrarily long
+    String str = value.string();
     if (type == TokenType::IDENTIFIER) {
-        printf("Token : %s | %s | %s | %d\n", lex, token_type_str(type), str, line);
+        printf("Token : %.*s | %s | %.*s | %d\n", (int)lexeme.size, lexeme.data, token_type_str(type), (int)str.size, str.data, line());
     } else {
-        printf("Token : %s | %s | %d\n", token_type_str(type), str, line);
+        printf("Token : %s | %.*s | %d\n", token_type_str(type), (int)str.size, str.data, line());
     }
 }
 
+void Token_Buffer::append(const Token_Buffer& other) {
+    u32 base = (u32)types.size;
+    for (size_t i = 0; i < other.literal_tokens.size; i++) {
+        literal_tokens.add(base + other.literal_tokens.data[i]);
+        literal_values.add(other.literal_values.data[i]);
+    }
+
+    for (size_t i = 0; i < other.types.size; i++) {
+        Symbol symbol = other.symbols.data[i];
+        if (symbol == SYMBOL_NONE && (TokenType)other.types.data[i] == TokenType::IDENTIFIER) {
+            symbol = intern(other.lexeme(i));
+        }
+        add((TokenType)other.types.data[i], other.offsets.data[i], other.lengths.data[i], symbol);
+    }
+}
+
+void Line_Table::build() {
+    starts.size = 0;
+    starts.add(0);
+
+    size_t position = 0;
+    while (true) {
+        position = scan_line_end(source.data, position, source.size);
+        if (position >= source.size) break;
+
+        position++;  // past the newline (or the null character, which doesn't start a line but also ends lexing)
+        if (source.data[position - 1] == '\n') starts.add((u32)position);
+    }
+
+    built = true;
+}
+
+int Line_Table::line(size_t offset) {
+    if (!built) build();
+
+    // last line start that is <= offset
+    size_t low = 0;
+    size_t high = starts.size;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (starts.data[middle] <= offset) low = middle;
+        else high = middle;
+    }
+
+    return (int)low + 1;
+}
+
+void Line_Table::free() {
+    starts.free();
+}
+
+static Line_Table line_table;
+
+void set_line_source(String source) {
+    line_table.free();
+    line_table = Line_Table(source);
+}
+
+int source_line(size_t offset) {
+    return line_table.line(offset);
+}
+
+void build_source_lines() {
+    if (!line_table.built) line_table.build();
+}
+
+Value Token_Buffer::value(size_t index) const {
+    size_t low = 0;
+    size_t high = literal_tokens.size;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (literal_tokens.data[middle] < index) low = middle + 1;
+        else high = middle;
+    }
+
+    if (low < literal_tokens.size && literal_tokens.data[low] == index) {
+        return literal_values.data[low];
+    }
+
+    return Value();
+}
+
+Token Token_Buffer::get(size_t index) const {
+    TokenType token_type = type(index);
+    String token_lexeme = (token_type == TokenType::END) ? String() : lexeme(index);
+    return Token(token_lexeme, token_type, value(index), (int)offsets.data[index], symbols.data[index]);
+}
+
+void Token_Buffer::free() {
+    types.free();
+    offsets.free();
+    lengths.free();
+    symbols.free();
+    literal_tokens.free();
+    literal_values.free();
+}
+
 // @volatile should match TokenType enum
 static const char* TokenTypeStr[(int)TokenType::COUNT] = {
   "NONE",
@@ -92,7 +188,7 @@ String token_to_string(Token token) {
   sb.append(String(" value : "));
   sb.append(token.value.string());
   sb.append(String(" line : "));
-  sb.appendf("%d", token.line);
+  sb.appendf("%d", token.line());
 
   return sb.to_string();
 }
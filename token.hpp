@@ -1,6 +1,8 @@
 #pragma once
 
 #include "common.hpp"
+#include "template.hpp"
+#include "intern.hpp"
 
 enum class TokenType {
   NONE,
@@ -26,21 +28,111 @@ enum class TokenType {
   COUNT
 };
 
+// offset of the first character of every line of a source, built the first time a line is asked for.
+// nothing but diagnostics and dumps needs lines, everything else carries byte offsets.
+struct Line_Table {
+  String source;
+  DArray<u32> starts;
+  bool built = false;
+
+  Line_Table() = default;
+  Line_Table(String source) : source(source) {}
+
+  void build();
+  int line(size_t offset);  // 1 based
+
+  void free();
+};
+
+// the source that the offsets in tokens and diagnostics refer to, set before lexing it
+void set_line_source(String source);
+int source_line(size_t offset);
+// the table is built on the first lookup, threads that report diagnostics need it built before they start
+void build_source_lines();
+
 struct Token {
   String lexeme;
   TokenType type;
   Value value;
-  int line;
   int offset;
+  Symbol symbol = SYMBOL_NONE;  // identifiers only
 
   Token() = default;
-  Token(String lexeme, TokenType type, Value value, int line, int offset) : lexeme(lexeme), type(type), value(value), line(line), offset(offset) {}
+  Token(String lexeme, TokenType type, Value value, int offset, Symbol symbol = SYMBOL_NONE) : lexeme(lexeme), type(type), value(value), offset(offset), symbol(symbol) {}
+
+  int line() const {
+    return source_line(offset);
+  }
 
   void print() const;
 };
 
 const char* token_type_str(TokenType type);
 
+// packed output of the lexer, one entry per token in each of the parallel arrays.
+// lexemes are slices of the source (which has to outlive the buffer), values only exist for literals
+// and lines are looked up from the offsets when needed.
+struct Token_Buffer {
+  String source;
+
+  DArray<u8> types;
+  DArray<u32> offsets;
+  DArray<u32> lengths;
+  DArray<Symbol> symbols;  // SYMBOL_NONE for everything but identifiers
+
+  // indices of literal tokens in increasing order and their values
+  DArray<u32> literal_tokens;
+  DArray<Value> literal_values;
+
+  // the chunks of a parallel lex leave interning to append, so symbols are handed out in source order from one thread
+  bool intern_identifiers = true;
+
+  Token_Buffer() = default;
+  Token_Buffer(String source) : source(source) {}
+
+  void add(TokenType type, size_t offset, size_t length, Symbol symbol = SYMBOL_NONE) {
+    types.add((u8)type);
+    offsets.add((u32)offset);
+    lengths.add((u32)length);
+    symbols.add(symbol);
+  }
+
+  void add_identifier(size_t offset, size_t length) {
+    Symbol symbol = intern_identifiers ? intern(String(source.data + offset, length)) : SYMBOL_NONE;
+    add(TokenType::IDENTIFIER, offset, length, symbol);
+  }
+
+  void add_literal(TokenType type, size_t offset, size_t length, Value value) {
+    literal_tokens.add((u32)types.size);
+    literal_values.add(value);
+    add(type, offset, length);
+  }
+
+  size_t count() const {
+    return types.size;
+  }
+
+  TokenType type(size_t index) const {
+    if (index >= types.size) {
+      panic_and_abort("Index out of range (Token_Buffer)");
+    }
+
+    return (TokenType)types.data[index];
+  }
+
+  String lexeme(size_t index) const {
+    return String(source.data + offsets.get(index), lengths.get(index));
+  }
+
+  // tokens of another buffer over the same source go after the ones in this one
+  void append(const Token_Buffer& other);
+
+  Value value(size_t index) const;
+  Token get(size_t index) const;
+
+  void free();
+};
+
 enum class Operator {
   NONE = (int)TokenType::NONE,
 
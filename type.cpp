@@ -10,3 +10,213 @@ Type_ID get_basic_type(const TokenType type) {
         default: return Type::NONE;
     }
 }
+
+// a compound type is its kind and the types it is made of, and those are interned already, so two types are the same
+// when those ids are
+struct Type_Info {
+    Type_ID kind;  // TYPE_PROCEDURE, TYPE_ARRAY or TYPE_STRUCTURE
+    u32 first;  // of its members
+    u32 count;
+    u32 parameter_count;  // the members of a procedure are its parameters and then its returns
+    u32 hash;
+    u32 name;  // offset of its type_string in the names
+};
+
+// the keys are type indices, two of them are equal when the types they describe are
+struct Type_Traits {
+    static u64 hash(u32 index);
+    static bool equal(u32 a, u32 b);
+};
+
+struct Type_Table {
+    DArray<Type_Info> types;
+    DArray<Type_ID> members;
+    DArray<Symbol> member_names;  // same index as the members, SYMBOL_NONE except in structures
+    DArray<char> names;
+
+    Hash_Map<u32, Type_ID, Type_Traits> ids;  // of every type, by what it is made of
+};
+
+static Type_Table type_table;
+
+u64 Type_Traits::hash(u32 index) {
+    return type_table.types.data[index].hash;
+}
+
+bool Type_Traits::equal(u32 a, u32 b) {
+    const Type_Info& x = type_table.types.data[a];
+    const Type_Info& y = type_table.types.data[b];
+    if (x.hash != y.hash || x.kind != y.kind || x.count != y.count || x.parameter_count != y.parameter_count) return false;
+
+    return memcmp(type_table.members.data + x.first, type_table.members.data + y.first, x.count * sizeof(Type_ID)) == 0 &&
+           memcmp(type_table.member_names.data + x.first, type_table.member_names.data + y.first, x.count * sizeof(Symbol)) == 0;
+}
+
+static u32 type_index(Type_ID type) {
+    u64 index = type & ~(Type_ID)TYPE_KIND_MASK;
+    if (!(type & TYPE_KIND_MASK) || index >= type_table.types.size) {
+        panic_and_abortf("BUG : %llx is not the id of a compound type", (unsigned long long)type);
+    }
+    return (u32)index;
+}
+
+static const Type_Info& type_info(Type_ID type) {
+    return type_table.types.data[type_index(type)];
+}
+
+static u32 hash_compound(Type_ID kind, u32 parameter_count, const Type_ID* members, const Symbol* names, u32 count) {
+    u64 hash = hash_bytes(&kind, sizeof(kind));
+    hash = hash_bytes(&parameter_count, sizeof(parameter_count), hash);
+    hash = hash_bytes(members, count * sizeof(Type_ID), hash);
+    if (names) hash = hash_bytes(names, count * sizeof(Symbol), hash);
+    return (u32)(hash ^ (hash >> 32));
+}
+
+static void add_type_name(String s) {
+    for (size_t i = 0; i < s.size; i++) type_table.names.add(s.data[i]);
+}
+
+static void add_type_name(Type_ID type) {
+    if (!(type & TYPE_KIND_MASK)) {
+        add_type_name(String(type_string(type)));
+        return;
+    }
+
+    // the name of a compound member is in the names already, they can move as they grow so it is copied by index
+    for (u32 i = type_info(type).name; type_table.names.data[i]; i++) {
+        char c = type_table.names.data[i];
+        type_table.names.add(c);
+    }
+}
+
+// the string is made once when the type is added, type_string is called from the typechecker threads
+static u32 make_type_name(Type_ID kind, u32 parameter_count, const Type_ID* members, const Symbol* names, u32 count) {
+    u32 name = (u32)type_table.names.size;
+
+    if (kind == TYPE_PROCEDURE) {
+        add_type_name(String("proc("));
+        for (u32 i = 0; i < parameter_count; i++) {
+            if (i) add_type_name(String(", "));
+            add_type_name(members[i]);
+        }
+        add_type_name(String(")"));
+        for (u32 i = parameter_count; i < count; i++) {
+            add_type_name(String(i == parameter_count ? " " : ", "));
+            add_type_name(members[i]);
+        }
+    } else if (kind == TYPE_ARRAY) {
+        add_type_name(String("["));
+        add_type_name(members[0]);
+        add_type_name(String("]"));
+    } else {
+        add_type_name(String("{"));
+        for (u32 i = 0; i < count; i++) {
+            if (i) add_type_name(String(", "));
+            add_type_name(symbol_name(names[i]));
+            add_type_name(String(" : "));
+            add_type_name(members[i]);
+        }
+        add_type_name(String("}"));
+    }
+
+    type_table.names.add('\0');
+    return name;
+}
+
+static Type_ID intern_compound(Type_ID kind, u32 parameter_count, const Type_ID* members, const Symbol* names, u32 count) {
+    // the type is added to look it up, if it was there already it is taken back off the end
+    Type_Info info;
+    info.kind = kind;
+    info.first = (u32)type_table.members.size;
+    info.count = count;
+    info.parameter_count = parameter_count;
+    info.hash = hash_compound(kind, parameter_count, members, names, count);
+    info.name = 0;
+
+    for (u32 i = 0; i < count; i++) {
+        type_table.members.add(members[i]);
+        type_table.member_names.add(names ? names[i] : SYMBOL_NONE);
+    }
+
+    u32 index = (u32)type_table.types.size;
+    type_table.types.add(info);
+
+    bool added;
+    Type_ID* id = type_table.ids.find_or_add(index, &added);
+    if (!added) {
+        type_table.types.size--;
+        type_table.members.size -= count;
+        type_table.member_names.size -= count;
+        return *id;
+    }
+
+    type_table.types.data[index].name = make_type_name(kind, parameter_count, members, names, count);
+    *id = kind | index;
+    return *id;
+}
+
+Type_ID procedure_type(ArrayView<Type_ID> parameters, ArrayView<Type_ID> returns) {
+    Small_Array<Type_ID, 8> members;
+    for (size_t i = 0; i < parameters.count; i++) members.add(parameters.data[i]);
+    for (size_t i = 0; i < returns.count; i++) members.add(returns.data[i]);
+
+    Type_ID type = intern_compound(TYPE_PROCEDURE, (u32)parameters.count, members.data(), NULL, (u32)members.size);
+    members.free();
+    return type;
+}
+
+Type_ID array_type(Type_ID element) {
+    return intern_compound(TYPE_ARRAY, 0, &element, NULL, 1);
+}
+
+Type_ID structure_type(ArrayView<Symbol> names, ArrayView<Type_ID> fields) {
+    if (names.count != fields.count) panic_and_abort("BUG : a structure type needs a name for every field");
+    return intern_compound(TYPE_STRUCTURE, 0, fields.data, names.data, (u32)fields.count);
+}
+
+Proc_Type get_proc_type(Type_ID type) {
+    if (!is_procedure_type(type)) panic_and_abort("BUG : get_proc_type on a type that is not a procedure");
+
+    const Type_Info& info = type_info(type);
+    const Type_ID* members = type_table.members.data + info.first;
+    return Proc_Type{ ArrayView<Type_ID>(members, info.parameter_count),
+                      ArrayView<Type_ID>(members + info.parameter_count, info.count - info.parameter_count) };
+}
+
+Struct_Type get_struct_type(Type_ID type) {
+    if (!is_structure_type(type)) panic_and_abort("BUG : get_struct_type on a type that is not a structure");
+
+    const Type_Info& info = type_info(type);
+    return Struct_Type{ ArrayView<Symbol>(type_table.member_names.data + info.first, info.count),
+                        ArrayView<Type_ID>(type_table.members.data + info.first, info.count) };
+}
+
+Type_ID array_element_type(Type_ID type) {
+    if (!is_array_type(type)) panic_and_abort("BUG : array_element_type on a type that is not an array");
+    return type_table.members.data[type_info(type).first];
+}
+
+const char* compound_type_string(Type_ID type) {
+    return type_table.names.data + type_info(type).name;
+}
+
+u64 hash_type(Type_ID type, u64 hash) {
+    Type_ID kind = type & TYPE_KIND_MASK;
+    hash = hash_bytes(&kind, sizeof(kind), hash);
+    if (!kind) return hash_bytes(&type, sizeof(type), hash);
+
+    const Type_Info& info = type_info(type);
+    hash = hash_bytes(&info.count, sizeof(info.count), hash);
+    hash = hash_bytes(&info.parameter_count, sizeof(info.parameter_count), hash);
+    for (u32 i = 0; i < info.count; i++) {
+        Symbol name = type_table.member_names.data[info.first + i];
+        if (name != SYMBOL_NONE) {
+            String text = symbol_name(name);
+            hash = hash_bytes(&text.size, sizeof(text.size), hash);
+            hash = hash_bytes(text.data, text.size, hash);
+        }
+        hash = hash_type(type_table.members.data[info.first + i], hash);
+    }
+
+    return hash;
+}
@@ -2,6 +2,7 @@
 
 #include "common.hpp"
 #include "template.hpp"
+#include "intern.hpp"
 
 enum class TokenType;
 
@@ -9,6 +10,8 @@ enum class TokenType;
 // 00 -> primitives
 // 01 -> procedure types
 // 10 -> structures
+// 11 -> arrays
+// the rest of the bits of those is their index in the type table, see below
 typedef uint64_t Type_ID;
 
 enum Type : Type_ID {
@@ -19,11 +22,14 @@ enum Type : Type_ID {
 // @todo rename
 enum Type_Type_Masks : Type_ID {
     TYPE_PROCEDURE = ((uint64_t)1) << 62,
-    TYPE_STRUCTURE = ((uint64_t)1) << 63
+    TYPE_STRUCTURE = ((uint64_t)1) << 63,
+    TYPE_ARRAY = TYPE_PROCEDURE | TYPE_STRUCTURE,
+    TYPE_KIND_MASK = TYPE_PROCEDURE | TYPE_STRUCTURE
 };
 
 bool is_procedure_type(Type_ID type);
 bool is_structure_type(Type_ID type);
+bool is_array_type(Type_ID type);
 
 const char* type_string(Type_ID type);
 
@@ -33,13 +39,35 @@ Type_ID value_type(const Value& value);
 bool is_basic_type(TokenType type);
 bool is_numeric_type(Type_ID type);
 
-struct Variable;
+// procedure, array and structure types (the compound types) are interned in one table for the whole program, two of
+// them with the same structure get the same id so types are compared by their ids everywhere.
+// the descriptors are in one array and the types they are made of in another, in the order they were interned.
+// types are interned by the resolver as it declares things, which it does on one thread. the table only grows, what
+// is read from it stays the same so any thread can read it
 
-// this is a type like proc(int, float) -> int, bool
+// this is a type like proc(int, float) int, bool
+Type_ID procedure_type(ArrayView<Type_ID> parameters, ArrayView<Type_ID> returns);
+Type_ID array_type(Type_ID element);
+Type_ID structure_type(ArrayView<Symbol> names, ArrayView<Type_ID> fields);  // names and fields are in order
+
+// views into the table, valid until the next type is interned
 struct Proc_Type {
-    DArray<Variable> parameters;
-    DArray<Variable> returns;
+    ArrayView<Type_ID> parameters;
+    ArrayView<Type_ID> returns;
+};
+
+struct Struct_Type {
+    ArrayView<Symbol> names;
+    ArrayView<Type_ID> fields;
 };
 
 // get corresponding actuall proc type from the id
-Proc_Type get_proc_type(Type_ID type);
\ No newline at end of file
+Proc_Type get_proc_type(Type_ID type);
+Struct_Type get_struct_type(Type_ID type);
+Type_ID array_element_type(Type_ID type);
+
+const char* compound_type_string(Type_ID type);  // like proc(int) float, [int] or {x : int, y : float}
+
+// hash of what the type is made of, the same in every run (the ids of compound types depend on the order they were
+// interned in)
+u64 hash_type(Type_ID type, u64 hash);
@@ -1,5 +1,6 @@
 #include "typechecker.hpp"
 #include "resolve.hpp"
+#include "parallel.hpp"
 
 bool is_basic_type(const TokenType type) {
   // @update is_basic_type
@@ -11,15 +12,19 @@ bool type_is_numeric(Type_ID type) {
 }
 
 bool is_procedure_type(Type_ID type) {
-    return type & TYPE_PROCEDURE;
+    return (type & TYPE_KIND_MASK) == TYPE_PROCEDURE;
 }
 
 bool is_structure_type(Type_ID type) {
-    return type & TYPE_STRUCTURE;
+    return (type & TYPE_KIND_MASK) == TYPE_STRUCTURE;
+}
+
+bool is_array_type(Type_ID type) {
+    return (type & TYPE_KIND_MASK) == TYPE_ARRAY;
 }
 
 bool type_convertable_to_boolean(Type_ID type) {
-    return (!is_structure_type(type)) && (!is_procedure_type(type));  // @fixme
+    return (!is_structure_type(type)) && (!is_procedure_type(type)) && (!is_array_type(type));  // @fixme
 }
 
 Type_ID implicit_convert(Type_ID left_type, Type_ID right_type) {
@@ -57,18 +62,36 @@ const char* type_string(Type_ID type) {
     case Type::NIL:
         return "nil";
     default:
+        if (type & TYPE_KIND_MASK) return compound_type_string(type);
         return "non-basic-type";  // @fixme
     }
 }
 
-Type_ID Typechecker::typecheck_expr(Expr* expr) {
+Type_ID Typechecker::variable_type(Var_Address address) const {
+    switch (address.kind) {
+        case Var_Address::GLOBAL:
+            return scopes->globals.slots.get(address.slot);
+        case Var_Address::LOCAL: {
+            int frame = curr_frame;
+            for (u16 i = 0; i < address.depth; i++) {
+                frame = scopes->frames.get_ref(frame)->parent;
+            }
+
+            return scopes->frames.get_ref(frame)->slots.get(address.slot);
+        }
+        default:
+            return Type::NONE;  // the resolver already reported it
+    }
+}
+
+Type_ID Typechecker::typecheck_expr(Expr_ID expr) {
     // @fixme location info
     // @fixme better error messages
-    switch (expr->type) {
+    switch (expr_type(expr)) {
         case ExprType::BINARY: {
-            auto binary = static_cast<Binary_Expr*>(expr);
+            auto binary = ast->get<Binary_Expr>(expr);
             // by the time we reach here this should be collapsed so that is why we can assert that both branches exist
-            assert(binary->left && binary->right);
+            assert(binary->left != EXPR_NONE && binary->right != EXPR_NONE);
             Type_ID left_type = typecheck_expr(binary->left);
             Type_ID right_type = typecheck_expr(binary->right);
             if (left_type == right_type) return left_type;
@@ -82,7 +105,7 @@ Type_ID Typechecker::typecheck_expr(Expr* expr) {
             return type;
         }
         case ExprType::UNARY: {
-            auto unary = static_cast<Unary_Expr*>(expr);
+            auto unary = ast->get<Unary_Expr>(expr);
             Type_ID type = typecheck_expr(unary->operand);
 
             switch (unary->opperator) {
@@ -104,16 +127,16 @@ Type_ID Typechecker::typecheck_expr(Expr* expr) {
             }
         }
         case ExprType::GROUPING: {
-            return typecheck_expr(static_cast<Grouping_Expr*>(expr)->expr);
+            return typecheck_expr(ast->get<Grouping_Expr>(expr)->expr);
         }
         case ExprType::VARIABLE: {
-            auto var_expr = static_cast<Variable_Expr*>(expr);
-            auto variable = curr_env->get_var_from_id(var_expr->var_id);
-            printf("%s\n", type_string(variable.type));
-            return variable.type;
+            auto var_expr = ast->get<Variable_Expr>(expr);
+            Type_ID type = variable_type(var_expr->address);
+            log(type_string(type));
+            return type;
         }
         case ExprType::LITERAL: {
-            auto lit = static_cast<Literal*>(expr);
+            auto lit = ast->get<Literal>(expr);
             return value_type(lit->value);
         }
         case ExprType::CALL: {
@@ -121,30 +144,28 @@ Type_ID Typechecker::typecheck_expr(Expr* expr) {
             // we need types containing detail about return types and argument types of the procedure.
             // a procedure type doesn't do, you need a type like: proc(int, float) -> int, bool;
             panic_and_abort("Typechecking procedure calls not implemented");
-            auto call = static_cast<Call_Expr*>(expr);
 
             Procedure called_proc;
 
             // the only way its an expression that evaluates to a procedure is that that expression to be a procedure that returns a procedure
 
             // we need the procedure name to get the procedure from the environment and we need to get some context
-            DArray<Expr*> stack;
-            stack.add(call);
-            Array<Expr*> arguments = call->arguments;
+            DArray<Expr_ID> stack;
+            stack.add(expr);
             while (true) {
                 auto proc_expr = *stack.last();
 
-                if (proc_expr->type == ExprType::VARIABLE) {
-                    Variable_Expr* proc_name = static_cast<Variable_Expr*>(proc_expr);
+                if (expr_type(proc_expr) == ExprType::VARIABLE) {
+                    auto proc_name = ast->get<Variable_Expr>(proc_expr);
 
-                    // @todo find a way to get these by index instead of dealing with strings somehow
-                    const Procedure* proc = curr_env->get_procedure(proc_name->identifier.lexeme);
+                    const Procedure* proc = scopes->get_procedure(curr_scope, proc_name->identifier);
 
                     if (!proc) {
                         panic_and_abortf("Couldn't get procedure %s should not happen after the resolve stage");
                     }
 
-                    if (!is_procedure_type(proc->return_type)) {
+                    Proc_Type proc_type = get_proc_type(proc->type);
+                    if (proc_type.returns.count != 1 || !is_procedure_type(proc_type.returns.get(0))) {
                         errorf(0, "The procedure doesn't return a procedure in a call expression chain");  // @fixme error message
                     }
 
@@ -156,17 +177,18 @@ Type_ID Typechecker::typecheck_expr(Expr* expr) {
                     while (stack.size > 0) {
                         // all of them should be call expressions
                         auto top = stack.pop();
-                        assert(top->type == ExprType::CALL);
-                        auto upper_call = static_cast<Call_Expr*>(top);
+                        assert(expr_type(top) == ExprType::CALL);
+                        auto upper_call = ast->get<Call_Expr>(top);
 
-                        auto called_proc = curr_env->get_proc_from_id(upper_call->proc_id);
+                        auto called_proc = scopes->get_proc_from_id(upper_call->proc_id);
 
-                        if (upper_call->arguments.size != proc->parameters.count) {
-                            errorf(0, "Expected %d arguments but got %d", proc->parameters.count, upper_call->arguments.size);
+                        auto arguments = ast->list(upper_call->arguments);
+                        if (arguments.count != proc->parameters.count) {
+                            errorf(0, "Expected %d arguments but got %d", proc->parameters.count, arguments.count);
                         }
 
                         for (int i = 0; i < proc->parameters.count; i++) {
-                            Type_ID arg_type = typecheck_expr(upper_call->arguments.get(i));
+                            Type_ID arg_type = typecheck_expr(arguments.get(i));
                             if (proc->parameters.get(i).type != arg_type) {
                                 errorf(0, "Type mismatch on %d%s argument of the procedure call to procedure", ordinal_string(i));  // @fixme error message
                                 stack.free();
@@ -176,16 +198,16 @@ Type_ID Typechecker::typecheck_expr(Expr* expr) {
                     }
 
                     break;  // the outer while loop
-                } else if (proc_expr->type == ExprType::CALL) {
-                    auto call_expr = static_cast<Call_Expr*>(proc_expr);
-                    stack.add(call_expr->expression);
+                } else if (expr_type(proc_expr) == ExprType::CALL) {
+                    stack.add(ast->get<Call_Expr>(proc_expr)->expression);
                 } else {
                     panic_and_abort("Internal: call.expression typechecked to procedure but is not itself a procedure call, this should be a bug");
                 }
             }
 
             stack.free();
-            return called_proc.return_type;
+            Proc_Type called_type = get_proc_type(called_proc.type);
+            return called_type.returns.count ? called_type.returns.get(0) : Type::NONE;  // @todo multiple returns
         }
         case ExprType::MEMBER: {
             panic_and_abort("add structs to the language");
@@ -194,66 +216,127 @@ Type_ID Typechecker::typecheck_expr(Expr* expr) {
     }
 }
 
-bool Typechecker::typecheck(ArrayView<Stmt*> program, ArrayView<Environment> declarations) {
+bool Typechecker::typecheck(Stmt_List program) {
     bool success = true;
 
-    for (auto stmt : program) {
-        bool res = typecheck_statement(stmt);
-        if (!res) {
-            success = false;
+    auto statements = ast->list(program);
+    bool parallel = thread_count > 1 && statements.count >= PARALLEL_MIN_TASKS;
+    if (!parallel && !checks) {
+        for (auto stmt : statements) {
+            bool res = typecheck_statement(stmt);
+            if (!res) {
+                success = false;
+            }
         }
+
+        return success;
+    }
+
+    // with a cache the results are kept through the tasks even on one thread, for what they reported
+    size_t threads = parallel ? thread_count : 1;
+
+    // every top level statement is a task, a worker only reads the tree and the scopes
+    DArray<Typechecker> workers(threads);
+    for (size_t i = 0; i < threads; i++) {
+        workers.add(*this);
     }
+    bool* results = new bool[statements.count];
+    u64* keys = new u64[statements.count];
+    int* lines = new int[statements.count];
+    u32* found = new u32[statements.count];
+
+    if (checks) checks->begin();
+
+    run_tasks(statements.count, threads,
+        [&](size_t worker, size_t index) {
+            Stmt_ID stmt = statements.get(index);
+            found[index] = CHECK_NONE;
+            keys[index] = 0;
+
+            // procedures the cache knows are skipped, the ones that would be skipped anyways aren't worth keeping
+            if (checks && stmt_kind(stmt) == StmtKind::DECL_PROC) {
+                auto decl_proc = ast->get<Decl_Proc_Stmt>(stmt);
+                if (check_unreachable || dependencies->procedure_reachable(decl_proc->proc_id)) {
+                    keys[index] = procedure_check_key(ast, source, scopes, dependencies, stmt, check_unreachable);
+                    lines[index] = source_line(decl_proc->offset);
+                    found[index] = checks->find(keys[index], lines[index]);
+                    if (found[index] != CHECK_NONE) return;
+                }
+            }
 
+            results[index] = workers.get_ref(worker)->typecheck_statement(stmt);
+        },
+        [&](size_t index, size_t, Task_Diagnostics diagnostics) {
+            if (found[index] != CHECK_NONE) {
+                checks->use(found[index]);
+                if (!checks->results.get(found[index]).success) success = false;
+                return;
+            }
+
+            if (keys[index]) checks->add(keys[index], lines[index], results[index], diagnostics);
+            if (!results[index]) success = false;
+        });
+
+    if (checks) checks->end();
+
+    workers.free();
+    delete[] results;
+    delete[] keys;
+    delete[] lines;
+    delete[] found;
     return success;
 }
 
-bool Typechecker::typecheck_statement(Stmt* stmt) {
-    switch (stmt->kind) {
+bool Typechecker::typecheck_statement(Stmt_ID stmt) {
+    switch (stmt_kind(stmt)) {
         case StmtKind::DECL_VAR: {
-            auto decl_var = static_cast<Decl_Var_Stmt *>(stmt);
+            auto decl_var = ast->get<Decl_Var_Stmt>(stmt);
 
             Type_ID declared_type = decl_var->decl.type;
 
-            if (decl_var->initializer) {
+            if (decl_var->initializer != EXPR_NONE) {
                 Type_ID type = typecheck_expr(decl_var->initializer);
 
                 if (declared_type != type) {
-                    errorf(decl_var->decl.name.line, "Expected type %s but initializer is of type %s", type_string(declared_type), type_string(type));
+                    errorf(decl_var->decl.line(), "Expected type %s but initializer is of type %s", type_string(declared_type), type_string(type));
                 }
             }
 
             return true;
         }
         case StmtKind::DECL_PROC: {
-            auto decl_proc = static_cast<Decl_Proc_Stmt *>(stmt);
+            auto decl_proc = ast->get<Decl_Proc_Stmt>(stmt);
+            if (!check_unreachable && !dependencies->procedure_reachable(decl_proc->proc_id)) return true;
+
+            Procedure proc = scopes->get_proc_from_id(decl_proc->proc_id);
 
-            Procedure proc = decl_proc->scope->get_proc_from_id(decl_proc->proc_id);
+            int enclosing_frame = curr_frame;
+            curr_frame = scopes->scope(decl_proc->body_scope)->frame;
 
             bool success = true;
-            for (auto stmt : proc.body) {
-                // @xxx @fixme this is not correct for nested scopes inside the procedure
+            for (auto stmt : ast->list(proc.body)) {
                 if (!typecheck_statement(stmt)) {
                     success = false;
                 }
             }
 
+            curr_frame = enclosing_frame;
             return success;
         }
         case StmtKind::ASSIGN: {
-            auto assign = static_cast<Assign_Stmt *>(stmt);
-
-            Variable var = assign->scope->get_var_from_id(assign->var_id);
+            auto assign = ast->get<Assign_Stmt>(stmt);
 
+            Type_ID var_type = variable_type(assign->address);
             Type_ID expr_type = typecheck_expr(assign->rhs);
 
             bool success = true;
-            if (var.type != expr_type) {
+            if (var_type != expr_type) {
                 char buff[1024];
-                null_terminate(assign->target.lexeme, buff);
-                errorf(assign->target.line,
+                null_terminate(symbol_name(assign->target), buff);
+                errorf(source_line(assign->offset),
                     "types of left and right hand sides of the assignment doesn't match, variable %s is expected to be of type %s but initializer is of type %s",
                     buff,
-                    type_string(var.type), type_string(expr_type));
+                    type_string(var_type), type_string(expr_type));
 
                 success = false;
             }
@@ -261,10 +344,10 @@ bool Typechecker::typecheck_statement(Stmt* stmt) {
             return success;
         }
         case StmtKind::BLOCK: {
-            auto block = static_cast<Block_Stmt*>(stmt);
+            auto block = ast->get<Block_Stmt>(stmt);
 
             bool success = true;
-            for (auto stmt : block->body) {
+            for (auto stmt : ast->list(block->body)) {
                 if (!typecheck_statement(stmt))
                     success = false;
             }
@@ -272,13 +355,13 @@ bool Typechecker::typecheck_statement(Stmt* stmt) {
             return success;
         }
         case StmtKind::IF: {
-            auto if_stmt = static_cast<If_Stmt*>(stmt);
+            auto if_stmt = ast->get<If_Stmt>(stmt);
 
             Type_ID cond_type = typecheck_expr(if_stmt->cond);
             bool thenb = typecheck_statement(if_stmt->then_stmt);
             if (!thenb) return false;
 
-            if (if_stmt->else_stmt) {
+            if (if_stmt->else_stmt != STMT_NONE) {
                 bool elseb = typecheck_statement(if_stmt->else_stmt);
                 if (!elseb) return false;
             }
@@ -286,16 +369,14 @@ bool Typechecker::typecheck_statement(Stmt* stmt) {
             return true;
         }
         case StmtKind::FOR: {
-            auto for_stmt = static_cast<For_Stmt*>(stmt);
             return false;
         }
         case StmtKind::EXPRESSION: {
-            auto expr_stmt = static_cast<Expr_Stmt*>(stmt);
             return true;
         }
         case StmtKind::RETURN: {
-            auto ret_stmt = static_cast<Return_Stmt*>(stmt);
-            for (auto ret : ret_stmt->returns) {
+            auto ret_stmt = ast->get<Return_Stmt>(stmt);
+            for (auto ret : ast->list(ret_stmt->returns)) {
                 typecheck_expr(ret);
             }
 
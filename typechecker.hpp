@@ -2,17 +2,28 @@
 
 #include "type.hpp"
 #include "environment.hpp"
+#include "dependency.hpp"
+#include "ast.hpp"
+#include "check_cache.hpp"
 
 class Typechecker {
-    ArrayView<Environment> declarations;
-    const Environment* curr_env = NULL;
+    const Ast* ast;
+    const Scope_Table* scopes;
+    const Dependency_Graph* dependencies;
+    int curr_scope = 0;
+    int curr_frame = -1;  // of the procedure being checked
+
+    Type_ID variable_type(Var_Address address) const;
 
 public:
-    Typechecker(ArrayView<Environment> decls) : declarations(decls) {
-        curr_env = &decls.data[0];
-    }
+    bool check_unreachable = false;  // procedures nothing reachable from main calls are skipped otherwise
+    size_t thread_count = 1;  // the top level statements are checked on this many threads
+    Check_Cache* checks = NULL;  // top level procedures found in it aren't checked again
+    String source;  // the procedures are keyed by their text in it
+
+    Typechecker(const Ast* ast, const Scope_Table* scopes, const Dependency_Graph* dependencies) : ast(ast), scopes(scopes), dependencies(dependencies) {}
 
-    bool typecheck(ArrayView<Stmt*> program, ArrayView<Environment> declarations);
-    Type_ID typecheck_expr(Expr* expr);
-    bool typecheck_statement(Stmt* stmt);
+    bool typecheck(Stmt_List program);
+    Type_ID typecheck_expr(Expr_ID expr);
+    bool typecheck_statement(Stmt_ID stmt);
 };
\ No newline at end of file